@@ -0,0 +1,74 @@
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+
+#include "io/library_generator.hpp"
+
+int main(int argc, char* argv[])
+{
+  std::string outputFile;
+  std::string distribution = "uniform";
+  LIB_NAMESPACE::GeneratorOptions options;
+
+  boost::program_options::options_description desc("Allowed options");
+  desc.add_options()("help", "produce help message")(
+      "output,o",
+      boost::program_options::value<std::string>(&outputFile),
+      "output .mslibrary.xml file (default: stdout)")(
+      "compounds,n",
+      boost::program_options::value<std::size_t>(&options.Compounds),
+      "number of compounds (default: 1000)")(
+      "spectra,s",
+      boost::program_options::value<std::size_t>(&options.SpectraPerCompound),
+      "spectra per compound (default: 1)")(
+      "peaks,p",
+      boost::program_options::value<std::size_t>(&options.PeaksPerSpectrum),
+      "peaks per spectrum (default: 50)")(
+      "distribution",
+      boost::program_options::value<std::string>(&distribution),
+      "m/z distribution: uniform, nominal or exponential (default: uniform)")(
+      "min-mz",
+      boost::program_options::value<double>(&options.MinMz),
+      "lowest m/z (default: 30)")(
+      "max-mz",
+      boost::program_options::value<double>(&options.MaxMz),
+      "highest m/z (default: 600)")(
+      "accurate-mass",
+      boost::program_options::bool_switch(&options.AccurateMass),
+      "mark the library as accurate mass")(
+      "seed",
+      boost::program_options::value<std::uint64_t>(&options.Seed),
+      "random seed; equal options and seed give equal files (default: 1)");
+
+  boost::program_options::variables_map vm;
+
+  try {
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+  } catch (const boost::program_options::error& e) {
+    std::cerr << "Error parsing command line options: " << e.what() << "\n";
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  try {
+    options.Distribution = LIB_NAMESPACE::parseMzDistribution(distribution);
+    if (outputFile.empty()) {
+      LIB_NAMESPACE::generateLibrary(options, std::cout);
+    } else {
+      LIB_NAMESPACE::generateLibrary(options, outputFile);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error generating library: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
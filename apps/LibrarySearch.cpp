@@ -0,0 +1,201 @@
+#include <charconv>
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "io/library_reader.hpp"
+#include "io/numeric.hpp"
+#include "models/spectral_store.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/session.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+#include "scoring/spectral_search.hpp"
+
+template<typename T>
+void append(std::string& row, T value)
+{
+  if constexpr (std::is_floating_point_v<T>) {
+    LIB_NAMESPACE::numeric::append(row, value, std::chars_format::general, 6);
+  } else {
+    LIB_NAMESPACE::numeric::append(row, value);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  std::string libraryFile = "assets/wellcome4.mslibrary.xml";
+  std::string queryFile;
+  std::string metric = "cosine";
+  LIB_NAMESPACE::SearchOptions options;
+  std::string tolerance;
+  unsigned threads = 1;
+  LIB_NAMESPACE::profiling::Options profiling;
+
+  boost::program_options::options_description desc("Allowed options");
+  desc.add_options()("help", "produce help message")(
+      "input,i",
+      boost::program_options::value<std::string>(&libraryFile),
+      "library to search (.mslibrary.xml or .mhlib)")(
+      "queries,q",
+      boost::program_options::value<std::string>(&queryFile),
+      "query spectra, in the same formats (default: the library itself)")(
+      "top,k",
+      boost::program_options::value<std::size_t>(&options.TopK),
+      "hits per query (default: 10)")(
+      "tolerance,t",
+      boost::program_options::value<std::string>(&tolerance),
+      "m/z match tolerance, e.g. 0.5, 0.5Da or 20ppm (default: 0.5 Da, "
+      "20 ppm when library and queries are accurate-mass)")(
+      "metric",
+      boost::program_options::value<std::string>(&metric),
+      "cosine or dot (default: cosine)")(
+      "mz-power",
+      boost::program_options::value<double>(&options.MzPower),
+      "peak weight exponent of m/z (default: 0)")(
+      "abundance-power",
+      boost::program_options::value<double>(&options.AbundancePower),
+      "peak weight exponent of abundance (default: 0.5)")(
+      "threads,j",
+      boost::program_options::value<unsigned>(&threads),
+      "worker threads, 0 for one per core (default: 1)");
+  LIB_NAMESPACE::profiling::addOptions(desc, profiling);
+
+  boost::program_options::variables_map vm;
+
+  try {
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+  } catch (const boost::program_options::error& e) {
+    std::cerr << "Error parsing command line options: " << e.what() << "\n";
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  LIB_NAMESPACE::profiling::Session session(profiling);
+
+  if (metric == "cosine") {
+    options.Metric = LIB_NAMESPACE::Similarity::Cosine;
+  } else if (metric == "dot") {
+    options.Metric = LIB_NAMESPACE::Similarity::DotProduct;
+  } else {
+    std::cerr << "Unknown metric: " << metric << "\n";
+    return 1;
+  }
+
+  // Only the intermediate libraries of XML loads live in the arenas, so they
+  // are given back as soon as the stores are built.
+  LIB_NAMESPACE::SpectralStore library;
+  LIB_NAMESPACE::SpectralStore queries;
+  try {
+    library = LIB_NAMESPACE::readSpectralStore(
+        libraryFile,
+        threads,
+        session.resource(LIB_NAMESPACE::allocation::Subsystem::Library));
+    if (!queryFile.empty()) {
+      queries = LIB_NAMESPACE::readSpectralStore(
+          queryFile,
+          threads,
+          session.resource(LIB_NAMESPACE::allocation::Subsystem::Queries));
+    }
+  } catch (const boost::property_tree::xml_parser_error& e) {
+    throw std::runtime_error("Failed to read XML file: "
+                             + std::string(e.what()));
+  }
+  session.releaseArenas();
+  const auto& querySpectra = queryFile.empty() ? library : queries;
+
+  options.Tolerance = LIB_NAMESPACE::defaultSearchTolerance(
+      library.AccurateMass && querySpectra.AccurateMass);
+  try {
+    if (!tolerance.empty()) {
+      options.Tolerance = LIB_NAMESPACE::parseMzTolerance(tolerance);
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::optional<LIB_NAMESPACE::SpectralSearch> search;
+  try {
+    search.emplace(library, options);
+  } catch (const std::exception& e) {
+    std::cerr << "Error setting up search: " << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << "QueryCompoundID, QuerySpectrumID, Rank, CompoundID, "
+               "SpectrumID, Name, Score, MatchedPeaks, "
+            << std::endl;
+
+  // A query walks the library peaks near each of its own peaks, so batches
+  // of consecutive queries are balanced by query peak count; each batch's
+  // rows go through the reorder buffer to keep query order.
+  const LIB_NAMESPACE::WorkStealingPool pool(
+      LIB_NAMESPACE::resolveThreads(threads));
+  std::vector<std::uint64_t> weights;
+  weights.reserve(querySpectra.spectrumCount());
+  for (std::size_t q = 0; q < querySpectra.spectrumCount(); ++q) {
+    weights.push_back(querySpectra.PeakOffsets[q + 1]
+                      - querySpectra.PeakOffsets[q] + 1);
+  }
+  const auto batches = LIB_NAMESPACE::partitionByWeight(weights, pool.threads());
+  LIB_NAMESPACE::OrderedWriter output(std::cout, batches.size() - 1);
+
+  try {
+    pool.run(batches.size() - 1,
+             [&](std::size_t batch, unsigned)
+             {
+               LIB_STATS_SCOPE(Transform);
+               LIB_TRACE_SCOPE("search batch", "batch", batch);
+               std::string rows;
+
+               for (auto q = batches[batch]; q < batches[batch + 1]; ++q) {
+                 auto query = querySpectra.spectrum(q);
+                 auto hits = search->search(query);
+
+                 for (std::size_t rank = 0; rank < hits.size(); ++rank) {
+                   const auto& hit = hits[rank];
+                   std::string name(library.CompoundNames[hit.Compound]);
+
+                   append(rows, query.CompoundID);
+                   rows += ", ";
+                   append(rows, query.SpectrumID);
+                   rows += ", ";
+                   append(rows, rank + 1);
+                   rows += ", ";
+                   append(rows, hit.CompoundID);
+                   rows += ", ";
+                   append(rows, hit.SpectrumID);
+                   rows += ", ";
+                   rows += boost::algorithm::replace_all_copy(name, ",", "-");
+                   rows += ", ";
+                   append(rows, hit.Score);
+                   rows += ", ";
+                   append(rows, hit.MatchedPeaks);
+                   rows += ", \n";
+                 }
+               }
+
+               output.write(batch, std::move(rows));
+             });
+  } catch (const std::exception& e) {
+    std::cerr << "Error writing output: " << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout.flush();
+
+  return session.finish() ? 0 : 1;
+}
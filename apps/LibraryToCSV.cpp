@@ -1,91 +1,57 @@
+#include <fstream>
 #include <iostream>
 #include <string>
-#include <vector>
-#include <algorithm>
-#include <utility>
 
-#include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
-#include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 
-#include "models/library.hpp"
-#include "models/spectrum.hpp"
-
-template<typename T1, typename T2>
-std::vector<std::pair<T1, T2>> top_n_zip(const std::vector<T1>& v1,
-                                         const std::vector<T2>& v2,
-                                         size_t n,
-                                         bool descending = true)
-{
-  size_t len = std::min(v1.size(), v2.size());
-  std::vector<std::pair<T1, T2>> zipped;
-
-  for (size_t i = 0; i < len; ++i) {
-    zipped.emplace_back(v1[i], v2[i]);
-  }
-
-  // Sort by first element of pair
-  std::sort(zipped.begin(),
-            zipped.end(),
-            [descending](const auto& a, const auto& b)
-            { return descending ? a.first > b.first : a.first < b.first; });
-
-  // Take top n (or all if n is too big)
-  if (n < zipped.size()) {
-    zipped.resize(n);
-  }
-
-  return zipped;
-}
-
-std::string convert(const LIB_NAMESPACE::Library& lib) {
-  std::string output;
-
-    for (const auto& [compound_id, compound] : lib.Compounds) {
-
-    // Add compound data to CSV
-    std::string csvLine;
-    csvLine += std::to_string(compound.CompoundID) + ",";
-    csvLine += std::to_string(compound.RetentionIndex) + ",";
-
-    for (const auto& [spectrum_id, spectrum] : compound.Spectra) {
-
-      auto top_pairs =
-          top_n_zip(spectrum.AbundanceValues, spectrum.MzValues, 5);
-
-      for (const auto& p : top_pairs) {
-        csvLine += std::to_string(p.second) + ",";
-      }
-
-      // csvLine += join(spec.MzValues, ",") + ",";
-      // csvLine += std::to_string(spec.LibraryID) + ",";
-      // csvLine += std::to_string(spec.CompoundID) + ",";
-      // csvLine += std::to_string(spec.SpectrumID) + ",";
-      break;
-    }
-
-    output += csvLine + "\n";
-  }
-
-  return output;
-
-}
-
+#include "io/csv_writer.hpp"
+#include "io/library_reader.hpp"
+#include "models/spectral_store.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/session.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
 
 int main(int argc, char* argv[])
 {
   std::string inputFile = "assets/wellcome4.mslibrary.xml";
   std::string outputFile;
+  std::string peaks = "top";
+  LIB_NAMESPACE::CsvOptions options;
+  unsigned threads = 1;
+  LIB_NAMESPACE::profiling::Options profiling;
 
   boost::program_options::options_description desc("Allowed options");
   desc.add_options()("help", "produce help message")(
       "input,i",
       boost::program_options::value<std::string>(&inputFile),
-      "input file (default: stdin)")(
+      "input file (.mslibrary.xml or .mhlib)")(
       "output,o",
       boost::program_options::value<std::string>(&outputFile),
-      "output file (default: stdout)");
+      "output file (default: stdout)")(
+      "peaks",
+      boost::program_options::value<std::string>(&peaks),
+      "top, all or none (default: top)")(
+      "top,n",
+      boost::program_options::value<std::size_t>(&options.TopN),
+      "peaks per spectrum with --peaks=top (default: 5)")(
+      "abundances",
+      boost::program_options::bool_switch(&options.Abundances),
+      "write each peak's abundance after its m/z")(
+      "metadata",
+      boost::program_options::bool_switch(&options.Metadata),
+      "add CAS number, name, formula, weight and retention time")(
+      "each-spectrum",
+      boost::program_options::bool_switch(&options.EachSpectrum),
+      "one row per spectrum instead of the first spectrum per compound")(
+      "header",
+      boost::program_options::bool_switch(&options.Header),
+      "write a header row")(
+      "threads,j",
+      boost::program_options::value<unsigned>(&threads),
+      "parse threads, 0 for one per core (default: 1)");
+  LIB_NAMESPACE::profiling::addOptions(desc, profiling);
 
   boost::program_options::variables_map vm;
 
@@ -104,53 +70,57 @@ int main(int argc, char* argv[])
     return 0;
   }
 
-  boost::property_tree::ptree ptree;
+  LIB_NAMESPACE::profiling::Session session(profiling);
+
+  if (peaks == "top") {
+    options.Peaks = LIB_NAMESPACE::CsvPeaks::Top;
+  } else if (peaks == "all") {
+    options.Peaks = LIB_NAMESPACE::CsvPeaks::All;
+  } else if (peaks == "none") {
+    options.Peaks = LIB_NAMESPACE::CsvPeaks::None;
+  } else {
+    std::cerr << "Unknown peak selection: " << peaks << "\n";
+    return 1;
+  }
+
+  // Only the intermediate library of an XML load lives in the arena, so it
+  // is given back as soon as the store is built.
+  LIB_NAMESPACE::SpectralStore library;
 
   try {
-    boost::property_tree::read_xml(inputFile, ptree);
+    library = LIB_NAMESPACE::readSpectralStore(
+        inputFile,
+        threads,
+        session.resource(LIB_NAMESPACE::allocation::Subsystem::Library));
   } catch (const boost::property_tree::xml_parser_error& e) {
     throw std::runtime_error("Failed to read XML file: "
                              + std::string(e.what()));
   }
+  session.releaseArenas();
 
-  std::ostream* out = &std::cout;
   std::ofstream fileOutput;
-
-  if (outputFile.empty() && !inputFile.empty()) {
-    outputFile = inputFile;
-  }
-
   if (!outputFile.empty()) {
-    try {
-      fileOutput.open(outputFile + ".xml");
-    } catch (const boost::filesystem::filesystem_error& e) {
-      std::cerr << "Failed to create output directory: " << e.what() << "\n";
-      return 1;
-    } catch (const std::exception& e) {
-      std::cerr << "Error with output file: " << e.what() << "\n";
-      return 1;
-    }
-
+    fileOutput.open(outputFile, std::ios::binary | std::ios::trunc);
     if (!fileOutput) {
-      std::cerr << "Failed to open output file: " << outputFile + ".m" << "\n";
+      std::cerr << "Failed to open output file: " << outputFile << "\n";
       return 1;
     }
-    out = &fileOutput;
   }
 
-
-
-  LIB_NAMESPACE::Library library(ptree);
-
   try {
-    std::cout << "Converting Library to CSV..." << std::endl;
-    std::cout << convert(library) << std::endl;
-
-    return 0;
+    LIB_STATS_SCOPE(Transform);
+    LIB_TRACE_SCOPE("write csv");
+    if (outputFile.empty()) {
+      std::cout << "Converting Library to CSV..." << std::endl;
+      LIB_NAMESPACE::writeCsv(library, std::cout, options);
+      std::cout << std::endl;
+    } else {
+      LIB_NAMESPACE::writeCsv(library, fileOutput, options);
+    }
   } catch (const std::exception& e) {
     std::cerr << "Error writing output: " << e.what() << "\n";
     return 1;
   }
 
-  return 0;
+  return session.finish() ? 0 : 1;
 }
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+
+#include <boost/program_options.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "index/mz_index.hpp"
+#include "io/library_cache.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/session.hpp"
+
+int main(int argc, char* argv[])
+{
+  std::string inputFile = "assets/wellcome4.mslibrary.xml";
+  std::string outputFile;
+  std::string indexFile;
+  unsigned threads = 1;
+  LIB_NAMESPACE::profiling::Options profiling;
+
+  boost::program_options::options_description desc("Allowed options");
+  desc.add_options()("help", "produce help message")(
+      "input,i",
+      boost::program_options::value<std::string>(&inputFile),
+      "input library file")(
+      "output,o",
+      boost::program_options::value<std::string>(&outputFile),
+      "output cache file (default: <input>.mhlib)")(
+      "index,x",
+      boost::program_options::value<std::string>(&indexFile),
+      "also write an inverted m/z index to this file")(
+      "threads,j",
+      boost::program_options::value<unsigned>(&threads),
+      "parse threads, 0 for one per core (default: 1)");
+  LIB_NAMESPACE::profiling::addOptions(desc, profiling);
+
+  boost::program_options::variables_map vm;
+
+  try {
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+  } catch (const boost::program_options::error& e) {
+    std::cerr << "Error parsing command line options: " << e.what() << "\n";
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  LIB_NAMESPACE::profiling::Session session(profiling);
+
+  if (outputFile.empty()) {
+    outputFile = inputFile + ".mhlib";
+  }
+
+  // The session outlives the library, which lives until the end of main.
+  LIB_NAMESPACE::Library library(
+      session.resource(LIB_NAMESPACE::allocation::Subsystem::Library));
+
+  try {
+    library = LIB_NAMESPACE::readLibrary(
+        inputFile,
+        LIB_NAMESPACE::Projection::All,
+        threads,
+        library.get_allocator());
+  } catch (const boost::property_tree::xml_parser_error& e) {
+    throw std::runtime_error("Failed to read XML file: "
+                             + std::string(e.what()));
+  }
+
+  try {
+    LIB_NAMESPACE::writeLibraryCache(library, outputFile);
+  } catch (const std::exception& e) {
+    std::cerr << "Error writing cache: " << e.what() << "\n";
+    return 1;
+  }
+
+  if (!indexFile.empty()) {
+    try {
+      LIB_NAMESPACE::writeMzIndex(
+          LIB_NAMESPACE::MzIndex(LIB_NAMESPACE::SpectralStore(library)),
+          indexFile);
+    } catch (const std::exception& e) {
+      std::cerr << "Error writing m/z index: " << e.what() << "\n";
+      return 1;
+    }
+  }
+
+  return session.finish() ? 0 : 1;
+}
@@ -7,13 +7,22 @@
 #include <boost/property_tree/xml_parser.hpp>
 
 
+#include "io/library_reader.hpp"
+#include "io/method_writer.hpp"
 #include "models/library.hpp"
 #include "models/method.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/session.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
 
 int main(int argc, char* argv[])
 {
   std::string inputFile = "assets/wellcome4.mslibrary.xml";
   std::string outputFile = "test.xml";
+  unsigned threads = 1;
+  LIB_NAMESPACE::profiling::Options profiling;
 
   boost::program_options::options_description desc("Allowed options");
   desc.add_options()("help", "produce help message")(
@@ -22,7 +31,11 @@ int main(int argc, char* argv[])
       "input file (default: stdin)")(
       "output,o",
       boost::program_options::value<std::string>(&outputFile),
-      "output file (default: stdout)");
+      "output file (default: stdout)")(
+      "threads,j",
+      boost::program_options::value<unsigned>(&threads),
+      "worker threads, 0 for one per core (default: 1)");
+  LIB_NAMESPACE::profiling::addOptions(desc, profiling);
 
   boost::program_options::variables_map vm;
 
@@ -41,6 +54,8 @@ int main(int argc, char* argv[])
     return 0;
   }
 
+  LIB_NAMESPACE::profiling::Session session(profiling);
+
   // std::istream* in = &std::cin;
   //std::istream* in = &std::cin;
   //std::ifstream fileInput;
@@ -53,10 +68,17 @@ int main(int argc, char* argv[])
   //  in = &fileInput;
   //}
 
-  boost::property_tree::ptree ptree;
+  // The session outlives the library, which lives until the end of main.
+  LIB_NAMESPACE::Library library(
+      session.resource(LIB_NAMESPACE::allocation::Subsystem::Library));
 
   try {
-    boost::property_tree::read_xml(inputFile, ptree);
+    // Targets only need spectrum metadata, never the peak arrays.
+    library = LIB_NAMESPACE::readLibrary(
+        inputFile,
+        LIB_NAMESPACE::Projection::Metadata,
+        threads,
+        library.get_allocator());
   } catch (const boost::property_tree::xml_parser_error& e) {
     throw std::runtime_error("Failed to read XML file: "
                              + std::string(e.what()));
@@ -89,19 +111,21 @@ int main(int argc, char* argv[])
     out = &fileOutput;
   }
 
-  LIB_NAMESPACE::Library library(ptree);
-
 
   try {
-    LIB_NAMESPACE::QuantitationDataSet method(library);
-    boost::property_tree::write_xml(
-        *out,
-        (boost::property_tree::ptree)method,
-        boost::property_tree::xml_writer_make_settings<std::string>(' ', 4));
+    threads = LIB_NAMESPACE::resolveThreads(threads);
+    LIB_NAMESPACE::QuantitationDataSet method(
+        library,
+        threads,
+        LIB_NAMESPACE::allocation::resource(
+            LIB_NAMESPACE::allocation::Subsystem::Method));
+    LIB_STATS_SCOPE(Transform);
+    LIB_TRACE_SCOPE("write method");
+    LIB_NAMESPACE::writeMethod(method, *out, threads);
   } catch (const std::exception& e) {
     std::cerr << "Error translating or writing method: " << e.what() << "\n";
     return 1;
   }
 
-  return 0;
+  return session.finish() ? 0 : 1;
 }
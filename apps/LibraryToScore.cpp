@@ -1,4 +1,6 @@
+#include <charconv>
 #include <iostream>
+#include <optional>
 #include <string>
 
 #include <boost/filesystem.hpp>
@@ -7,44 +9,53 @@
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/algorithm/string.hpp>
 
+#include "io/library_reader.hpp"
+#include "io/numeric.hpp"
 #include "models/library.hpp"
 #include "models/method.hpp"
-
-double score(const LIB_NAMESPACE::Compound& compound,
-             std::vector<LIB_NAMESPACE::Spectrum::tMzValue> kernel)
+#include "models/spectral_store.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/session.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+#include "scoring/kernel_scorer.hpp"
+
+template<typename T>
+void append(std::string& row, T value)
 {
-
-  double score = 0;
-
-  for (const auto& [id, spectrum] : compound.Spectra) {
-
-    for (const auto& mz : kernel) {
-
-      for (size_t i = 0;
-           i < spectrum.AbundanceValues.size() && i < spectrum.MzValues.size();
-           ++i)
-      {
-        if (abs(spectrum.MzValues[i] - mz) < 0.1) {
-          score += (spectrum.AbundanceValues[i] / 10000);
-        }
-
-      }
-    }
-
+  if constexpr (std::is_floating_point_v<T>) {
+    // Same digits as `std::cout << value` with the default precision.
+    LIB_NAMESPACE::numeric::append(row, value, std::chars_format::general, 6);
+  } else {
+    LIB_NAMESPACE::numeric::append(row, value);
   }
-
-  return score / compound.Spectra.size();
 }
 
 int main(int argc, char* argv[])
 {
   std::string inputFile = "assets/wellcome4.mslibrary.xml";
+  std::string kernelFile;
+  std::string tolerance;
+  unsigned threads = 1;
+  LIB_NAMESPACE::profiling::Options profiling;
 
   boost::program_options::options_description desc("Allowed options");
   desc.add_options()("help", "produce help message")(
       "input,i",
       boost::program_options::value<std::string>(&inputFile),
-      "input file (default: stdin)");
+      "input file (default: stdin)")(
+      "kernels,k",
+      boost::program_options::value<std::string>(&kernelFile),
+      "kernel file, one `Name,mz,mz,...` per line (default: built-in)")(
+      "tolerance,t",
+      boost::program_options::value<std::string>(&tolerance),
+      "m/z match tolerance, e.g. 0.1, 0.1Da or 20ppm (default: 0.1 Da, "
+      "0.5 Da for accurate-mass libraries)")(
+      "threads,j",
+      boost::program_options::value<unsigned>(&threads),
+      "worker threads, 0 for one per core (default: 1)");
+  LIB_NAMESPACE::profiling::addOptions(desc, profiling);
 
   boost::program_options::variables_map vm;
 
@@ -63,65 +74,99 @@ int main(int argc, char* argv[])
     return 0;
   }
 
+  LIB_NAMESPACE::profiling::Session session(profiling);
 
-
-  boost::property_tree::ptree ptree;
+  // Only the intermediate library of an XML load lives in the arena, so it
+  // is given back as soon as the store is built.
+  LIB_NAMESPACE::SpectralStore library;
   try {
-    boost::property_tree::read_xml(inputFile, ptree);
+    library = LIB_NAMESPACE::readSpectralStore(
+        inputFile,
+        threads,
+        session.resource(LIB_NAMESPACE::allocation::Subsystem::Library));
   } catch (const boost::property_tree::xml_parser_error& e) {
     throw std::runtime_error("Failed to read XML file: "
                              + std::string(e.what()));
   }
+  session.releaseArenas();
+
+  LIB_NAMESPACE::MzTolerance window =
+      LIB_NAMESPACE::defaultKernelTolerance(library.AccurateMass);
+  try {
+    if (!tolerance.empty()) {
+      window = LIB_NAMESPACE::parseMzTolerance(tolerance);
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
 
-  LIB_NAMESPACE::Library library(ptree);
-
-  std::vector<std::vector<LIB_NAMESPACE::Spectrum::tMzValue>> kernels = {
-    {29, 43, 57, 71, 85, 99, 113, 127, 141}, // Alkane
-    {31, 45, 59, 73, 87, 101, 115, 129, 143},  // Alcohol
-    {43, 60, 74, 88, 102, 116, 130, 144},  // Ester
-    {30, 44, 58, 72, 86, 100, 114, 128, 142},  // Amine
-    {29, 44, 58, 72, 86, 100, 114, 128},  // Aldehyde
-    {43, 58, 72, 86, 100, 114, 128, 142},  // Ketone
-    {49, 63, 77, 91, 105, 119, 133, 147},  // Chloroalkane
-    {152, 154, 156},  // Chlorobiphenyl
-    {50, 80, 94, 108, 122, 136},  // Halogenated
-    {47, 61, 75, 89, 103, 117, 131, 145},  // Sulphur
-    {68, 82, 96, 110, 124, 138},  // Furan Ether
-    {45, 60, 74, 88, 102, 116, 130, 144},  // Carboxylic acid
-    {77, 91, 105, 119, 133, 147}  // Aromatic
-  };
+  std::optional<const LIB_NAMESPACE::KernelScorer> scorer;
+  try {
+    scorer.emplace(kernelFile.empty()
+                       ? LIB_NAMESPACE::defaultKernels()
+                       : LIB_NAMESPACE::readKernels(kernelFile),
+                   window);
+  } catch (const std::exception& e) {
+    std::cerr << "Error reading kernels: " << e.what() << "\n";
+    return 1;
+  }
 
   std::cout << "ID, "
-            << "Name, "
-            << "Alkane, "
-            << "Alcohol, "
-            << "Ester, "
-            << "Amine, "
-            << "Aldehyde, "
-            << "Ketone, "
-            << "Chloroalkane, "
-            << "Chlorobiphenyl, "
-            << "Halogenated, "
-            << "Sulphur, "
-            << "Furan Ether, "
-            << "Carboxylic acid, "
-            << "Aromatic, "
-            << std::endl;
-
-  for (const auto& [id, compound] : library.Compounds) {
-    
-    std::string name = compound.CompoundName;
-
-    std::cout << compound.CompoundID << ", ";
-    std::cout << boost::algorithm::replace_all_copy(compound.CompoundName, ",", "-") << ", ";
-
-    for (const auto& kernel : kernels) {
-      std::cout << score(compound, kernel) << ", ";
-    }
+            << "Name, ";
+  for (const auto& kernel : scorer->kernels()) {
+    std::cout << kernel.Name << ", ";
+  }
+  std::cout << std::endl;
+
+  // Batches of consecutive compounds with similar spectrum counts; each batch
+  // is formatted into its own buffer and handed to the reorder buffer, so
+  // rows come out in CompoundID order whatever the thread count.
+  std::vector<std::uint64_t> weights;
+  weights.reserve(library.compoundCount());
+  for (const auto& compound : library.compounds()) {
+    weights.push_back(compound.Spectra.size() + 1);
+  }
 
-    std::cout << std::endl;
+  const LIB_NAMESPACE::WorkStealingPool pool(
+      LIB_NAMESPACE::resolveThreads(threads));
+  const auto batches = LIB_NAMESPACE::partitionByWeight(weights, pool.threads());
+  LIB_NAMESPACE::OrderedWriter output(std::cout, batches.size() - 1);
 
+  try {
+    pool.run(batches.size() - 1,
+             [&](std::size_t batch, unsigned)
+             {
+               LIB_STATS_SCOPE(Transform);
+               LIB_TRACE_SCOPE("score batch", "batch", batch);
+               std::vector<double> scores(scorer->kernels().size());
+               std::string rows;
+
+               for (auto i = batches[batch]; i < batches[batch + 1]; ++i) {
+                 auto compound = library.compound(i);
+                 std::string name(compound.CompoundName);
+
+                 append(rows, compound.CompoundID);
+                 rows += ", ";
+                 rows += boost::algorithm::replace_all_copy(name, ",", "-");
+                 rows += ", ";
+
+                 scorer->score(compound, scores);
+                 for (const auto& score : scores) {
+                   append(rows, score);
+                   rows += ", ";
+                 }
+                 rows += '\n';
+               }
+
+               output.write(batch, std::move(rows));
+             });
+  } catch (const std::exception& e) {
+    std::cerr << "Error writing output: " << e.what() << "\n";
+    return 1;
   }
 
-  return 0;
+  std::cout.flush();
+
+  return session.finish() ? 0 : 1;
 }
@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/program_options.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include "base64.hpp"
+#include "io/chunked_reader.hpp"
+#include "io/library_generator.hpp"
+#include "io/library_reader.hpp"
+#include "io/method_writer.hpp"
+#include "io/xml_writer.hpp"
+#include "models/library.hpp"
+#include "models/library_arena.hpp"
+#include "models/method.hpp"
+#include "models/spectral_store.hpp"
+#include "profiling/heap_counter.hpp"
+#include "scoring/kernel_scorer.hpp"
+
+namespace
+{
+
+// Results are folded in here; the volatile stores are side effects the
+// optimizer must keep, and with them the work that feeds them.
+volatile std::size_t g_sink = 0;
+
+// Discards what is written, counting the bytes.
+class CountingBuffer : public std::streambuf
+{
+public:
+  std::size_t count = 0;
+
+protected:
+  int_type overflow(int_type c) override
+  {
+    ++count;
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char*, std::streamsize n) override
+  {
+    count += static_cast<std::size_t>(n);
+    return n;
+  }
+};
+
+struct Result
+{
+  std::string Name;
+  std::size_t Compounds;
+  std::uint64_t Iterations;
+  double Seconds;
+  double Bytes;
+  // Counted over the warm-up run.
+  std::uint64_t Allocations;
+};
+
+struct Fixture
+{
+  std::size_t Compounds;
+  std::string Xml;
+  std::string Path;
+  std::vector<std::string> Payloads;
+  LIB_NAMESPACE::Library Library;
+  LIB_NAMESPACE::SpectralStore Store;
+  LIB_NAMESPACE::QuantitationDataSet Method;
+};
+
+Fixture makeFixture(std::size_t compounds)
+{
+  Fixture fixture;
+  fixture.Compounds = compounds;
+
+  // Two spectra of 60 unit-mass peaks per compound.
+  LIB_NAMESPACE::GeneratorOptions options;
+  options.Compounds = compounds;
+  options.SpectraPerCompound = 2;
+  options.PeaksPerSpectrum = 60;
+  options.Distribution = LIB_NAMESPACE::MzDistribution::Nominal;
+  std::ostringstream xml;
+  LIB_NAMESPACE::generateLibrary(options, xml);
+  fixture.Xml = xml.str();
+
+  fixture.Path = (std::filesystem::temp_directory_path()
+                  / ("MassHunterLibToQuant_benchmark_"
+                     + std::to_string(compounds) + ".mslibrary.xml"))
+                     .string();
+  std::ofstream(fixture.Path, std::ios::binary) << fixture.Xml;
+
+  std::istringstream input(fixture.Xml);
+  LIB_NAMESPACE::LibraryReader reader(input);
+  fixture.Library = LIB_NAMESPACE::Library(reader);
+  fixture.Store = LIB_NAMESPACE::SpectralStore(fixture.Library);
+  fixture.Method = LIB_NAMESPACE::QuantitationDataSet(fixture.Library);
+
+  for (const auto& spectrum : fixture.Store.spectra()) {
+    fixture.Payloads.push_back(
+        base64::encodeArray<double>(spectrum.MzValues));
+    fixture.Payloads.push_back(
+        base64::encodeArray<double>(spectrum.AbundanceValues));
+  }
+  return fixture;
+}
+
+// Runs `body` once to warm up, then in doubling batches until `minTime`
+// seconds have passed. `body` returns the bytes it processed.
+Result measure(const std::string& name,
+               std::size_t compounds,
+               double minTime,
+               const std::function<std::size_t()>& body)
+{
+  using Clock = std::chrono::steady_clock;
+
+  auto allocations = LIB_NAMESPACE::allocation::heapAllocations();
+  double bytes = static_cast<double>(body());
+  allocations = LIB_NAMESPACE::allocation::heapAllocations() - allocations;
+  std::uint64_t iterations = 0;
+  std::uint64_t batch = 1;
+  double seconds = 0;
+
+  do {
+    auto start = Clock::now();
+    for (std::uint64_t i = 0; i < batch; ++i) {
+      g_sink = g_sink + body();
+    }
+    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    iterations += batch;
+    batch *= 2;
+  } while (seconds < minTime);
+
+  return {name, compounds, iterations, seconds / static_cast<double>(iterations),
+          bytes, allocations};
+}
+
+std::vector<Result> run(const Fixture& fixture,
+                        double minTime,
+                        const std::string& filter)
+{
+  std::vector<Result> results;
+  auto bench = [&](const std::string& name,
+                   const std::function<std::size_t()>& body)
+  {
+    if (name.find(filter) != std::string::npos) {
+      results.push_back(measure(name, fixture.Compounds, minTime, body));
+    }
+  };
+
+  std::size_t payloadBytes = 0;
+  for (const auto& payload : fixture.Payloads) {
+    payloadBytes += payload.size();
+  }
+
+  bench("base64_decode",
+        [&]
+        {
+          std::size_t size = 0;
+          for (const auto& payload : fixture.Payloads) {
+            size += base64::decode(payload).size();
+          }
+          g_sink = g_sink + size;
+          return payloadBytes;
+        });
+
+  // Successor of decodeBase64Binary: typed decode into a reused buffer.
+  bench("base64_decode_into",
+        [&]
+        {
+          std::vector<double> values;
+          for (const auto& payload : fixture.Payloads) {
+            base64::decodeInto(payload, values);
+            g_sink = g_sink + values.size();
+          }
+          return payloadBytes;
+        });
+
+  bench("library_read",
+        [&]
+        {
+          std::istringstream input(fixture.Xml);
+          LIB_NAMESPACE::LibraryReader reader(input);
+          LIB_NAMESPACE::Library library(reader);
+          g_sink = g_sink + library.Compounds.size();
+          return fixture.Xml.size();
+        });
+
+  // Same load with the records in an arena; teardown is one release.
+  bench("library_read_arena",
+        [&]
+        {
+          LIB_NAMESPACE::LibraryArena arena;
+          std::istringstream input(fixture.Xml);
+          LIB_NAMESPACE::LibraryReader reader(input);
+          LIB_NAMESPACE::Library library(
+              reader, LIB_NAMESPACE::Projection::All, &arena);
+          g_sink = g_sink + library.Compounds.size();
+          return fixture.Xml.size();
+        });
+
+  bench("library_read_parallel",
+        [&]
+        {
+          auto library = LIB_NAMESPACE::readLibraryParallel(fixture.Path);
+          g_sink = g_sink + library.Compounds.size();
+          return fixture.Xml.size();
+        });
+
+  const LIB_NAMESPACE::KernelScorer scorer(LIB_NAMESPACE::defaultKernels());
+  bench("kernel_score",
+        [&]
+        {
+          std::vector<double> scores(scorer.kernels().size());
+          for (const auto& compound : fixture.Store.compounds()) {
+            scorer.score(compound, scores);
+            g_sink = g_sink + static_cast<std::size_t>(scores.front());
+          }
+          return fixture.Store.peakCount()
+              * (sizeof(LIB_NAMESPACE::Spectrum::tMzValue)
+                 + sizeof(LIB_NAMESPACE::Spectrum::tAbundanceValue));
+        });
+
+  bench("method_build",
+        [&]
+        {
+          LIB_NAMESPACE::QuantitationDataSet method(fixture.Library);
+          g_sink = g_sink + method.Targets.size();
+          return std::size_t(0);
+        });
+
+  bench("target_ptree",
+        [&]
+        {
+          for (const auto& target : fixture.Method.Targets) {
+            boost::property_tree::ptree tree = target;
+            g_sink = g_sink + tree.size();
+          }
+          return std::size_t(0);
+        });
+
+  bench("target_xml",
+        [&]
+        {
+          std::string output;
+          {
+            LIB_NAMESPACE::XmlWriter writer(output, 1);
+            for (const auto& target : fixture.Method.Targets) {
+              LIB_NAMESPACE::writeXml(writer, target);
+            }
+          }
+          return output.size();
+        });
+
+  bench("method_xml",
+        [&]
+        {
+          CountingBuffer buffer;
+          std::ostream output(&buffer);
+          LIB_NAMESPACE::writeMethod(fixture.Method, output);
+          return buffer.count;
+        });
+
+  return results;
+}
+
+void printTable(const std::vector<Result>& results, std::ostream& output)
+{
+  output << std::left << std::setw(24) << "benchmark" << std::right
+         << std::setw(10) << "compounds" << std::setw(12) << "iterations"
+         << std::setw(14) << "ms/iter" << std::setw(12) << "MB/s"
+         << std::setw(16) << "compounds/s" << std::setw(14) << "allocs/iter"
+         << "\n";
+  output << std::fixed;
+  for (const auto& result : results) {
+    output << std::left << std::setw(24) << result.Name << std::right
+           << std::setw(10) << result.Compounds << std::setw(12)
+           << result.Iterations << std::setw(14) << std::setprecision(3)
+           << result.Seconds * 1e3 << std::setw(12) << std::setprecision(1);
+    if (result.Bytes > 0) {
+      output << result.Bytes / result.Seconds / 1e6;
+    } else {
+      output << "-";
+    }
+    output << std::setw(16) << std::setprecision(0)
+           << static_cast<double>(result.Compounds) / result.Seconds
+           << std::setw(14) << result.Allocations << "\n";
+  }
+  output.unsetf(std::ios::floatfield);
+}
+
+void writeJson(const std::vector<Result>& results, std::ostream& output)
+{
+  output << std::setprecision(9);
+  output << "{\n  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const auto& result = results[i];
+    output << (i ? ",\n" : "\n") << "    {\"name\": \"" << result.Name
+           << "\", \"compounds\": " << result.Compounds
+           << ", \"iterations\": " << result.Iterations
+           << ", \"seconds_per_iteration\": " << result.Seconds
+           << ", \"bytes_per_iteration\": " << result.Bytes
+           << ", \"megabytes_per_second\": "
+           << result.Bytes / result.Seconds / 1e6
+           << ", \"compounds_per_second\": "
+           << static_cast<double>(result.Compounds) / result.Seconds
+           << ", \"allocations_per_iteration\": " << result.Allocations << "}";
+  }
+  output << "\n  ],\n  \"hardware_threads\": "
+         << std::thread::hardware_concurrency() << "\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  std::string sizes = "100,1000,10000";
+  double minTime = 0.5;
+  std::string filter;
+  std::string jsonFile;
+
+  boost::program_options::options_description desc("Allowed options");
+  desc.add_options()("help", "produce help message")(
+      "sizes",
+      boost::program_options::value<std::string>(&sizes),
+      "comma-separated library sizes in compounds (default: 100,1000,10000)")(
+      "min-time",
+      boost::program_options::value<double>(&minTime),
+      "minimum seconds per benchmark and size (default: 0.5)")(
+      "filter",
+      boost::program_options::value<std::string>(&filter),
+      "only run benchmarks whose name contains this")(
+      "json",
+      boost::program_options::value<std::string>(&jsonFile),
+      "also write results as JSON to this file, - for stdout");
+
+  boost::program_options::variables_map vm;
+
+  try {
+    boost::program_options::store(
+        boost::program_options::parse_command_line(argc, argv, desc), vm);
+    boost::program_options::notify(vm);
+  } catch (const boost::program_options::error& e) {
+    std::cerr << "Error parsing command line options: " << e.what() << "\n";
+    std::cerr << desc << std::endl;
+    return 1;
+  }
+
+  if (vm.count("help")) {
+    std::cout << desc << std::endl;
+    return 0;
+  }
+
+  std::vector<std::size_t> compounds;
+  std::vector<std::string> fields;
+  boost::algorithm::split(fields, sizes, boost::algorithm::is_any_of(","));
+  try {
+    for (const auto& field : fields) {
+      compounds.push_back(std::stoul(field));
+    }
+  } catch (const std::exception&) {
+    std::cerr << "Invalid --sizes: " << sizes << "\n";
+    return 1;
+  }
+
+  // With JSON on stdout the table goes to stderr.
+  std::ostream& table = jsonFile == "-" ? std::cerr : std::cout;
+
+  std::vector<Result> results;
+  for (auto size : compounds) {
+    auto fixture = makeFixture(size);
+    auto batch = run(fixture, minTime, filter);
+    std::filesystem::remove(fixture.Path);
+    if (batch.empty()) {
+      std::cerr << "no benchmark matches --filter " << filter << "\n";
+      return 1;
+    }
+
+    printTable(batch, table);
+    table << std::endl;
+    results.insert(results.end(), batch.begin(), batch.end());
+  }
+
+  if (jsonFile == "-") {
+    writeJson(results, std::cout);
+  } else if (!jsonFile.empty()) {
+    std::ofstream output(jsonFile);
+    writeJson(results, output);
+    if (!output) {
+      std::cerr << "Failed to write " << jsonFile << "\n";
+      return 1;
+    }
+  }
+
+  return 0;
+}
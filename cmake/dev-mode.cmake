@@ -1,5 +1,16 @@
 include(cmake/folders.cmake)
 
+# Counting replacements of the global operator new, for the allocation test
+# and the benchmarks only; the tools keep the standard allocator.
+add_library(
+    MassHunterLibToQuant_heap_counter OBJECT
+    "source/profiling/heap_counter.cpp"
+)
+target_link_libraries(
+    MassHunterLibToQuant_heap_counter
+    PUBLIC MassHunterLibToQuant_lib
+)
+
 include(CTest)
 if(BUILD_TESTING)
   add_subdirectory(test)
@@ -12,6 +23,11 @@ add_custom_target(
 )
 add_dependencies(run-exe LibraryToQuantMethod_exe)
 
+option(BUILD_BENCHMARKS "Build the benchmark suite in benchmarks/" ON)
+if(BUILD_BENCHMARKS)
+  add_subdirectory(benchmarks)
+endif()
+
 option(BUILD_MCSS_DOCS "Build documentation using Doxygen and m.css" OFF)
 if(BUILD_MCSS_DOCS)
   include(cmake/docs.cmake)
@@ -1,5 +1,6 @@
 install(
-    TARGETS LibraryToQuantMethod_exe LibraryToCSV_exe
+    TARGETS LibraryToQuantMethod_exe LibraryToCSV_exe LibraryToCache_exe
+    LibrarySearch_exe GenerateLibrary_exe
     RUNTIME COMPONENT MassHunterLibToQuant_Runtime
 )
 
@@ -4,7 +4,15 @@
 #ifndef _BASE64_H_
 #define _BASE64_H_
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 namespace base64
 {
@@ -15,6 +23,97 @@ static const std::string alphabet =
 std::string encode(const std::string& in);
 std::string decode(const std::string& in);
 
+// Lenient stops at the first character outside the alphabet, like decode()
+// always did. Strict throws std::invalid_argument unless the input is
+// alphabet characters followed by at most two '=' of correct padding.
+enum class Validation
+{
+  Lenient,
+  Strict
+};
+
+// Upper bound on the decoded size, exact for well-formed input.
+std::size_t decodedSize(std::string_view in);
+std::size_t encodedSize(std::size_t bytes);
+
+// Decodes into `out`, which must hold at least decodedSize(in) bytes, and
+// returns the number of bytes written. Uses AVX2 or SSE4.1 when the CPU
+// supports them.
+std::size_t decode(std::string_view in,
+                   std::span<std::byte> out,
+                   Validation validation = Validation::Lenient);
+
+void encode(std::span<const std::byte> in, std::string& out);
+
+namespace detail
+{
+
+// The binary arrays in library files are little-endian.
+template<typename T>
+void fromLittleEndian(std::span<T> values)
+{
+  if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1) {
+    for (auto& value : values) {
+      auto* bytes = reinterpret_cast<std::byte*>(&value);
+      std::reverse(bytes, bytes + sizeof(T));
+    }
+  }
+}
+
+}  // namespace detail
+
+// Number of elements of T needed to decode `in` in place.
+template<typename T>
+std::size_t decodedCount(std::string_view in)
+{
+  return (decodedSize(in) + sizeof(T) - 1) / sizeof(T);
 }
 
+// Decodes a little-endian array of T straight into `out`, which must hold
+// decodedCount<T>(in) elements, and returns the number of complete elements.
+template<typename T>
+std::size_t decodeInto(std::string_view in,
+                       std::span<T> out,
+                       Validation validation = Validation::Lenient)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  std::size_t bytes = decode(in, std::as_writable_bytes(out), validation);
+  if (validation == Validation::Strict && bytes % sizeof(T) != 0) {
+    throw std::invalid_argument("base64: decoded size is not a multiple of "
+                                + std::to_string(sizeof(T)) + " bytes");
+  }
+
+  std::size_t count = bytes / sizeof(T);
+  detail::fromLittleEndian(out.first(count));
+  return count;
+}
+
+template<typename T, typename Allocator>
+void decodeInto(std::string_view in,
+                std::vector<T, Allocator>& out,
+                Validation validation = Validation::Lenient)
+{
+  out.resize(decodedCount<T>(in));
+  out.resize(decodeInto(in, std::span<T>(out), validation));
+}
+
+template<typename T>
+std::string encodeArray(std::span<const T> values)
+{
+  static_assert(std::is_trivially_copyable_v<T>);
+
+  std::string out;
+  if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1) {
+    std::vector<T> swapped(values.begin(), values.end());
+    detail::fromLittleEndian(std::span<T>(swapped));
+    encode(std::as_bytes(std::span<const T>(swapped)), out);
+  } else {
+    encode(std::as_bytes(values), out);
+  }
+  return out;
+}
+
+}  // namespace base64
+
 #endif  // _BASE64_H_
@@ -0,0 +1,92 @@
+#pragma once
+
+#ifndef LIB_INDEX_MZ_INDEX_HPP
+#define LIB_INDEX_MZ_INDEX_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "matching/mz_match.hpp"
+#include "models/spectral_store.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// One library peak as seen from the index.
+struct Posting
+{
+  double MzValue;
+  tCompoundID CompoundID;
+  tSpectrumID SpectrumID;
+  // Abundance relative to the spectrum's largest peak, in (0, 1].
+  float RelativeAbundance;
+  // Zero; fills what would be padding so index files hold no stray bytes.
+  std::uint32_t Reserved;
+};
+
+// Inverted m/z index: every peak of a library, sorted by m/z and bucketed
+// into fixed-width bins, answering "which compounds have an ion near m/z"
+// without sweeping the spectra.
+//
+// Bins only serve to jump into the sorted postings; range queries check the
+// exact m/z of each posting, so results do not depend on the bin width.
+class MzIndex
+{
+public:
+  MzIndex() = default;
+  // Peaks below `minRelativeAbundance` of their spectrum's base peak are
+  // left out of the index. Throws std::length_error when `binWidth` is too
+  // small for the library's m/z range.
+  explicit MzIndex(const SpectralStore& library,
+                   double binWidth = 0.1,
+                   float minRelativeAbundance = 0);
+
+  double binWidth() const { return m_binWidth; }
+  std::size_t binCount() const
+  {
+    return m_binStarts.empty() ? 0 : m_binStarts.size() - 1;
+  }
+  std::span<const Posting> postings() const { return m_postings; }
+
+  // Postings within the tolerance of `mz` and with at least the given
+  // relative abundance, in m/z order.
+  std::vector<Posting> query(double mz,
+                             const MzTolerance& tolerance,
+                             float minRelativeAbundance = 0) const;
+
+  // Sorted, distinct IDs of the compounds that have a qualifying peak near
+  // every one of `ions`. Rare ions are intersected first.
+  std::vector<tCompoundID> intersect(std::span<const double> ions,
+                                     const MzTolerance& tolerance,
+                                     float minRelativeAbundance = 0) const;
+
+  friend void writeMzIndex(const MzIndex& index, std::ostream& output);
+  friend MzIndex readMzIndex(std::istream& input);
+
+private:
+  // The postings range that can hold m/z values in [low, high].
+  std::span<const Posting> range(double low, double high) const;
+
+  double m_origin = 0;
+  double m_binWidth = 0.1;
+  std::vector<std::uint32_t> m_binStarts;
+  std::vector<Posting> m_postings;
+};
+
+// Binary persistence, e.g. next to a .mhlib cache. The format is native
+// little-endian like the cache.
+void writeMzIndex(const MzIndex& index, std::ostream& output);
+void writeMzIndex(const MzIndex& index, const std::string& path);
+MzIndex readMzIndex(std::istream& input);
+MzIndex readMzIndex(const std::string& path);
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_INDEX_MZ_INDEX_HPP
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef LIB_IO_CHUNKED_READER_HPP
+#define LIB_IO_CHUNKED_READER_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// A top-level element under the document root, as the byte range
+// [Begin, End) from its '<' to just past its closing '>'.
+struct LibraryElement
+{
+  LibraryReader::Record Kind;
+  std::size_t Begin;
+  std::size_t End;
+};
+
+// Locates the top-level elements of an .mslibrary.xml document without
+// parsing them. Only markup is inspected: the scan jumps from '<' to '<',
+// skipping comments, CDATA sections and quoted attribute values, so base64
+// peak data costs one memchr. Unbalanced documents throw
+// boost::property_tree::xml_parser_error.
+std::vector<LibraryElement> scanLibrary(std::string_view document,
+                                        const std::string& filename = "");
+
+// Loads .mslibrary.xml on `threads` threads.
+//
+// The file is memory-mapped and scanned for top-level elements, which are
+// cut into chunks of whole records. Workers parse their chunks and decode
+// the peak arrays eagerly; the records are then inserted into the Library
+// in document order, so the result, including the "Compound ID not found
+// for Spectrum" check for a spectrum whose compound sits in another chunk,
+// is the same as a sequential read.
+//
+// Workers build their records on the default resource; only the merge,
+// which runs on the calling thread, allocates from `allocator`, so its
+// resource need not be thread-safe.
+Library readLibraryParallel(const std::string& path,
+                            Projection projection = Projection::All,
+                            unsigned threads = 0,
+                            const Library::allocator_type& allocator = {});
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_CHUNKED_READER_HPP
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef LIB_IO_CSV_WRITER_HPP
+#define LIB_IO_CSV_WRITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "models/spectral_store.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+enum class CsvPeaks
+{
+  None,
+  // The TopN most abundant peaks, most abundant first.
+  Top,
+  // Every peak, in m/z order.
+  All
+};
+
+struct CsvOptions
+{
+  CsvPeaks Peaks = CsvPeaks::Top;
+  std::size_t TopN = 5;
+  // Writes each peak as m/z then abundance instead of its m/z alone.
+  bool Abundances = false;
+  // Adds CASNumber, CompoundName, Formula, MolecularWeight and
+  // RetentionTimeRTL after the retention index.
+  bool Metadata = false;
+  // One row per spectrum, with its SpectrumID, instead of one row per
+  // compound holding only its first spectrum.
+  bool EachSpectrum = false;
+  bool Header = false;
+};
+
+// Streaming CSV export of a SpectralStore.
+//
+// Every field is followed by a comma, numbers are written through numeric
+// in the fixed six-decimal format of std::to_string, and text
+// is quoted only when it has to be. Rows go through one reusable buffer that
+// is flushed in large blocks, and top-N selection sorts a reused index array
+// instead of copying the spectrum, so exporting allocates nothing per row
+// and holds at most one buffer of output. With the default options the
+// output is what LibraryToCSV has always written. Write failures throw
+// std::runtime_error.
+class CsvWriter
+{
+public:
+  explicit CsvWriter(std::ostream& output, CsvOptions options = {});
+
+  CsvWriter(const CsvWriter&) = delete;
+  CsvWriter& operator=(const CsvWriter&) = delete;
+
+  // Flushes; errors on this path are swallowed, call flush() to see them.
+  ~CsvWriter();
+
+  const CsvOptions& options() const { return m_options; }
+
+  // Column names; with peaks, as many as the widest row needs.
+  void header(const SpectralStore& library);
+
+  // The row(s) of one compound.
+  void write(const CompoundView& compound);
+
+  void flush();
+
+private:
+  void peaks(const SpectrumView& spectrum);
+  void field(std::string_view text);
+  void field(std::uint64_t value);
+  void field(double value);
+  void endRow();
+
+  std::ostream& m_output;
+  CsvOptions m_options;
+  std::string m_buffer;
+  std::vector<std::uint32_t> m_order;
+};
+
+// Writes the header, if asked for, and every compound of `library`.
+void writeCsv(const SpectralStore& library,
+              std::ostream& output,
+              const CsvOptions& options = {});
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_CSV_WRITER_HPP
@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef LIB_IO_LIBRARY_CACHE_HPP
+#define LIB_IO_LIBRARY_CACHE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "models/library.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// Binary library cache (.mhlib).
+//
+// Layout, all little-endian and every section aligned to 64 bytes:
+//   Header
+//   CompoundRecord[CompoundCount]   sorted by CompoundID
+//   SpectrumRecord[SpectrumCount]   grouped by compound, sorted by SpectrumID
+//   double MzValues[PeakCount]      one slot range per spectrum
+//   double AbundanceValues[PeakCount]
+//   char Strings[StringsSize]       CAS numbers, names and formulas
+//
+// The file is opened with a read-only memory mapping; nothing is parsed or
+// decoded on load and peak arrays are handed out as spans into the mapping.
+namespace cache
+{
+
+constexpr char kMagic[8] = {'M', 'H', 'L', 'I', 'B', '\0', '\r', '\n'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kAccurateMass = 1u << 0;
+constexpr std::uint64_t kAlignment = 64;
+
+struct StringRef
+{
+  std::uint32_t Offset;
+  std::uint32_t Length;
+};
+
+struct Header
+{
+  char Magic[8];
+  std::uint32_t Version;
+  std::uint32_t Flags;
+  std::uint32_t LibraryID;
+  std::uint32_t CompoundCount;
+  std::uint64_t SpectrumCount;
+  std::uint64_t PeakCount;
+  std::uint64_t StringsSize;
+  std::uint64_t CompoundsOffset;
+  std::uint64_t SpectraOffset;
+  std::uint64_t MzValuesOffset;
+  std::uint64_t AbundanceValuesOffset;
+  std::uint64_t StringsOffset;
+};
+
+struct CompoundRecord
+{
+  std::uint32_t LibraryID;
+  std::uint32_t CompoundID;
+  std::uint32_t FirstSpectrum;
+  std::uint32_t SpectrumCount;
+  float BoilingPoint;
+  float MeltingPoint;
+  float MolecularWeight;
+  float RetentionIndex;
+  float RetentionTimeRTL;
+  std::uint32_t Reserved;
+  StringRef CASNumber;
+  StringRef CompoundName;
+  StringRef Formula;
+};
+
+struct SpectrumRecord
+{
+  std::uint32_t LibraryID;
+  std::uint32_t CompoundID;
+  std::uint32_t SpectrumID;
+  float BasePeakMZ;
+  std::uint64_t FirstPeak;
+  std::uint32_t MzCount;
+  std::uint32_t AbundanceCount;
+};
+
+static_assert(sizeof(Header) == 88);
+static_assert(sizeof(CompoundRecord) == 64);
+static_assert(sizeof(SpectrumRecord) == 32);
+
+}  // namespace cache
+
+class MappedLibrary
+{
+public:
+  explicit MappedLibrary(const std::string& path);
+
+  tLibraryID libraryID() const { return m_header->LibraryID; }
+  bool accurateMass() const { return m_header->Flags & cache::kAccurateMass; }
+
+  std::span<const cache::CompoundRecord> compounds() const;
+  std::span<const cache::SpectrumRecord> spectra() const;
+  std::span<const cache::SpectrumRecord> spectra(
+      const cache::CompoundRecord& compound) const;
+
+  // Binary search over the sorted compound table; nullptr when absent.
+  const cache::CompoundRecord* find(tCompoundID compoundID) const;
+
+  std::string_view string(cache::StringRef ref) const;
+  std::span<const Spectrum::tMzValue> mzValues(
+      const cache::SpectrumRecord& spectrum) const;
+  std::span<const Spectrum::tAbundanceValue> abundanceValues(
+      const cache::SpectrumRecord& spectrum) const;
+
+  // Materializes the owning model, e.g. for code written against Library.
+  Library toLibrary(Projection projection = Projection::All,
+                    const Library::allocator_type& allocator = {}) const;
+
+private:
+  template<typename T>
+  const T* section(std::uint64_t offset, std::uint64_t count) const;
+
+  boost::interprocess::file_mapping m_file;
+  boost::interprocess::mapped_region m_region;
+  const cache::Header* m_header = nullptr;
+};
+
+// Writes the cache sequentially from the stream's current position, so any
+// binary-mode stream works, pipes and stdout included; the offsets inside
+// are relative to where the cache starts.
+void writeLibraryCache(const Library& library, std::ostream& output);
+void writeLibraryCache(const Library& library, const std::string& path);
+
+// True when `path` names a binary cache rather than library XML.
+bool isLibraryCache(const std::string& path);
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_LIBRARY_CACHE_HPP
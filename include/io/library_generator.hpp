@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef LIB_IO_LIBRARY_GENERATOR_HPP
+#define LIB_IO_LIBRARY_GENERATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE
+{
+
+enum class MzDistribution
+{
+  // Continuous m/z, uniform between MinMz and MaxMz.
+  Uniform,
+  // Whole masses between MinMz and MaxMz, uniform, as in unit-resolution EI
+  // libraries.
+  Nominal,
+  // Falls off exponentially from MinMz, so low masses dominate as they do in
+  // fragment spectra; values past MaxMz are drawn again.
+  Exponential
+};
+
+// Parses "uniform", "nominal" or "exponential"; throws
+// std::invalid_argument otherwise.
+MzDistribution parseMzDistribution(std::string_view text);
+
+struct GeneratorOptions
+{
+  std::size_t Compounds = 1000;
+  std::size_t SpectraPerCompound = 1;
+  std::size_t PeaksPerSpectrum = 50;
+  MzDistribution Distribution = MzDistribution::Uniform;
+  double MinMz = 30;
+  double MaxMz = 600;
+  bool AccurateMass = false;
+  std::uint64_t Seed = 1;
+};
+
+// Writes a synthetic library in the MassHunter .mslibrary.xml layout: the
+// <Library> record, every <Compound>, then every <Spectrum> with base64
+// peak arrays sorted by m/z. Spectra are drawn from a generator seeded per
+// compound, so the same options always give the same bytes and nothing but
+// one spectrum and one output buffer is held in memory, whatever the size.
+// Throws std::invalid_argument for an empty or inverted m/z range and
+// std::runtime_error when writing fails.
+void generateLibrary(const GeneratorOptions& options, std::ostream& output);
+void generateLibrary(const GeneratorOptions& options, const std::string& path);
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_LIBRARY_GENERATOR_HPP
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef LIB_IO_LIBRARY_READER_HPP
+#define LIB_IO_LIBRARY_READER_HPP
+
+#include <array>
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "models/compound.hpp"
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// Document element of an .mslibrary.xml file.
+inline constexpr std::string_view kLibraryRoot = "LibraryDataSet";
+
+// Pull parser for .mslibrary.xml documents.
+//
+// Each call to next() consumes one top-level element under the document root
+// (<Library>, <Compound>, <Spectrum>, ...) and exposes it as a property tree
+// holding only that element. Peak memory is bounded by the largest record
+// instead of the whole document. Malformed input throws
+// boost::property_tree::xml_parser_error, like read_xml does.
+//
+// Each record kind keeps its tree between calls and parses the next record
+// of that kind into it, reusing nodes and string capacity wherever the
+// element names line up. A run of similar records therefore parses without
+// allocating.
+class LibraryReader
+{
+public:
+  enum class Record
+  {
+    Library,
+    Compound,
+    Spectrum,
+    Other,
+    End
+  };
+
+  // A Fragment is a run of top-level elements cut out of a document, as
+  // located by scanLibrary(); it has no prolog or root element, ends at end
+  // of input, and reports line numbers relative to its start.
+  enum class Mode
+  {
+    Document,
+    Fragment
+  };
+
+  explicit LibraryReader(std::istream& input,
+                         std::string filename = "",
+                         Mode mode = Mode::Document);
+
+  LibraryReader(const LibraryReader&) = delete;
+  LibraryReader& operator=(const LibraryReader&) = delete;
+
+  Record next();
+
+  // Throws xml_parser_error, on the root's line, unless the document element
+  // is `name`. A Fragment has no root and always passes.
+  void requireRoot(std::string_view name) const;
+
+  // Element name and subtree of the record returned by the last next(),
+  // valid until the next call.
+  const std::string& name() const { return m_name; }
+  const boost::property_tree::ptree& tree() const
+  {
+    return m_trees[static_cast<std::size_t>(m_record)];
+  }
+
+  // Build the model from the current record.
+  Compound compound(tLibraryID libraryID,
+                    const Compound::allocator_type& allocator = {});
+  Spectrum spectrum(Projection projection = Projection::All,
+                    const Spectrum::allocator_type& allocator = {});
+
+private:
+  int peek();
+  int get();
+  bool fill();
+  bool startsWith(const char* literal);
+
+  void skipWhitespace();
+  void skipUntil(const char* terminator);
+  void skipMarkup();
+  std::string readName();
+  void readText(std::string& text, char terminator);
+  void readElement(boost::property_tree::ptree& node, const std::string& name);
+
+  [[noreturn]] void fail(const std::string& message) const;
+
+  std::istream& m_input;
+  std::string m_filename;
+  std::vector<char> m_buffer;
+  std::size_t m_pos = 0;
+  std::size_t m_end = 0;
+  unsigned long m_line = 1;
+  std::string m_root;
+  unsigned long m_rootLine = 0;
+  bool m_done = false;
+  bool m_fragment = false;
+
+  std::string m_name;
+  Record m_record = Record::End;
+  // One per Record; the End slot stays empty.
+  std::array<boost::property_tree::ptree, 5> m_trees;
+};
+
+// Loads a library from .mslibrary.xml or from a binary .mhlib cache,
+// keeping only the peak columns named by `projection`. With more than one
+// thread, XML is read by readLibraryParallel(); 0 means one per core. The
+// library allocates from `allocator`.
+Library readLibrary(const std::string& path,
+                    Projection projection = Projection::All,
+                    unsigned threads = 1,
+                    const Library::allocator_type& allocator = {});
+
+// Same, straight into the flat store; caches are copied column by column.
+// `allocator` serves the intermediate Library of an XML load.
+SpectralStore readSpectralStore(const std::string& path,
+                                unsigned threads = 1,
+                                const Library::allocator_type& allocator = {});
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_LIBRARY_READER_HPP
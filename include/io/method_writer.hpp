@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef LIB_IO_METHOD_WRITER_HPP
+#define LIB_IO_METHOD_WRITER_HPP
+
+#include <ostream>
+#include <string>
+
+#include <defines.inc.hpp>
+
+#include "io/xml_writer.hpp"
+#include "models/method.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// Streaming counterparts of the ptree conversions in models/method.hpp.
+// They write the same elements in the same order, so a method written here
+// is byte-identical to write_xml((ptree)method) with a four-space indent,
+// without ever holding the document in memory.
+void writeXml(XmlWriter& writer, const Parameter& parameter);
+void writeXml(XmlWriter& writer,
+              const IntegrationParameters::ParameterSet_T& parameterSet);
+void writeXml(XmlWriter& writer, const TargetCompound& target);
+void writeXml(XmlWriter& writer, const QuantitationDataSet& method);
+
+// The standalone XML document a TargetCompound embeds as the escaped text of
+// its <IntegrationParameters> element.
+std::string encodeParameterSet(
+    const IntegrationParameters::ParameterSet_T& parameterSet);
+
+// Writes the complete method document, declaration included. With more than
+// one thread, batches of targets are serialized concurrently into separate
+// buffers and written in target order, so the bytes do not depend on the
+// thread count.
+void writeMethod(const QuantitationDataSet& method,
+                 std::ostream& output,
+                 unsigned threads = 1);
+void writeMethod(const QuantitationDataSet& method,
+                 int fd,
+                 unsigned threads = 1);
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_METHOD_WRITER_HPP
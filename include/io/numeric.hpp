@@ -0,0 +1,173 @@
+#pragma once
+
+#ifndef LIB_IO_NUMERIC_HPP
+#define LIB_IO_NUMERIC_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#include <boost/optional.hpp>
+
+#include <defines.inc.hpp>
+
+// Number <-> text conversions for every reader and writer, on top of
+// std::from_chars and std::to_chars. Unlike the iostreams behind
+// ptree::get/put and lexical_cast they never consult a locale or allocate.
+// format() writes floating-point values in the shortest form that parses
+// back to the same bits, so parse(format(x)) == x for every finite x,
+// infinity and NaN included.
+namespace LIB_NAMESPACE::numeric
+{
+
+// Enough for any value of the supported types in shortest form.
+inline constexpr std::size_t kMaxChars = 64;
+// Enough for the largest double in fixed notation with up to 64 decimals.
+inline constexpr std::size_t kMaxPrecisionChars = 400;
+
+namespace detail
+{
+
+inline std::string_view trim(std::string_view text)
+{
+  constexpr std::string_view whitespace = " \t\n\r\f\v";
+  auto first = text.find_first_not_of(whitespace);
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(first, text.find_last_not_of(whitespace) - first + 1);
+}
+
+inline char* checked(std::to_chars_result result)
+{
+  if (result.ec != std::errc()) {
+    throw std::length_error("Number does not fit its buffer");
+  }
+  return result.ptr;
+}
+
+}  // namespace detail
+
+// Parses the whole of `text` but for surrounding whitespace, as ptree::get
+// does. A leading '+' is accepted; out-of-range values, a '-' on unsigned
+// types and trailing characters are not. Booleans are "true", "false", "1"
+// or "0".
+template<typename T>
+std::optional<T> parse(std::string_view text)
+{
+  static_assert(std::is_arithmetic_v<T>, "numeric::parse takes numbers");
+  text = detail::trim(text);
+
+  if constexpr (std::is_same_v<T, bool>) {
+    if (text == "true" || text == "1") {
+      return true;
+    }
+    if (text == "false" || text == "0") {
+      return false;
+    }
+    return std::nullopt;
+  } else {
+    if (text.size() > 1 && text.front() == '+' && text[1] != '-') {
+      text.remove_prefix(1);
+    }
+    T value {};
+    auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc() || end != text.data() + text.size()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+}
+
+// Writes `value` to [first, last), which must hold kMaxChars, and returns
+// the end. Floating point takes the shortest round-trip form. A range too
+// small throws std::length_error.
+template<typename T>
+char* format(char* first, char* last, T value)
+{
+  static_assert(std::is_arithmetic_v<T>, "numeric::format takes numbers");
+  if constexpr (std::is_same_v<T, bool>) {
+    std::string_view text = value ? "true" : "false";
+    return std::copy(text.begin(), text.end(), first);
+  } else {
+    return detail::checked(std::to_chars(first, last, value));
+  }
+}
+
+// Fixed or general notation with the given precision, for display formats
+// that deliberately do not round-trip. [first, last) must hold
+// kMaxPrecisionChars.
+template<typename T>
+char* format(
+    char* first, char* last, T value, std::chars_format style, int precision)
+{
+  static_assert(std::is_floating_point_v<T>,
+                "precision applies to floating point");
+  return detail::checked(
+      std::to_chars(first, last, value, style, precision));
+}
+
+template<typename T>
+void append(std::string& output, T value)
+{
+  char buffer[kMaxChars];
+  output.append(buffer, format(buffer, buffer + sizeof(buffer), value));
+}
+
+template<typename T>
+void append(std::string& output,
+            T value,
+            std::chars_format style,
+            int precision)
+{
+  char buffer[kMaxPrecisionChars];
+  output.append(buffer,
+                format(buffer, buffer + sizeof(buffer), value, style, precision));
+}
+
+template<typename T>
+std::string toString(T value)
+{
+  std::string text;
+  append(text, value);
+  return text;
+}
+
+// ptree translator for the calls that would otherwise go through a
+// stringstream:
+//
+//   tree.get("BasePeakMZ", 0.0f, numeric::translator<float>);
+//   tree.put("MZ", mz, numeric::translator<float>);
+template<typename T>
+struct Translator
+{
+  using internal_type = std::string;
+  using external_type = T;
+
+  boost::optional<T> get_value(const std::string& text) const
+  {
+    if (auto value = parse<T>(text)) {
+      return *value;
+    }
+    return boost::none;
+  }
+
+  boost::optional<std::string> put_value(const T& value) const
+  {
+    return toString(value);
+  }
+};
+
+template<typename T>
+inline constexpr Translator<T> translator {};
+
+}  // namespace LIB_NAMESPACE::numeric
+
+#endif  // LIB_IO_NUMERIC_HPP
@@ -0,0 +1,85 @@
+#pragma once
+
+#ifndef LIB_IO_XML_WRITER_HPP
+#define LIB_IO_XML_WRITER_HPP
+
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE
+{
+
+// Forward-only XML writer that produces the same bytes as
+// boost::property_tree::write_xml with an indent of four spaces: the same
+// declaration, entity escaping, self-closing empty elements and number
+// formatting as ptree::put. Output is buffered and written to an ostream or
+// a file descriptor in large blocks. Write failures throw std::runtime_error.
+class XmlWriter
+{
+public:
+  explicit XmlWriter(std::ostream& output);
+  explicit XmlWriter(int fd);
+  // Collects the document in `output` instead. A non-zero `depth` writes a
+  // fragment indented as if nested that many elements deep.
+  explicit XmlWriter(std::string& output, std::size_t depth = 0);
+
+  XmlWriter(const XmlWriter&) = delete;
+  XmlWriter& operator=(const XmlWriter&) = delete;
+
+  // Flushes; errors on this path are swallowed, call flush() to see them.
+  ~XmlWriter();
+
+  void declaration();
+
+  // Opens an element; attributes may follow until the first child or text.
+  void startElement(std::string_view name);
+  void attribute(std::string_view name, std::string_view value);
+  void attribute(std::string_view name, const char* value);
+  void attribute(std::string_view name, bool value);
+  // Text content of the open element; it takes no children after this.
+  void text(std::string_view value);
+  // Closes the innermost open element, self-closing it when it is empty.
+  void endElement();
+
+  // Leaf element holding only text, e.g. <Value>1</Value>.
+  void element(std::string_view name, std::string_view value);
+  void element(std::string_view name, const std::string& value);
+  void element(std::string_view name, const char* value);
+  void element(std::string_view name, bool value);
+  void element(std::string_view name, int value);
+  void element(std::string_view name, unsigned int value);
+  void element(std::string_view name, float value);
+
+  // Appends a fragment made by another XmlWriter verbatim.
+  void raw(std::string_view fragment);
+
+  void flush();
+
+private:
+  void closeStartTag();
+  void indent(std::size_t depth);
+  void escape(std::string_view text);
+  void reserve();
+
+  std::ostream* m_stream = nullptr;
+  int m_fd = -1;
+  std::string* m_string = nullptr;
+
+  std::string m_buffer;
+  std::size_t m_depth = 0;
+  std::vector<std::string> m_open;
+  bool m_startTagOpen = false;
+  bool m_hasText = false;
+};
+
+// Escapes text the way write_xml does, including its rule of encoding the
+// first space of an all-space string so it survives a round trip.
+void escapeXml(std::string_view text, std::string& output);
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_IO_XML_WRITER_HPP
@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef LIB_MATCHING_MZ_MATCH_HPP
+#define LIB_MATCHING_MZ_MATCH_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+enum class ToleranceUnit
+{
+  Dalton,
+  Ppm
+};
+
+// How far a peak may lie from a reference ion and still match it: either a
+// fixed number of Da or parts per million of the ion's m/z. The latter is
+// what accurate-mass libraries need, since their mass error grows with m/z.
+struct MzTolerance
+{
+  double Value = 0.1;
+  ToleranceUnit Unit = ToleranceUnit::Dalton;
+
+  constexpr MzTolerance() = default;
+  // Plain numbers are Da, as every tolerance was before ppm windows.
+  constexpr MzTolerance(double dalton)
+      : Value(dalton)
+  {
+  }
+  constexpr MzTolerance(double value, ToleranceUnit unit)
+      : Value(value)
+      , Unit(unit)
+  {
+  }
+
+  static constexpr MzTolerance ppm(double value)
+  {
+    return {value, ToleranceUnit::Ppm};
+  }
+
+  // Half-width of the window around the reference ion `mz`.
+  double window(double mz) const
+  {
+    return Unit == ToleranceUnit::Ppm ? std::abs(mz) * Value * 1e-6 : Value;
+  }
+
+  bool matches(double ion, double mz) const
+  {
+    return std::abs(mz - ion) <= window(ion);
+  }
+
+  bool operator==(const MzTolerance&) const = default;
+};
+
+// Parses "0.1", "0.1Da" or "20ppm" (units are case-insensitive and may be
+// separated by spaces). Throws std::invalid_argument unless the value is a
+// positive number.
+MzTolerance parseMzTolerance(std::string_view text);
+
+// True when `mzValues` is ascending; NaN counts as out of order.
+bool sortedByMz(std::span<const Spectrum::tMzValue> mzValues);
+
+// Sorts the peaks (mzValues[i], abundanceValues[i]) by m/z, keeping the order
+// of equal m/z; NaN m/z go last. Both spans must have the same length.
+void sortPeaks(std::span<Spectrum::tMzValue> mzValues,
+               std::span<Spectrum::tAbundanceValue> abundanceValues);
+
+// First index at or after `from` whose value is not below `target`, in an
+// ascending array. Probes 1, 2, 4, ... elements ahead before bisecting, so a
+// merge that advances by a few elements at a time pays O(log distance).
+std::size_t gallop(std::span<const Spectrum::tMzValue> values,
+                   std::size_t from,
+                   Spectrum::tMzValue target);
+
+// Calls visit(ion, peak) with the indices of every peak within the tolerance
+// of every ion. `ions` must be ascending and free of NaN, which debug builds
+// assert; both paths below search them. Sorted peaks, which is what every
+// SpectralStore holds, are merged against the ions by galloping; peaks in any
+// other order are matched by a binary search of the ions each.
+template<typename Visit>
+void forEachMatch(std::span<const Spectrum::tMzValue> ions,
+                  std::span<const Spectrum::tMzValue> peaks,
+                  const MzTolerance& tolerance,
+                  Visit&& visit)
+{
+  // Search bounds are widened a hair so rounding can only let extra peaks
+  // through to the exact check, never drop a match.
+  constexpr double kSlack = 1 + 1e-9;
+  assert(sortedByMz(ions));
+
+  if (sortedByMz(peaks)) {
+    // ion - window(ion) never decreases along sorted ions, so neither does
+    // the cursor.
+    std::size_t cursor = 0;
+    for (std::size_t i = 0; i < ions.size(); ++i) {
+      double reach = tolerance.window(ions[i]) * kSlack;
+      cursor = gallop(peaks, cursor, ions[i] - reach);
+      for (auto p = cursor; p < peaks.size() && peaks[p] <= ions[i] + reach;
+           ++p)
+      {
+        if (tolerance.matches(ions[i], peaks[p])) {
+          visit(i, p);
+        }
+      }
+    }
+    return;
+  }
+
+  for (std::size_t p = 0; p < peaks.size(); ++p) {
+    // Windows are centred on the ions; an ion within twice the window at the
+    // peak covers every ppm tolerance below 50%.
+    double reach = 2 * tolerance.window(peaks[p]) * kSlack;
+    auto first = std::lower_bound(ions.begin(), ions.end(), peaks[p] - reach);
+    for (auto it = first; it != ions.end() && *it <= peaks[p] + reach; ++it) {
+      if (tolerance.matches(*it, peaks[p])) {
+        visit(static_cast<std::size_t>(it - ions.begin()), p);
+      }
+    }
+  }
+}
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_MATCHING_MZ_MATCH_HPP
@@ -3,14 +3,17 @@
 #ifndef LIB_MODELS_COMPOUND_HPP
 #define LIB_MODELS_COMPOUND_HPP
 
-#include <string>
 #include <map>
+#include <memory_resource>
+#include <string>
+#include <tuple>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include <defines.inc.hpp>
 #include <types.hpp>
 
+#include "models/fields.hpp"
 #include "models/spectrum.hpp"
 
 namespace LIB_NAMESPACE
@@ -18,30 +21,54 @@ namespace LIB_NAMESPACE
 
 struct Compound
 {
+  // Allocator-aware: the strings and spectrum map of a compound held in a
+  // pmr container come from that container's memory resource.
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   tLibraryID LibraryID;
   tCompoundID CompoundID;
   
-  std::string CASNumber;
-  std::string CompoundName;
-  std::string Formula;
+  std::pmr::string CASNumber;
+  std::pmr::string CompoundName;
+  std::pmr::string Formula;
   float BoilingPoint;
   float MeltingPoint;
   float MolecularWeight;
   float RetentionIndex;
   float RetentionTimeRTL;
 
-  std::map<tSpectrumID, Spectrum> Spectra;
+  std::pmr::map<tSpectrumID, Spectrum> Spectra;
 
-  Compound(tLibraryID, boost::property_tree::ptree);
+  Compound(tLibraryID,
+           const boost::property_tree::ptree&,
+           const allocator_type& allocator = {});
   Compound() = default;
+  explicit Compound(const allocator_type& allocator);
   Compound(const Compound&) = default;
+  Compound(const Compound& other, const allocator_type& allocator);
   Compound& operator=(const Compound&) = default;
   Compound(Compound&&) = default;
+  Compound(Compound&& other, const allocator_type& allocator);
   Compound& operator=(Compound&&) = default;
   ~Compound() = default;
 
+  allocator_type get_allocator() const { return Spectra.get_allocator(); }
+
 };
 
+// The elements of a <Compound> record, read by the ptree constructor.
+// LibraryID comes from the enclosing library instead.
+inline constexpr auto kCompoundFields = std::tuple {
+    fields::field("CompoundID", &Compound::CompoundID),
+    fields::field("CASNumber", &Compound::CASNumber),
+    fields::field("CompoundName", &Compound::CompoundName),
+    fields::field("Formula", &Compound::Formula),
+    fields::field("BoilingPoint", &Compound::BoilingPoint),
+    fields::field("MeltingPoint", &Compound::MeltingPoint),
+    fields::field("MolecularWeight", &Compound::MolecularWeight),
+    fields::field("RetentionIndex", &Compound::RetentionIndex),
+    fields::field("RetentionTimeRTL", &Compound::RetentionTimeRTL)};
+
 } // namespace LIB_NAMESPACE
 
 #endif // LIB_MODELS_COMPOUND_HPP
@@ -0,0 +1,203 @@
+#pragma once
+
+#ifndef LIB_MODELS_FIELDS_HPP
+#define LIB_MODELS_FIELDS_HPP
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <defines.inc.hpp>
+
+#include "io/numeric.hpp"
+
+// Compile-time field tables: a model lists its elements once, in document
+// order, as a tuple of field(name, member), where member is a data member or
+// accessor pointer. Writers walk the table with forEach(), and read() fills
+// a model from a ptree in one pass over its children, finding each
+// element's field through a perfect hash computed when the table is.
+namespace LIB_NAMESPACE::fields
+{
+
+template<typename Pointer>
+struct Field
+{
+  std::string_view Name;
+  Pointer Member;
+};
+
+template<typename Pointer>
+constexpr Field<Pointer> field(std::string_view name, Pointer member)
+{
+  return {name, member};
+}
+
+// Calls f(field) for every field of the table, in order.
+template<typename Table, typename F>
+constexpr void forEach(const Table& table, F&& f)
+{
+  std::apply([&](const auto&... field) { (f(field), ...); }, table);
+}
+
+template<typename Table>
+constexpr auto names(const Table& table)
+{
+  return std::apply(
+      [](const auto&... field)
+      {
+        return std::array<std::string_view, sizeof...(field)> {
+            field.Name...};
+      },
+      table);
+}
+
+namespace detail
+{
+
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed)
+{
+  // FNV-1a with a final mix, since slots come from the low bits.
+  std::uint32_t value = 2166136261u ^ seed;
+  for (char c : name) {
+    value ^= static_cast<unsigned char>(c);
+    value *= 16777619u;
+  }
+  return value ^ (value >> 15);
+}
+
+template<typename Table, typename F, std::size_t... I>
+void visit(const Table& table,
+           std::size_t index,
+           F& f,
+           std::index_sequence<I...>)
+{
+  ((index == I && (f(std::get<I>(table)), true)) || ...);
+}
+
+template<typename T>
+void reset(T& member)
+{
+  if constexpr (std::is_arithmetic_v<T>) {
+    member = T {};
+  } else {
+    member.clear();
+  }
+}
+
+template<typename T>
+void assign(T& member, const std::string& text)
+{
+  if constexpr (std::is_arithmetic_v<T>) {
+    member = numeric::parse<T>(text).value_or(T {});
+  } else {
+    member.assign(text);
+  }
+}
+
+}  // namespace detail
+
+// Collision-free map from the names of a table to their indices. The seed
+// is searched for at compile time, so a lookup is one hash and at most one
+// string comparison.
+template<std::size_t N>
+class NameIndex
+{
+public:
+  static_assert(N > 0 && N < 256, "NameIndex holds 1 to 255 names");
+  static constexpr std::size_t kSlots = std::bit_ceil(N * 4);
+
+  constexpr explicit NameIndex(const std::array<std::string_view, N>& names)
+      : m_names(names)
+  {
+    for (std::size_t i = 0; i < N; ++i) {
+      for (std::size_t j = i + 1; j < N; ++j) {
+        if (names[i] == names[j]) {
+          throw std::invalid_argument("Duplicate field name");
+        }
+      }
+    }
+    while (!tryBuild()) {
+      ++m_seed;
+    }
+  }
+
+  // Index of `name`, or N when the table does not have it.
+  constexpr std::size_t find(std::string_view name) const
+  {
+    auto index = m_slots[detail::hash(name, m_seed) & (kSlots - 1)];
+    return index < N && m_names[index] == name ? index : N;
+  }
+
+private:
+  constexpr bool tryBuild()
+  {
+    m_slots.fill(static_cast<std::uint8_t>(N));
+    for (std::size_t i = 0; i < N; ++i) {
+      auto& slot = m_slots[detail::hash(m_names[i], m_seed) & (kSlots - 1)];
+      if (slot != N) {
+        return false;
+      }
+      slot = static_cast<std::uint8_t>(i);
+    }
+    return true;
+  }
+
+  std::array<std::string_view, N> m_names {};
+  std::array<std::uint8_t, kSlots> m_slots {};
+  std::uint32_t m_seed = 0;
+};
+
+// Fills the members named in Table from the children of `tree`. Numbers go
+// through numeric::parse; as with ptree::get and a default, the first
+// child of a name wins and missing or malformed fields read as zero or
+// empty. Children the table does not name are passed to other(name, child).
+template<const auto& Table, typename Object, typename Other>
+void read(Object& object,
+          const boost::property_tree::ptree& tree,
+          Other&& other)
+{
+  constexpr auto kCount = std::tuple_size_v<std::decay_t<decltype(Table)>>;
+  static_assert(kCount <= 64, "read() tracks at most 64 fields");
+  static constexpr NameIndex<kCount> index(names(Table));
+
+  forEach(Table,
+          [&](const auto& field) { detail::reset(object.*field.Member); });
+
+  std::uint64_t seen = 0;
+  for (const auto& [name, child] : tree) {
+    auto i = index.find(name);
+    if (i == kCount) {
+      other(std::string_view(name), child);
+      continue;
+    }
+    if (seen & (std::uint64_t(1) << i)) {
+      continue;
+    }
+    seen |= std::uint64_t(1) << i;
+
+    auto assign = [&](const auto& field)
+    { detail::assign(object.*field.Member, child.data()); };
+    detail::visit(Table, i, assign, std::make_index_sequence<kCount>());
+  }
+}
+
+template<const auto& Table, typename Object>
+void read(Object& object, const boost::property_tree::ptree& tree)
+{
+  read<Table>(object,
+              tree,
+              [](std::string_view, const boost::property_tree::ptree&) {});
+}
+
+}  // namespace LIB_NAMESPACE::fields
+
+#endif  // LIB_MODELS_FIELDS_HPP
@@ -0,0 +1,208 @@
+#pragma once
+
+#ifndef LIB_MODELS_LAZY_ARRAY_HPP
+#define LIB_MODELS_LAZY_ARRAY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <defines.inc.hpp>
+
+#include "base64.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace detail
+{
+
+// Striped locks for one-time materialization; a mutex per array would more
+// than double the size of a Spectrum.
+inline std::mutex& materializeMutex(const void* key)
+{
+  static std::array<std::mutex, 64> mutexes;
+  return mutexes[(reinterpret_cast<std::uintptr_t>(key) >> 6)
+                 % mutexes.size()];
+}
+
+}  // namespace detail
+
+// Read-mostly array that can hold its base64 payload and decode it on first
+// access. Materialization happens exactly once even when several threads
+// read the same array concurrently; mutation is not thread-safe.
+//
+// Decoded values live in memory from the array's allocator and are allocated
+// once, at their final size. The payload is copied in from the parser and
+// stays on the global heap until it is decoded and released.
+template<typename T>
+class LazyArray
+{
+public:
+  using value_type = T;
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+  using const_iterator = typename std::pmr::vector<T>::const_iterator;
+
+  LazyArray() = default;
+  explicit LazyArray(const allocator_type& allocator)
+      : m_values(allocator)
+  {
+  }
+  LazyArray(const std::vector<T>& values,
+            const allocator_type& allocator = {})
+      : m_values(values.begin(), values.end(), allocator)
+  {
+  }
+
+  static LazyArray encoded(std::string payload,
+                           const allocator_type& allocator = {})
+  {
+    LazyArray array(allocator);
+    array.m_encoded = std::move(payload);
+    array.m_ready.store(false, std::memory_order_relaxed);
+    return array;
+  }
+
+  LazyArray(const LazyArray& other) { copyFrom(other); }
+  LazyArray(LazyArray&& other) noexcept
+      : m_values(std::move(other.m_values))
+      , m_encoded(std::move(other.m_encoded))
+  {
+    m_ready.store(other.m_ready.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    other.m_ready.store(true, std::memory_order_relaxed);
+  }
+  LazyArray(const LazyArray& other, const allocator_type& allocator)
+      : m_values(allocator)
+  {
+    copyFrom(other);
+  }
+  LazyArray(LazyArray&& other, const allocator_type& allocator)
+      : m_values(allocator)
+  {
+    moveFrom(other);
+  }
+  LazyArray& operator=(const LazyArray& other)
+  {
+    if (this != &other) {
+      copyFrom(other);
+    }
+    return *this;
+  }
+  // Copies instead of moving when the allocators differ.
+  LazyArray& operator=(LazyArray&& other)
+  {
+    if (this != &other) {
+      moveFrom(other);
+    }
+    return *this;
+  }
+  ~LazyArray() = default;
+
+  allocator_type get_allocator() const { return m_values.get_allocator(); }
+
+  bool decoded() const { return m_ready.load(std::memory_order_acquire); }
+
+  const std::pmr::vector<T>& values() const
+  {
+    if (!decoded()) {
+      materialize();
+    }
+    return m_values;
+  }
+
+  std::pmr::vector<T>& values()
+  {
+    if (!decoded()) {
+      materialize();
+    }
+    return m_values;
+  }
+
+  operator const std::pmr::vector<T>&() const { return values(); }
+
+  std::size_t size() const { return values().size(); }
+  // size() without decoding; exact for well-formed payloads.
+  std::size_t peekSize() const
+  {
+    if (decoded()) {
+      return m_values.size();
+    }
+    std::lock_guard<std::mutex> lock(detail::materializeMutex(this));
+    return m_ready.load(std::memory_order_relaxed)
+        ? m_values.size()
+        : base64::decodedCount<T>(m_encoded);
+  }
+  bool empty() const { return values().empty(); }
+  const T* data() const { return values().data(); }
+  const T& operator[](std::size_t i) const { return values()[i]; }
+  const_iterator begin() const { return values().begin(); }
+  const_iterator end() const { return values().end(); }
+
+  void push_back(const T& value) { values().push_back(value); }
+  template<typename It>
+  void assign(It first, It last)
+  {
+    values().assign(first, last);
+  }
+
+  friend bool operator==(const LazyArray& lhs, const LazyArray& rhs)
+  {
+    return lhs.values() == rhs.values();
+  }
+
+private:
+  void materialize() const
+  {
+    std::lock_guard<std::mutex> lock(detail::materializeMutex(this));
+    if (m_ready.load(std::memory_order_relaxed)) {
+      return;
+    }
+    LIB_STATS_SCOPE(Decode);
+    LIB_TRACE_SCOPE("decode", "bytes", m_encoded.size());
+    base64::decodeInto(m_encoded, m_values);
+#if LIB_STATS
+    // Lenient decoding stops at the first bad character or drops a partial
+    // trailing value; either way fewer bytes come out than were encoded.
+    if (m_values.size() * sizeof(T) != base64::decodedSize(m_encoded)) {
+      LIB_STATS_ADD(DecodeFailures, 1);
+    }
+#endif
+    std::string().swap(m_encoded);
+    m_ready.store(true, std::memory_order_release);
+  }
+
+  void copyFrom(const LazyArray& other)
+  {
+    std::lock_guard<std::mutex> lock(detail::materializeMutex(&other));
+    m_values = other.m_values;
+    m_encoded = other.m_encoded;
+    m_ready.store(other.m_ready.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+  }
+
+  void moveFrom(LazyArray& other)
+  {
+    m_values = std::move(other.m_values);
+    m_encoded = std::move(other.m_encoded);
+    m_ready.store(other.m_ready.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    other.m_ready.store(true, std::memory_order_relaxed);
+  }
+
+  mutable std::pmr::vector<T> m_values;
+  mutable std::string m_encoded;
+  mutable std::atomic<bool> m_ready {true};
+};
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_MODELS_LAZY_ARRAY_HPP
@@ -4,6 +4,7 @@
 #define LIB_MODELS_LIBRARY_HPP
 
 #include <map>
+#include <memory_resource>
 
 #include <boost/property_tree/ptree.hpp>
 
@@ -15,20 +16,37 @@
 namespace LIB_NAMESPACE
 {
 
+class LibraryReader;
+
+// Compounds, their spectra, strings and decoded peak arrays all come from
+// the memory resource the library is constructed with, the default resource
+// unless one is given.
 struct Library
 {
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   tLibraryID LibraryID = NULL;
   bool AccurateMass = false;
-  std::map<tCompoundID, Compound> Compounds = {};
+  std::pmr::map<tCompoundID, Compound> Compounds = {};
 
   Library() = default;
+  explicit Library(const allocator_type& allocator);
   Library(const Library&) = default;
   Library& operator=(const Library&) = default;
   Library(Library&&) = default;
   Library& operator=(Library&&) = default;
   ~Library() = default;
 
-  Library(boost::property_tree::ptree);
+  Library(const boost::property_tree::ptree&);
+  Library(LibraryReader& reader,
+          Projection projection = Projection::All,
+          const allocator_type& allocator = {});
+
+  allocator_type get_allocator() const { return Compounds.get_allocator(); }
+
+  // Adds a record, enforcing that every spectrum belongs to a known compound.
+  void insert(Compound compound);
+  void insert(Spectrum spectrum);
 };
 
 } // namespace LIB_NAMESPACE
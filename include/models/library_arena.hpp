@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef LIB_MODELS_LIBRARY_ARENA_HPP
+#define LIB_MODELS_LIBRARY_ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE
+{
+
+// Monotonic arena for a Library that is built once, read many times and
+// freed all at once. Allocating is a pointer bump into blocks that grow
+// geometrically, deallocating does nothing, and the blocks go back upstream
+// together on release() or destruction.
+//
+// Build the library with the arena and keep the arena alive for longer:
+//
+//   LibraryArena arena;
+//   Library library = readLibrary(path, Projection::All, 1, &arena);
+//
+// Like any monotonic resource it is not thread-safe; readLibraryParallel()
+// only allocates from it on the calling thread. Memory the library gives
+// back before the end, such as replaced records, is not reused.
+class LibraryArena : public std::pmr::monotonic_buffer_resource
+{
+public:
+  static constexpr std::size_t kDefaultBlockSize = std::size_t(1) << 20;
+
+  explicit LibraryArena(
+      std::size_t blockSize = kDefaultBlockSize,
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+  LibraryArena(const LibraryArena&) = delete;
+  LibraryArena& operator=(const LibraryArena&) = delete;
+
+  // Bytes handed out since construction or the last release().
+  std::size_t used() const { return m_used; }
+
+  // Returns every block upstream. Anything still allocated from the arena
+  // must not be used, nor destroyed, afterwards.
+  void release();
+
+protected:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+private:
+  std::size_t m_used = 0;
+};
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_MODELS_LIBRARY_ARENA_HPP
@@ -3,14 +3,26 @@
 #ifndef LIB_MODELS_METHOD_HPP
 #define LIB_MODELS_METHOD_HPP
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <string>
 #include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/property_tree/ptree.hpp>
 
 #include <defines.inc.hpp>
 #include <types.hpp>
 
+#include "models/fields.hpp"
 #include "models/library.hpp"
 
 namespace LIB_NAMESPACE
@@ -21,6 +33,8 @@ struct Parameter
   struct attrs_t
   {
     std::string id;
+
+    bool operator==(const attrs_t&) const = default;
   } attrs;
 
   std::string DisplayName;
@@ -35,10 +49,16 @@ struct Parameter
       struct attrs
       {
         std::string type = "Inclusive";
+
+        bool operator==(const attrs&) const = default;
       } attr;
 
       std::string value;
+
+      bool operator==(const Limit_T&) const = default;
     } Minimum, Maximum;
+
+    bool operator==(const Limits_T&) const = default;
   };
 
   std::optional<Limits_T> Limits;
@@ -49,6 +69,8 @@ struct Parameter
   std::optional<std::string> PrecisionDigits;
   std::optional<std::string> ConversionSupport;
 
+  bool operator==(const Parameter&) const = default;
+
   operator boost::property_tree::ptree() const;
 };
 
@@ -62,6 +84,8 @@ struct IntegrationParameters
       std::string assembly = "";
       std::string class_ =
           "Agilent.MassSpectrometry.DataAnalysis.PSetRTEIntegrator";
+
+      bool operator==(const attrs_t&) const = default;
     } attrs;
 
     Parameter DataPointSampling = {
@@ -162,27 +186,71 @@ struct IntegrationParameters
         .Default = "Tangent",
     };
 
+    bool operator==(const ParameterSet_T&) const = default;
+
     operator boost::property_tree::ptree() const;
 
   } ParameterSet;
 
+  bool operator==(const IntegrationParameters&) const = default;
 };  // struct IntegrationParameters
 
-struct TargetCompound
+// The XML document a TargetCompound embeds for its integration parameters,
+// together with the parameter set it was encoded from.
+struct EncodedParameterSet
+{
+  IntegrationParameters::ParameterSet_T ParameterSet;
+  std::string Xml;
+};
+
+// Process-wide, content-keyed intern table for encoded parameter sets.
+// Nearly every target uses the default set, so it is encoded once and the
+// targets share the result. Thread-safe.
+class ParameterSetCache
+{
+public:
+  static ParameterSetCache& instance();
+
+  std::shared_ptr<const EncodedParameterSet> intern(
+      const IntegrationParameters::ParameterSet_T& parameterSet);
+
+  std::uint64_t hits() const { return m_hits.load(std::memory_order_relaxed); }
+  std::uint64_t misses() const
+  {
+    return m_misses.load(std::memory_order_relaxed);
+  }
+  // Fraction of lookups served without encoding, 0 before the first one.
+  double hitRate() const;
+  std::size_t size() const;
+
+  // Drops the table and resets the counters; outstanding handles stay valid.
+  void clear();
+
+private:
+  mutable std::mutex m_mutex;
+  std::unordered_multimap<std::size_t,
+                          std::shared_ptr<const EncodedParameterSet>>
+      m_entries;
+  std::atomic<std::uint64_t> m_hits = 0;
+  std::atomic<std::uint64_t> m_misses = 0;
+};
+
+// The TargetCompound fields that are not set from import. Nearly every
+// target keeps the defaults, so targets refer to a shared instance instead
+// of holding their own copy.
+struct TargetSettings
 {
   int BatchID = -1;
   int SampleID = -1;
-  const unsigned int CompoundID;  // Set from import
   int AccuracyLimitMultiplierLOQ = 1;
   int AccuracyMaximumPercentDeviation = 20;
-  std::string CompoundName;  // Set from import
   std::string CompoundType = "Target";
   std::string ConcentrationUnits = "ng/mL";
   std::string CurveFit = "fitLinear";
   std::string CurveFitOrigin = "originIgnore";
   std::string CurveFitWeight = "weightEqual";
 
-  IntegrationParameters IntegrationParameters;
+  LIB_NAMESPACE::IntegrationParameters IntegrationParameters;
 
   bool IntegrationParametersModified = false;
   std::string Integrator = "Agile2";
@@ -191,7 +259,6 @@ struct TargetCompound
   float LeftRetentionTimeDelta = 1;
   unsigned int MaximumNumberOfHits = 1;
   float Multiplier = 1;
-  float MZ;  // Set from import
   float MZExtractionWindowFilterLeft = 0.3f;
   float MZExtractionWindowFilterRight = 0.7f;
   std::string MZExtractionWindowUnits = "Thomsons";
@@ -204,7 +271,6 @@ struct TargetCompound
   std::string PeakSelectionCriterion = "CloseRTQual";
   unsigned int PrimaryHitPeakID = 0;
   bool QuantitateByHeight = false;
-  float RetentionTime;  // Set from import
   std::string RetentionTimeDeltaUnits = "Minutes";
   float RetentionTimeWindow = 10;
   std::string RetentionTimeWindowUnits = "Percent";
@@ -220,16 +286,172 @@ struct TargetCompound
   unsigned int ThresholdNumberOfPeaks = 100;
   bool TimeReferenceFlag = false;
   unsigned int TimeSegment = 1;
-  float Transition;  // Set from import
   std::string UncertaintyRelativeOrAbsolute = "Relative";
 
+  bool operator==(const TargetSettings&) const = default;
+};
+
+// Immutable TargetSettings together with the encoding of their integration
+// parameters, shared by every target that uses them.
+struct SharedTargetSettings
+{
+  TargetSettings Values;
+  std::shared_ptr<const EncodedParameterSet> EncodedIntegrationParameters;
+
+  // Encodes the parameter set through ParameterSetCache. Values equal to the
+  // defaults give back defaults().
+  static std::shared_ptr<const SharedTargetSettings> make(
+      TargetSettings values);
+  // The process-wide instance holding default-constructed TargetSettings.
+  static const std::shared_ptr<const SharedTargetSettings>& defaults();
+};
+
+struct TargetCompound
+{
+  const unsigned int CompoundID;  // Set from import
+  std::string CompoundName;  // Set from import
+  float MZ;  // Set from import
+  float RetentionTime;  // Set from import
+  float Transition;  // Set from import
+
+  // Everything else. Targets with the same settings may share this handle,
+  // so change them through edit() rather than in place.
+  std::shared_ptr<const SharedTargetSettings> Settings =
+      SharedTargetSettings::defaults();
+
+  const TargetSettings& settings() const { return Settings->Values; }
+
+  // Points this target at an edited copy of its settings; targets that
+  // shared the old ones are left as they were.
+  template<typename Edit>
+  void edit(Edit&& edit)
+  {
+    TargetSettings values = settings();
+    std::forward<Edit>(edit)(values);
+    Settings = SharedTargetSettings::make(std::move(values));
+  }
+
+  std::shared_ptr<const EncodedParameterSet> encodedIntegrationParameters()
+      const
+  {
+    return Settings->EncodedIntegrationParameters;
+  }
+
+  const std::string& integrationParametersXml() const
+  {
+    return Settings->EncodedIntegrationParameters->Xml;
+  }
+
+  // The value behind a kTargetCompoundFields member, which belongs either
+  // to the target or to its settings.
+  template<typename Member>
+  decltype(auto) value(Member member) const
+  {
+    if constexpr (std::is_invocable_v<Member, const TargetCompound&>) {
+      return std::invoke(member, *this);
+    } else {
+      return std::invoke(member, settings());
+    }
+  }
+
   operator boost::property_tree::ptree() const;
 };
 
+// The elements of a <TargetCompound>, in document order. Members are of
+// TargetCompound or of TargetSettings; read them through
+// TargetCompound::value().
+inline constexpr auto kTargetCompoundFields = std::tuple {
+    fields::field("BatchID", &TargetSettings::BatchID),
+    fields::field("SampleID", &TargetSettings::SampleID),
+    fields::field("CompoundID", &TargetCompound::CompoundID),
+    fields::field("AccuracyLimitMultiplierLOQ",
+                  &TargetSettings::AccuracyLimitMultiplierLOQ),
+    fields::field("AccuracyMaximumPercentDeviation",
+                  &TargetSettings::AccuracyMaximumPercentDeviation),
+    fields::field("CompoundName", &TargetCompound::CompoundName),
+    fields::field("CompoundType", &TargetSettings::CompoundType),
+    fields::field("ConcentrationUnits", &TargetSettings::ConcentrationUnits),
+    fields::field("CurveFit", &TargetSettings::CurveFit),
+    fields::field("CurveFitOrigin", &TargetSettings::CurveFitOrigin),
+    fields::field("CurveFitWeight", &TargetSettings::CurveFitWeight),
+    fields::field("IntegrationParameters",
+                  &TargetCompound::integrationParametersXml),
+    fields::field("IntegrationParametersModified",
+                  &TargetSettings::IntegrationParametersModified),
+    fields::field("Integrator", &TargetSettings::Integrator),
+    fields::field("IonPolarity", &TargetSettings::IonPolarity),
+    fields::field("ISTDFlag", &TargetSettings::ISTDFlag),
+    fields::field("LeftRetentionTimeDelta",
+                  &TargetSettings::LeftRetentionTimeDelta),
+    fields::field("MaximumNumberOfHits", &TargetSettings::MaximumNumberOfHits),
+    fields::field("Multiplier", &TargetSettings::Multiplier),
+    fields::field("MZ", &TargetCompound::MZ),
+    fields::field("MZExtractionWindowFilterLeft",
+                  &TargetSettings::MZExtractionWindowFilterLeft),
+    fields::field("MZExtractionWindowFilterRight",
+                  &TargetSettings::MZExtractionWindowFilterRight),
+    fields::field("MZExtractionWindowUnits",
+                  &TargetSettings::MZExtractionWindowUnits),
+    fields::field("NoiseAlgorithmType", &TargetSettings::NoiseAlgorithmType),
+    fields::field("NoiseOfRawSignal", &TargetSettings::NoiseOfRawSignal),
+    fields::field("NoiseReference", &TargetSettings::NoiseReference),
+    fields::field("NoiseStandardDeviationMultiplier",
+                  &TargetSettings::NoiseStandardDeviationMultiplier),
+    fields::field("PeakFilterThreshold", &TargetSettings::PeakFilterThreshold),
+    fields::field("PeakFilterThresholdValue",
+                  &TargetSettings::PeakFilterThresholdValue),
+    fields::field("PeakSelectionCriterion",
+                  &TargetSettings::PeakSelectionCriterion),
+    fields::field("PrimaryHitPeakID", &TargetSettings::PrimaryHitPeakID),
+    fields::field("QuantitateByHeight", &TargetSettings::QuantitateByHeight),
+    fields::field("RetentionTime", &TargetCompound::RetentionTime),
+    fields::field("RetentionTimeDeltaUnits",
+                  &TargetSettings::RetentionTimeDeltaUnits),
+    fields::field("RetentionTimeWindow", &TargetSettings::RetentionTimeWindow),
+    fields::field("RetentionTimeWindowUnits",
+                  &TargetSettings::RetentionTimeWindowUnits),
+    fields::field("RightRetentionTimeDelta",
+                  &TargetSettings::RightRetentionTimeDelta),
+    fields::field("ScanType", &TargetSettings::ScanType),
+    fields::field("SelectedMZ", &TargetSettings::SelectedMZ),
+    fields::field("SignalType", &TargetSettings::SignalType),
+    fields::field("Smoothing", &TargetSettings::Smoothing),
+    fields::field("SmoothingFunctionWidth",
+                  &TargetSettings::SmoothingFunctionWidth),
+    fields::field("SmoothingGaussianWidth",
+                  &TargetSettings::SmoothingGaussianWidth),
+    fields::field("SpectrumExtractionOverride",
+                  &TargetSettings::SpectrumExtractionOverride),
+    fields::field("SpectrumScanInclusion",
+                  &TargetSettings::SpectrumScanInclusion),
+    fields::field("ThresholdNumberOfPeaks",
+                  &TargetSettings::ThresholdNumberOfPeaks),
+    fields::field("TimeReferenceFlag", &TargetSettings::TimeReferenceFlag),
+    fields::field("TimeSegment", &TargetSettings::TimeSegment),
+    fields::field("Transition", &TargetCompound::Transition),
+    fields::field("UncertaintyRelativeOrAbsolute",
+                  &TargetSettings::UncertaintyRelativeOrAbsolute)};
+
 struct QuantitationDataSet
 {
+  // Serves the Targets array; target names stay on the heap and settings
+  // are shared.
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   QuantitationDataSet() = default;
-  QuantitationDataSet(const Library& library);
+  explicit QuantitationDataSet(const allocator_type& allocator);
+  // One target per compound, in CompoundID order. With more than one thread
+  // the targets are built concurrently; the result is the same.
+  QuantitationDataSet(const Library& library,
+                      unsigned threads = 1,
+                      const allocator_type& allocator = {});
+  QuantitationDataSet(const QuantitationDataSet&) = default;
+  QuantitationDataSet(QuantitationDataSet&&) = default;
+  // Keeps this set's allocator. TargetCompound cannot be assigned, so
+  // across resources the targets are moved over one by one.
+  QuantitationDataSet& operator=(QuantitationDataSet&& other);
+
+  allocator_type get_allocator() const { return Targets.get_allocator(); }
 
   struct attrs
   {
@@ -276,7 +498,7 @@ struct QuantitationDataSet
     std::string xmlns = "Quantitation";
   } attr;
 
-  std::vector<TargetCompound> Targets;
+  std::pmr::vector<TargetCompound> Targets;
 
   void addTarget(const Compound& compound);
   // Qualifiers
@@ -284,6 +506,84 @@ struct QuantitationDataSet
   operator boost::property_tree::ptree() const;
 };
 
+// The attributes of <QuantitationDataSet>, in document order.
+inline constexpr auto kQuantitationDataSetAttributeFields = std::tuple {
+    fields::field("SchemaVersion", &QuantitationDataSet::attrs::SchemaVersion),
+    fields::field("DataVersion", &QuantitationDataSet::attrs::DataVersion),
+    fields::field("BatchState", &QuantitationDataSet::attrs::BatchState),
+    fields::field("ReferenceWindow",
+                  &QuantitationDataSet::attrs::ReferenceWindow),
+    fields::field("ReferenceWindowPercentOrMinutes",
+                  &QuantitationDataSet::attrs::ReferenceWindowPercentOrMinutes),
+    fields::field("NonReferenceWindow",
+                  &QuantitationDataSet::attrs::NonReferenceWindow),
+    fields::field(
+        "NonReferenceWindowPercentOrMinutes",
+        &QuantitationDataSet::attrs::NonReferenceWindowPercentOrMinutes),
+    fields::field("CorrelationWindow",
+                  &QuantitationDataSet::attrs::CorrelationWindow),
+    fields::field("ApplyMultiplierTarget",
+                  &QuantitationDataSet::attrs::ApplyMultiplierTarget),
+    fields::field("ApplyMultiplierSurrogate",
+                  &QuantitationDataSet::attrs::ApplyMultiplierSurrogate),
+    fields::field("ApplyMultiplierMatrixSpike",
+                  &QuantitationDataSet::attrs::ApplyMultiplierMatrixSpike),
+    fields::field("ApplyMultiplierISTD",
+                  &QuantitationDataSet::attrs::ApplyMultiplierISTD),
+    fields::field("IgnorePeaksNotFound",
+                  &QuantitationDataSet::attrs::IgnorePeaksNotFound),
+    fields::field("RelativeISTD", &QuantitationDataSet::attrs::RelativeISTD),
+    fields::field("AuditTrail", &QuantitationDataSet::attrs::AuditTrail),
+    fields::field("LibraryPathFileName",
+                  &QuantitationDataSet::attrs::LibraryPathFileName),
+    fields::field("LibraryMethodPathFileName",
+                  &QuantitationDataSet::attrs::LibraryMethodPathFileName),
+    fields::field("RefLibraryPathFileName",
+                  &QuantitationDataSet::attrs::RefLibraryPathFileName),
+    fields::field("RefLibraryPatternPathFileName",
+                  &QuantitationDataSet::attrs::RefLibraryPatternPathFileName),
+    fields::field("CCMaximumElapsedTimeInHours",
+                  &QuantitationDataSet::attrs::CCMaximumElapsedTimeInHours),
+    fields::field("BracketingType",
+                  &QuantitationDataSet::attrs::BracketingType),
+    fields::field("StandardAddition",
+                  &QuantitationDataSet::attrs::StandardAddition),
+    fields::field("DynamicBackgroundSubtraction",
+                  &QuantitationDataSet::attrs::DynamicBackgroundSubtraction),
+    fields::field("BatchName", &QuantitationDataSet::attrs::BatchName),
+    fields::field("BatchDataPathFileName",
+                  &QuantitationDataSet::attrs::BatchDataPathFileName),
+    fields::field("DAMethodPathFileNameOrigin",
+                  &QuantitationDataSet::attrs::DAMethodPathFileNameOrigin),
+    fields::field("AnalystName", &QuantitationDataSet::attrs::AnalystName),
+    fields::field("ReportGeneratorName",
+                  &QuantitationDataSet::attrs::ReportGeneratorName),
+    fields::field("AnalysisTimeStamp",
+                  &QuantitationDataSet::attrs::AnalysisTimeStamp),
+    fields::field("DAMethodLastAppliedTimeStamp",
+                  &QuantitationDataSet::attrs::DAMethodLastAppliedTimeStamp),
+    fields::field("CalibrationLastUpdatedTimeStamp",
+                  &QuantitationDataSet::attrs::CalibrationLastUpdatedTimeStamp),
+    fields::field(
+        "ReportGenerationStartedTimeStamp",
+        &QuantitationDataSet::attrs::ReportGenerationStartedTimeStamp),
+    fields::field("ReportResultsDataPathFileName",
+                  &QuantitationDataSet::attrs::ReportResultsDataPathFileName),
+    fields::field("AnalyzeQuantVersion",
+                  &QuantitationDataSet::attrs::AnalyzeQuantVersion),
+    fields::field("ReportQuantVersion",
+                  &QuantitationDataSet::attrs::ReportQuantVersion),
+    fields::field("ComplianceName",
+                  &QuantitationDataSet::attrs::ComplianceName),
+    fields::field("ComplianceVersion",
+                  &QuantitationDataSet::attrs::ComplianceVersion),
+    fields::field("ComplianceServer",
+                  &QuantitationDataSet::attrs::ComplianceServer),
+    fields::field("FeatureDetection",
+                  &QuantitationDataSet::attrs::FeatureDetection),
+    fields::field("HashCode", &QuantitationDataSet::attrs::HashCode),
+    fields::field("xmlns", &QuantitationDataSet::attrs::xmlns)};
+
 } // namespace LIB_NAMESPACE
 
 #endif // LIB_MODELS_METHOD_HPP
@@ -0,0 +1,200 @@
+#pragma once
+
+#ifndef LIB_MODELS_SPECTRAL_STORE_HPP
+#define LIB_MODELS_SPECTRAL_STORE_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "models/library.hpp"
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+class MappedLibrary;
+class SpectralStore;
+
+// Read-only handle to one spectrum of a SpectralStore. Peaks are the pairs
+// (MzValues[i], AbundanceValues[i]); both spans have the same length.
+struct SpectrumView
+{
+  tLibraryID LibraryID;
+  tCompoundID CompoundID;
+  tSpectrumID SpectrumID;
+  float BasePeakMZ;
+
+  std::span<const Spectrum::tMzValue> MzValues;
+  std::span<const Spectrum::tAbundanceValue> AbundanceValues;
+};
+
+// Index range over a SpectralStore that yields views by value, so loops read
+// like the ones over the model maps without materializing anything.
+template<typename View>
+class ViewRange
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = View;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = View;
+
+    iterator() = default;
+    iterator(const SpectralStore* store, std::size_t index)
+        : m_store(store)
+        , m_index(index)
+    {
+    }
+
+    View operator*() const;
+    iterator& operator++()
+    {
+      ++m_index;
+      return *this;
+    }
+    iterator operator++(int)
+    {
+      iterator copy = *this;
+      ++m_index;
+      return copy;
+    }
+    bool operator==(const iterator& other) const = default;
+
+  private:
+    const SpectralStore* m_store = nullptr;
+    std::size_t m_index = 0;
+  };
+
+  ViewRange() = default;
+  ViewRange(const SpectralStore* store, std::size_t first, std::size_t last)
+      : m_store(store)
+      , m_first(first)
+      , m_last(last)
+  {
+  }
+
+  iterator begin() const { return {m_store, m_first}; }
+  iterator end() const { return {m_store, m_last}; }
+  std::size_t size() const { return m_last - m_first; }
+  bool empty() const { return m_first == m_last; }
+  View operator[](std::size_t i) const
+  {
+    return *iterator(m_store, m_first + i);
+  }
+  View front() const { return (*this)[0]; }
+
+private:
+  const SpectralStore* m_store = nullptr;
+  std::size_t m_first = 0;
+  std::size_t m_last = 0;
+};
+
+using SpectrumRange = ViewRange<SpectrumView>;
+
+struct CompoundView
+{
+  tLibraryID LibraryID;
+  tCompoundID CompoundID;
+
+  std::string_view CASNumber;
+  std::string_view CompoundName;
+  std::string_view Formula;
+  float BoilingPoint;
+  float MeltingPoint;
+  float MolecularWeight;
+  float RetentionIndex;
+  float RetentionTimeRTL;
+
+  SpectrumRange Spectra;
+};
+
+using CompoundRange = ViewRange<CompoundView>;
+
+// Flat, structure-of-arrays copy of a library for linear scans.
+//
+// Compounds are sorted by ID and own the CSR range
+// [SpectrumOffsets[c], SpectrumOffsets[c + 1]) of the spectrum columns;
+// spectra own [PeakOffsets[s], PeakOffsets[s + 1]) of the peak columns. All
+// peaks of the library therefore sit in two contiguous arrays.
+//
+// Peaks are sorted by m/z within each spectrum as they are added, whatever
+// their order in the source, so matchers can merge rather than scan.
+class SpectralStore
+{
+public:
+  SpectralStore() = default;
+  explicit SpectralStore(const Library& library);
+  explicit SpectralStore(const MappedLibrary& library);
+
+  tLibraryID LibraryID = 0;
+  bool AccurateMass = false;
+
+  std::size_t compoundCount() const { return CompoundIDs.size(); }
+  std::size_t spectrumCount() const { return SpectrumIDs.size(); }
+  std::size_t peakCount() const { return MzValues.size(); }
+
+  CompoundRange compounds() const { return {this, 0, compoundCount()}; }
+  SpectrumRange spectra() const { return {this, 0, spectrumCount()}; }
+
+  CompoundView compound(std::size_t index) const;
+  SpectrumView spectrum(std::size_t index) const;
+
+  // Index of `compoundID` in the compound columns, or compoundCount().
+  std::size_t find(tCompoundID compoundID) const;
+
+  // Compound columns
+  std::vector<tLibraryID> CompoundLibraryIDs;
+  std::vector<tCompoundID> CompoundIDs;
+  std::vector<std::string> CASNumbers;
+  std::vector<std::string> CompoundNames;
+  std::vector<std::string> Formulas;
+  std::vector<float> BoilingPoints;
+  std::vector<float> MeltingPoints;
+  std::vector<float> MolecularWeights;
+  std::vector<float> RetentionIndices;
+  std::vector<float> RetentionTimesRTL;
+  std::vector<std::size_t> SpectrumOffsets = {0};
+
+  // Spectrum columns
+  std::vector<tLibraryID> SpectrumLibraryIDs;
+  std::vector<tCompoundID> SpectrumCompoundIDs;
+  std::vector<tSpectrumID> SpectrumIDs;
+  std::vector<float> BasePeakMZs;
+  std::vector<std::size_t> PeakOffsets = {0};
+
+  // Peak columns
+  std::vector<Spectrum::tMzValue> MzValues;
+  std::vector<Spectrum::tAbundanceValue> AbundanceValues;
+
+private:
+  void reserve(std::size_t compounds, std::size_t spectra, std::size_t peaks);
+  void addCompound(const CompoundView& compound);
+  void addSpectrum(const SpectrumView& spectrum);
+};
+
+template<>
+inline CompoundView ViewRange<CompoundView>::iterator::operator*() const
+{
+  return m_store->compound(m_index);
+}
+
+template<>
+inline SpectrumView ViewRange<SpectrumView>::iterator::operator*() const
+{
+  return m_store->spectrum(m_index);
+}
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_MODELS_SPECTRAL_STORE_HPP
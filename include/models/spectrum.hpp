@@ -3,6 +3,8 @@
 #ifndef LIB_MODELS_SPECTRUM_HPP
 #define LIB_MODELS_SPECTRUM_HPP
 
+#include <memory_resource>
+#include <tuple>
 #include <vector>
 
 #include <boost/property_tree/ptree.hpp>
@@ -10,34 +12,73 @@
 #include <defines.inc.hpp>
 #include <types.hpp>
 
+#include "models/fields.hpp"
+#include "models/lazy_array.hpp"
+
 namespace LIB_NAMESPACE
 {
 
+// Peak columns a load keeps. Columns left out are not even retained in
+// encoded form and read back empty.
+enum class Projection : unsigned
+{
+  Metadata = 0,
+  MzValues = 1u << 0,
+  AbundanceValues = 1u << 1,
+  All = MzValues | AbundanceValues
+};
+
+constexpr bool includes(Projection projection, Projection field)
+{
+  return (static_cast<unsigned>(projection) & static_cast<unsigned>(field))
+      == static_cast<unsigned>(field);
+}
+
 // TODO: Documentation
 // TODO: Check cache miss for structure layout
 struct Spectrum
 {
+  // Allocator-aware, so the peak arrays of spectra held in a pmr container
+  // come from that container's memory resource.
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
   tLibraryID LibraryID;
   tCompoundID CompoundID;
   tSpectrumID SpectrumID;
   float BasePeakMZ;
 
+  // Peak arrays read from XML stay base64-encoded until first accessed.
   typedef double tMzValue;
-  std::vector<tMzValue> MzValues;
+  LazyArray<tMzValue> MzValues;
 
   typedef double tAbundanceValue;
-  std::vector<tAbundanceValue> AbundanceValues;
+  LazyArray<tAbundanceValue> AbundanceValues;
 
-  Spectrum(boost::property_tree::ptree tree);
+  Spectrum(const boost::property_tree::ptree& tree,
+           Projection projection = Projection::All,
+           const allocator_type& allocator = {});
   Spectrum() = default;
+  explicit Spectrum(const allocator_type& allocator);
   Spectrum(const Spectrum&) = default;
+  Spectrum(const Spectrum& other, const allocator_type& allocator);
   Spectrum& operator=(const Spectrum&) = default;
   Spectrum(Spectrum&&) = default;
+  Spectrum(Spectrum&& other, const allocator_type& allocator);
   Spectrum& operator=(Spectrum&&) = default;
   ~Spectrum() = default;
 
+  allocator_type get_allocator() const { return MzValues.get_allocator(); }
+
 };
 
+// The scalar elements of a <Spectrum> record, read by the ptree
+// constructor; the peak columns are handled there.
+inline constexpr auto kSpectrumFields = std::tuple {
+    fields::field("LibraryID", &Spectrum::LibraryID),
+    fields::field("CompoundID", &Spectrum::CompoundID),
+    fields::field("SpectrumID", &Spectrum::SpectrumID),
+    fields::field("BasePeakMZ", &Spectrum::BasePeakMZ)};
+
 } // namespace LIB_NAMESPACE
 
 #endif  // LIB_MODELS_SPECTRUM_HPP
@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef LIB_PARALLEL_WORK_STEALING_POOL_HPP
+#define LIB_PARALLEL_WORK_STEALING_POOL_HPP
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE
+{
+
+// Resolves a --threads value; 0 means one thread per hardware thread.
+unsigned resolveThreads(unsigned requested);
+
+// Splits items [0, weights.size()) into contiguous batches of roughly equal
+// total weight, aiming for `batchesPerThread` batches per thread so that
+// stealing has something to even out. Returns the batch boundaries, starting
+// with 0 and ending with weights.size().
+std::vector<std::size_t> partitionByWeight(
+    std::span<const std::uint64_t> weights,
+    unsigned threads,
+    unsigned batchesPerThread = 16);
+
+// Runs a fixed set of indexed tasks on a group of threads.
+//
+// Tasks are dealt round-robin into one deque per worker. Owners pop from the
+// front, so tasks finish roughly in index order; an idle worker steals from
+// the back of another worker's deque. With a single thread the tasks run
+// inline on the caller.
+class WorkStealingPool
+{
+public:
+  using Task = std::function<void(std::size_t task, unsigned worker)>;
+
+  explicit WorkStealingPool(unsigned threads);
+
+  unsigned threads() const { return m_threads; }
+
+  // Calls task(i, worker) once for every i in [0, tasks) and returns when
+  // all have run. The first exception thrown by a task is rethrown here once
+  // the workers have stopped; remaining tasks are abandoned.
+  void run(std::size_t tasks, const Task& task) const;
+
+private:
+  unsigned m_threads;
+};
+
+// Reorder buffer that passes chunks produced out of order to a sink in index
+// order. Whoever completes the next expected chunk writes it, together with
+// any later chunks that are already waiting or arrive while it writes. The
+// sink is only ever called by one thread at a time, and never under the lock
+// that the other threads need to hand in their chunks. Sink errors propagate
+// to the writing thread's caller; the ostream sink throws when the stream
+// fails.
+class OrderedWriter
+{
+public:
+  using Sink = std::function<void(std::string_view chunk)>;
+
+  OrderedWriter(std::ostream& output, std::size_t chunks);
+  OrderedWriter(Sink sink, std::size_t chunks);
+
+  void write(std::size_t index, std::string chunk);
+
+  // Number of chunks written to the stream so far.
+  std::size_t written() const;
+
+private:
+  mutable std::mutex m_mutex;
+  Sink m_sink;
+  std::vector<std::string> m_chunks;
+  std::vector<bool> m_ready;
+  std::size_t m_next = 0;
+  std::size_t m_written = 0;
+  bool m_writing = false;
+};
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_PARALLEL_WORK_STEALING_POOL_HPP
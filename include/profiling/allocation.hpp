@@ -0,0 +1,114 @@
+#pragma once
+
+#ifndef LIB_PROFILING_ALLOCATION_HPP
+#define LIB_PROFILING_ALLOCATION_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE::allocation
+{
+
+enum class Subsystem
+{
+  // The library being converted or scored against.
+  Library,
+  // Query spectra for LibrarySearch.
+  Queries,
+  // The quantitation method built from the library.
+  Method,
+  Count
+};
+
+inline constexpr std::size_t kSubsystems =
+    static_cast<std::size_t>(Subsystem::Count);
+
+const char* name(Subsystem subsystem);
+
+struct Usage
+{
+  // Live bytes and their high-water mark.
+  std::uint64_t Bytes = 0;
+  std::uint64_t PeakBytes = 0;
+  // Everything ever handed out, including what has been returned.
+  std::uint64_t TotalBytes = 0;
+  std::uint64_t Allocations = 0;
+  std::uint64_t Deallocations = 0;
+};
+
+// Passes every request on to `upstream` and counts it, here and in
+// `parent` if there is one. Thread-safe as long as `upstream` is.
+class TrackingResource : public std::pmr::memory_resource
+{
+public:
+  explicit TrackingResource(
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource(),
+      TrackingResource* parent = nullptr);
+
+  TrackingResource(const TrackingResource&) = delete;
+  TrackingResource& operator=(const TrackingResource&) = delete;
+
+  Usage usage() const;
+  // Zeroes the totals and starts the peak again from the live bytes, which
+  // are kept so that later deallocations still balance.
+  void reset();
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void* pointer,
+                     std::size_t bytes,
+                     std::size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept
+      override;
+
+  void allocated(std::uint64_t bytes);
+  void deallocated(std::uint64_t bytes);
+
+  std::pmr::memory_resource* m_upstream;
+  TrackingResource* m_parent;
+  std::atomic<std::uint64_t> m_bytes = 0;
+  std::atomic<std::uint64_t> m_peak = 0;
+  std::atomic<std::uint64_t> m_total = 0;
+  std::atomic<std::uint64_t> m_allocations = 0;
+  std::atomic<std::uint64_t> m_deallocations = 0;
+};
+
+// Resets the per-subsystem resources and routes resource() through them.
+// Objects built before this keep the resource they were built with.
+void enable();
+void disable();
+bool enabled();
+
+// The tracking resource for `subsystem` once enabled, the default resource
+// otherwise; pass it to the models' allocator-extended constructors.
+std::pmr::memory_resource* resource(Subsystem subsystem);
+
+struct Snapshot
+{
+  std::array<Usage, kSubsystems> Subsystems {};
+  // All subsystems together; its peak is the largest combined footprint,
+  // not the sum of the individual peaks.
+  Usage Total;
+
+  const Usage& operator[](Subsystem subsystem) const
+  {
+    return Subsystems[static_cast<std::size_t>(subsystem)];
+  }
+};
+
+Snapshot snapshot();
+
+void report(const Snapshot& snapshot, std::ostream& output);
+void writeJson(const Snapshot& snapshot, std::ostream& output);
+void writeJson(const Snapshot& snapshot, const std::string& path);
+
+}  // namespace LIB_NAMESPACE::allocation
+
+#endif  // LIB_PROFILING_ALLOCATION_HPP
@@ -0,0 +1,20 @@
+#pragma once
+
+#ifndef LIB_PROFILING_HEAP_COUNTER_HPP
+#define LIB_PROFILING_HEAP_COUNTER_HPP
+
+#include <cstdint>
+
+#include <defines.inc.hpp>
+
+namespace LIB_NAMESPACE::allocation
+{
+
+// Calls to the global operator new so far. Only executables that link the
+// MassHunterLibToQuant_heap_counter target have the counting operators; the
+// tools keep the standard ones.
+std::uint64_t heapAllocations();
+
+}  // namespace LIB_NAMESPACE::allocation
+
+#endif  // LIB_PROFILING_HEAP_COUNTER_HPP
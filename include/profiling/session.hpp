@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef LIB_PROFILING_SESSION_HPP
+#define LIB_PROFILING_SESSION_HPP
+
+#include <list>
+#include <memory_resource>
+#include <string>
+
+#include <boost/program_options/options_description.hpp>
+
+#include <defines.inc.hpp>
+
+#include "models/library_arena.hpp"
+#include "profiling/allocation.hpp"
+
+namespace LIB_NAMESPACE::profiling
+{
+
+// The switches every tool shares: --arena and the profiling outputs.
+struct Options
+{
+  bool Arena = false;
+  bool Stats = false;
+  std::string StatsJson;
+  bool AllocStats = false;
+  std::string AllocStatsJson;
+  std::string TraceFile;
+};
+
+// Adds --arena, --stats, --stats-json, --alloc-stats, --alloc-stats-json and
+// --trace to `desc`, parsed into `options`.
+void addOptions(boost::program_options::options_description& desc,
+                Options& options);
+
+// One run of a tool. Construct it once the command line is parsed, which
+// starts whatever profiling was asked for; call finish() at the end to
+// report it. Libraries built in resource() must not outlive the session.
+class Session
+{
+public:
+  explicit Session(const Options& options);
+
+  Session(const Session&) = delete;
+  Session& operator=(const Session&) = delete;
+
+  // Where to build a library: the subsystem's resource, under a fresh arena
+  // with --arena.
+  std::pmr::memory_resource* resource(allocation::Subsystem subsystem);
+
+  // Frees the arenas handed out so far, once what was built in them is gone.
+  void releaseArenas();
+
+  // Prints and writes the reports asked for. A report that cannot be
+  // written is printed to stderr and gives false.
+  bool finish() const;
+
+private:
+  Options m_options;
+  std::list<LibraryArena> m_arenas;
+};
+
+}  // namespace LIB_NAMESPACE::profiling
+
+#endif  // LIB_PROFILING_SESSION_HPP
@@ -0,0 +1,175 @@
+#pragma once
+
+#ifndef LIB_PROFILING_STATS_HPP
+#define LIB_PROFILING_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include <defines.inc.hpp>
+
+// Built with -DLIB_STATS=0 the LIB_STATS_* macros expand to nothing and the
+// hot paths carry no instrumentation at all. Otherwise each one costs a
+// relaxed load until stats::enable() is called.
+#ifndef LIB_STATS
+#  define LIB_STATS 1
+#endif
+
+namespace LIB_NAMESPACE::stats
+{
+
+enum class Phase
+{
+  // Reading and parsing library files.
+  Read,
+  // Base64 decoding of peak arrays.
+  Decode,
+  // Building derived models: flat stores, methods, indexes.
+  Build,
+  // The tool's own work: scoring, searching, formatting.
+  Transform,
+  // Handing finished output to the operating system.
+  Write,
+  Count
+};
+
+enum class Counter
+{
+  Compounds,
+  Spectra,
+  Peaks,
+  DecodeFailures,
+  BytesRead,
+  BytesWritten,
+  Count
+};
+
+inline constexpr std::size_t kPhases = static_cast<std::size_t>(Phase::Count);
+inline constexpr std::size_t kCounters =
+    static_cast<std::size_t>(Counter::Count);
+
+const char* name(Phase phase);
+const char* name(Counter counter);
+
+namespace detail
+{
+
+struct Registry
+{
+  std::atomic<bool> Enabled {false};
+  std::atomic<std::int64_t> Start {0};
+  std::array<std::atomic<std::uint64_t>, kPhases> Nanoseconds {};
+  std::array<std::atomic<std::uint64_t>, kPhases> Calls {};
+  std::array<std::atomic<std::uint64_t>, kCounters> Counters {};
+};
+
+inline Registry g_registry;
+
+}  // namespace detail
+
+inline bool enabled()
+{
+  return detail::g_registry.Enabled.load(std::memory_order_relaxed);
+}
+
+// Clears the registry, starts the wall clock and turns recording on.
+void enable();
+void disable();
+
+inline void add(Counter counter, std::uint64_t value)
+{
+  if (enabled()) {
+    detail::g_registry.Counters[static_cast<std::size_t>(counter)].fetch_add(
+        value, std::memory_order_relaxed);
+  }
+}
+
+// Times the enclosing scope under `phase`. Scopes nest per thread and time
+// is exclusive: an inner scope pauses the one around it, so on one thread
+// the phases add up to the time spent in them. Scopes on worker threads are
+// summed over the threads and overlap the scope that started the workers.
+class ScopedTimer
+{
+public:
+  explicit ScopedTimer(Phase phase)
+  {
+    if (enabled()) {
+      begin(phase);
+    }
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+  ~ScopedTimer()
+  {
+    if (m_active) {
+      end();
+    }
+  }
+
+private:
+  void begin(Phase phase);
+  void end();
+
+  Phase m_phase = Phase::Read;
+  bool m_active = false;
+  std::int64_t m_start = 0;
+  std::int64_t m_elapsed = 0;
+  ScopedTimer* m_parent = nullptr;
+};
+
+struct PhaseSample
+{
+  double Seconds = 0;
+  std::uint64_t Calls = 0;
+};
+
+struct Snapshot
+{
+  // Since enable().
+  double WallSeconds = 0;
+  std::array<PhaseSample, kPhases> Phases {};
+  std::array<std::uint64_t, kCounters> Counters {};
+
+  const PhaseSample& operator[](Phase phase) const
+  {
+    return Phases[static_cast<std::size_t>(phase)];
+  }
+  std::uint64_t operator[](Counter counter) const
+  {
+    return Counters[static_cast<std::size_t>(counter)];
+  }
+};
+
+Snapshot snapshot();
+
+// Human-readable table; each phase's throughput is in the unit it works in:
+// MB/s of input for Read, peaks/s for Decode, MB/s of output for Write and
+// compounds/s otherwise.
+void report(const Snapshot& snapshot, std::ostream& output);
+void writeJson(const Snapshot& snapshot, std::ostream& output);
+void writeJson(const Snapshot& snapshot, const std::string& path);
+
+}  // namespace LIB_NAMESPACE::stats
+
+#define LIB_STATS_CONCAT_(a, b) a##b
+#define LIB_STATS_CONCAT(a, b) LIB_STATS_CONCAT_(a, b)
+
+#if LIB_STATS
+#  define LIB_STATS_SCOPE(phase) \
+    ::LIB_NAMESPACE::stats::ScopedTimer LIB_STATS_CONCAT( \
+        statsScope, __LINE__)(::LIB_NAMESPACE::stats::Phase::phase)
+#  define LIB_STATS_ADD(counter, value) \
+    ::LIB_NAMESPACE::stats::add(::LIB_NAMESPACE::stats::Counter::counter, \
+                                static_cast<std::uint64_t>(value))
+#else
+#  define LIB_STATS_SCOPE(phase) static_cast<void>(0)
+#  define LIB_STATS_ADD(counter, value) static_cast<void>(0)
+#endif
+
+#endif  // LIB_PROFILING_STATS_HPP
@@ -0,0 +1,114 @@
+#pragma once
+
+#ifndef LIB_PROFILING_TRACE_HPP
+#define LIB_PROFILING_TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <defines.inc.hpp>
+
+// Built with -DLIB_TRACE=0 the LIB_TRACE_SCOPE macro expands to nothing.
+// Otherwise a span costs a relaxed load until trace::enable() is called.
+#ifndef LIB_TRACE
+#  define LIB_TRACE 1
+#endif
+
+namespace LIB_NAMESPACE::trace
+{
+
+// A finished span. Names must outlive the trace; pass string literals.
+struct Event
+{
+  const char* Name = nullptr;
+  const char* ArgName = nullptr;
+  std::uint64_t Arg = 0;
+  // Nanoseconds since enable().
+  std::int64_t Begin = 0;
+  std::int64_t End = 0;
+  std::uint32_t Thread = 0;
+};
+
+inline constexpr std::size_t kDefaultCapacity = std::size_t(1) << 16;
+
+namespace detail
+{
+
+inline std::atomic<bool> g_enabled {false};
+
+}  // namespace detail
+
+inline bool enabled()
+{
+  return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+// Clears the buffers and starts recording. Each thread records into a ring
+// of `capacity` events of its own, so spans cost no locks; once a ring is
+// full its oldest events are overwritten. Buffers outlive their threads and
+// are reused by later ones. Call between runs, not while threads record.
+void enable(std::size_t capacity = kDefaultCapacity);
+void disable();
+
+std::int64_t now();
+void record(const Event& event);
+
+// Records the enclosing scope as one span on the calling thread, with an
+// optional integer argument such as a chunk or batch index.
+class Span
+{
+public:
+  explicit Span(const char* name,
+                const char* argName = nullptr,
+                std::uint64_t arg = 0)
+  {
+    if (enabled()) {
+      m_event.Name = name;
+      m_event.ArgName = argName;
+      m_event.Arg = arg;
+      m_event.Begin = now();
+    }
+  }
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  ~Span()
+  {
+    if (m_event.Name) {
+      m_event.End = now();
+      record(m_event);
+    }
+  }
+
+private:
+  Event m_event;
+};
+
+// Recorded events in start order, and how many were overwritten. Only
+// meaningful once the traced work has finished.
+std::vector<Event> events();
+std::uint64_t dropped();
+
+// Chrome trace event format, for chrome://tracing or Perfetto.
+void writeJson(std::ostream& output);
+void writeJson(const std::string& path);
+
+}  // namespace LIB_NAMESPACE::trace
+
+#define LIB_TRACE_CONCAT_(a, b) a##b
+#define LIB_TRACE_CONCAT(a, b) LIB_TRACE_CONCAT_(a, b)
+
+#if LIB_TRACE
+#  define LIB_TRACE_SCOPE(...) \
+    ::LIB_NAMESPACE::trace::Span LIB_TRACE_CONCAT(traceSpan, __LINE__)( \
+        __VA_ARGS__)
+#else
+#  define LIB_TRACE_SCOPE(...) static_cast<void>(0)
+#endif
+
+#endif  // LIB_PROFILING_TRACE_HPP
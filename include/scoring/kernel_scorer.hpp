@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef LIB_SCORING_KERNEL_SCORER_HPP
+#define LIB_SCORING_KERNEL_SCORER_HPP
+
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "matching/mz_match.hpp"
+#include "models/spectral_store.hpp"
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+// A named set of characteristic fragment ions, e.g. the alkane series.
+struct Kernel
+{
+  std::string Name;
+  std::vector<Spectrum::tMzValue> MzValues;
+};
+
+// The functional-group kernels LibraryToScore has always used.
+std::vector<Kernel> defaultKernels();
+
+// Reads kernels from lines of the form `Name,mz,mz,...`. Blank lines and
+// lines starting with '#' are skipped.
+std::vector<Kernel> readKernels(std::istream& input);
+std::vector<Kernel> readKernels(const std::string& path);
+
+// Kernel ions are nominal masses. Nominal-mass libraries match them within
+// 0.1 Da; accurate-mass peaks carry a mass defect of up to a few tenths, so
+// those libraries match within half a Dalton, i.e. by nominal mass.
+MzTolerance defaultKernelTolerance(bool accurateMass);
+
+// Scores spectra against a whole kernel set in one pass over the peaks.
+//
+// The m/z axis is quantized into bins a quarter of the tolerance wide. Each
+// bin holds a bitmask of the kernels whose window covers it completely, and
+// a short list of kernel ions whose window only clips it; the latter are
+// checked exactly. A peak therefore costs one table lookup, plus a compare
+// per clipped ion, no matter how many kernels there are.
+//
+// A ppm tolerance has no fixed window to bin by, and a Da tolerance far
+// below the spread of the ions would need an enormous table; the scorer then
+// merges the spectrum against the sorted list of all kernel ions instead
+// (see forEachMatch). The merge gallops only when the peaks are sorted by
+// m/z, as SpectralStore keeps them; unsorted peaks still match, by a binary
+// search of the ions per peak.
+//
+// Peaks match an ion when they lie strictly within the tolerance of it.
+// Kernel m/z values must be finite.
+class KernelScorer
+{
+public:
+  explicit KernelScorer(std::vector<Kernel> kernels,
+                        MzTolerance tolerance = 0.1);
+
+  const std::vector<Kernel>& kernels() const { return m_kernels; }
+  const MzTolerance& tolerance() const { return m_tolerance; }
+
+  // Adds Abundance / 10000 of every peak within the tolerance of a kernel
+  // ion to that kernel's entry in `scores`. Peaks may come in any order, but
+  // ppm tolerances are cheapest on peaks sorted by m/z.
+  void accumulate(std::span<const Spectrum::tMzValue> mzValues,
+                  std::span<const Spectrum::tAbundanceValue> abundanceValues,
+                  std::span<double> scores) const;
+
+  // Per-kernel score of a compound, averaged over its spectra.
+  void score(const CompoundView& compound, std::span<double> scores) const;
+  std::vector<double> score(const CompoundView& compound) const;
+
+private:
+  struct Candidate
+  {
+    std::uint32_t Kernel;
+    Spectrum::tMzValue MzValue;
+  };
+
+  static constexpr std::size_t kMaskBits = 64;
+  static constexpr std::size_t kMaxBins = std::size_t(1) << 20;
+
+  void accumulateMerged(
+      std::span<const Spectrum::tMzValue> mzValues,
+      std::span<const Spectrum::tAbundanceValue> abundanceValues,
+      std::span<double> scores) const;
+
+  std::vector<Kernel> m_kernels;
+  MzTolerance m_tolerance;
+  double m_origin = 0;
+  double m_inverseBinWidth = 0;
+
+  std::vector<std::uint64_t> m_masks;
+  std::vector<std::uint32_t> m_offsets;
+  std::vector<Candidate> m_candidates;
+
+  // Every kernel ion sorted by m/z, when the scorer has no bin table.
+  std::vector<Spectrum::tMzValue> m_ionMzValues;
+  std::vector<std::uint32_t> m_ionKernels;
+};
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_SCORING_KERNEL_SCORER_HPP
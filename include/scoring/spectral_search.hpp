@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef LIB_SCORING_SPECTRAL_SEARCH_HPP
+#define LIB_SCORING_SPECTRAL_SEARCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <defines.inc.hpp>
+#include <types.hpp>
+
+#include "matching/mz_match.hpp"
+#include "models/spectral_store.hpp"
+#include "models/spectrum.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+enum class Similarity
+{
+  Cosine,
+  DotProduct
+};
+
+struct SearchOptions
+{
+  // Library peaks match a query peak within this tolerance of its m/z.
+  MzTolerance Tolerance = 0.5;
+  // Peaks are weighted as mz^MzPower * abundance^AbundancePower before
+  // comparison; the defaults are the usual square-root intensity weighting.
+  double MzPower = 0;
+  double AbundancePower = 0.5;
+  Similarity Metric = Similarity::Cosine;
+  // Hits returned per query.
+  std::size_t TopK = 10;
+};
+
+// 0.5 Da for nominal-mass searches; 20 ppm when both sides are accurate-mass.
+MzTolerance defaultSearchTolerance(bool accurateMass);
+
+// A library compound matched by a query, scored by its best spectrum.
+struct SearchHit
+{
+  tCompoundID CompoundID;
+  tSpectrumID SpectrumID;
+  // Index of the compound in the searched SpectralStore.
+  std::size_t Compound;
+  double Score;
+  std::size_t MatchedPeaks;
+};
+
+// Top-k similarity search of query spectra against a SpectralStore.
+//
+// At construction every library peak is weighted once and copied into a
+// single peak list sorted by m/z, with the spectrum it belongs to. A query
+// then binary-searches each of its tolerance windows and walks only the
+// library peaks inside them, and builds hits only from the spectra those
+// peaks belong to, so its cost follows the number of nearby peaks rather
+// than the size of the library. Per-spectrum sums live in scratch arrays
+// kept per thread and reset entry by entry after each query.
+//
+// Peaks are matched one-to-one: each library peak, in m/z order, pairs with
+// the nearest query peak within the tolerance that no other peak of the same
+// spectrum has claimed. Cosine scores therefore stay within [0, 1].
+//
+// The store must outlive the search. Searches are const and may run
+// concurrently.
+class SpectralSearch
+{
+public:
+  explicit SpectralSearch(const SpectralStore& library,
+                          SearchOptions options = {});
+
+  const SearchOptions& options() const { return m_options; }
+
+  // Best hits for one query, best first; ties go to the lower CompoundID.
+  std::vector<SearchHit> search(
+      std::span<const Spectrum::tMzValue> mzValues,
+      std::span<const Spectrum::tAbundanceValue> abundanceValues) const;
+  std::vector<SearchHit> search(const SpectrumView& query) const;
+
+  // Searches every spectrum of `queries` on `threads` threads; the result is
+  // in the order of queries.spectra().
+  std::vector<std::vector<SearchHit>> search(const SpectralStore& queries,
+                                             unsigned threads = 1) const;
+
+private:
+  double weight(double mz, double abundance) const;
+
+  const SpectralStore& m_library;
+  SearchOptions m_options;
+
+  // Weighted library peaks sorted by m/z.
+  std::vector<double> m_mzValues;
+  std::vector<double> m_weights;
+  std::vector<std::uint32_t> m_spectrumOf;
+
+  // Weighted norm of each library spectrum.
+  std::vector<double> m_norms;
+  // Compound index of each library spectrum.
+  std::vector<std::uint32_t> m_compoundOf;
+};
+
+}  // namespace LIB_NAMESPACE
+
+#endif  // LIB_SCORING_SPECTRAL_SEARCH_HPP
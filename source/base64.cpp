@@ -1,56 +1,407 @@
-
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 #include "base64.hpp"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) \
+    || defined(_M_IX86)
+#  define BASE64_X86 1
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#    define BASE64_TARGET(isa)
+#  else
+#    define BASE64_TARGET(isa) __attribute__((target(isa)))
+#  endif
+#endif
+
 namespace base64
 {
 
-  std::string encode(const std::string& in){
+namespace
+{
 
-    std::string out;
-    std::size_t val {0}; 
-    int valb {-6};
+constexpr std::uint8_t kInvalid = 0xFF;
 
-    for (const char& c : in) {
-      val = (val << 8) + c;
-      valb += 8;
-      while (valb >= 0) {
-        out.push_back(alphabet[(val >> valb) & 0x3F]);
-        valb -= 6;
-      }
-    }
-    if (valb > -6) {
-      out.push_back(alphabet[((val << 8) >> (valb + 8)) & 0x3F]);
+constexpr std::array<std::uint8_t, 256> makeDecodeTable()
+{
+  std::array<std::uint8_t, 256> table {};
+  table.fill(kInvalid);
+  constexpr std::string_view chars =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (std::size_t i = 0; i < chars.size(); ++i) {
+    table[static_cast<unsigned char>(chars[i])] = static_cast<std::uint8_t>(i);
+  }
+  return table;
+}
+
+constexpr std::array<std::uint8_t, 256> kDecodeTable = makeDecodeTable();
+
+constexpr char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#ifdef BASE64_X86
+
+// Vector kernels after Muła and Lemire, "Faster Base64 Encoding and Decoding
+// using AVX2 Instructions". Each kernel stops at the first block holding a
+// character outside the alphabet and leaves the rest to the scalar code.
+// Stores are full vectors, so they only run while the output has room.
+
+BASE64_TARGET("sse4.1")
+void decodeSse(const std::uint8_t*& src,
+               const std::uint8_t* srcEnd,
+               std::uint8_t*& dst,
+               const std::uint8_t* dstEnd)
+{
+  const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                      0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                      0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08,
+                                      0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                      0x10, 0x10, 0x10, 0x10);
+  const __m128i lutRoll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask2F = _mm_set1_epi8(0x2F);
+  const __m128i pack = _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+  while (srcEnd - src >= 16 && dstEnd - dst >= 16) {
+    __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+    __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask2F);
+    __m128i loNibbles = _mm_and_si128(str, mask2F);
+    __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+    __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+    if (!_mm_testz_si128(lo, hi)) {
+      break;
     }
-    while (out.size() % 4) {
-      out.push_back('=');
+
+    __m128i eq2F = _mm_cmpeq_epi8(str, mask2F);
+    __m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+    str = _mm_add_epi8(str, roll);
+
+    __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+    __m128i out = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    out = _mm_shuffle_epi8(out, pack);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out);
+    src += 16;
+    dst += 12;
+  }
+}
+
+BASE64_TARGET("avx2")
+void decodeAvx2(const std::uint8_t*& src,
+                const std::uint8_t* srcEnd,
+                std::uint8_t*& dst,
+                const std::uint8_t* dstEnd)
+{
+  const __m256i lutLo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+      0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lutHi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lutRoll = _mm256_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask2F = _mm256_set1_epi8(0x2F);
+  const __m256i pack = _mm256_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+  const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+  while (srcEnd - src >= 32 && dstEnd - dst >= 32) {
+    __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+
+    __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask2F);
+    __m256i loNibbles = _mm256_and_si256(str, mask2F);
+    __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+    __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+    if (!_mm256_testz_si256(lo, hi)) {
+      break;
     }
-    return out;
+
+    __m256i eq2F = _mm256_cmpeq_epi8(str, mask2F);
+    __m256i roll =
+        _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles));
+    str = _mm256_add_epi8(str, roll);
+
+    __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+    __m256i out = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+    out = _mm256_shuffle_epi8(out, pack);
+    out = _mm256_permutevar8x32_epi32(out, lanes);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), out);
+    src += 32;
+    dst += 24;
+  }
+}
+
+// Spreads the 12 bytes of each lane into 16 six-bit indices.
+BASE64_TARGET("sse4.1")
+__m128i encodeReshuffle(__m128i in)
+{
+  in = _mm_shuffle_epi8(
+      in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+  __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  return _mm_or_si128(t1, t3);
+}
+
+BASE64_TARGET("sse4.1")
+__m128i encodeTranslate(__m128i indices)
+{
+  const __m128i lut = _mm_setr_epi8(
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+  __m128i offsets = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  offsets = _mm_sub_epi8(offsets,
+                         _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+  return _mm_add_epi8(indices, _mm_shuffle_epi8(lut, offsets));
+}
+
+BASE64_TARGET("sse4.1")
+void encodeSse(const std::uint8_t*& src,
+               const std::uint8_t* srcEnd,
+               char*& dst)
+{
+  // Loads are 16 bytes wide but only 12 are consumed per step.
+  while (srcEnd - src >= 16) {
+    __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i out = encodeTranslate(encodeReshuffle(in));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), out);
+    src += 12;
+    dst += 16;
   }
+}
+
+BASE64_TARGET("avx2")
+void encodeAvx2(const std::uint8_t*& src,
+                const std::uint8_t* srcEnd,
+                char*& dst)
+{
+  const __m256i shuffle = _mm256_setr_epi8(
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+      1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+  const __m256i lut = _mm256_setr_epi8(
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+      65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+
+  // Each lane takes 12 input bytes; the upper lane is loaded from src + 12.
+  while (srcEnd - src >= 28) {
+    __m256i in = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)),
+        1);
+
+    in = _mm256_shuffle_epi8(in, shuffle);
+    __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+    __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+    __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    __m256i indices = _mm256_or_si256(t1, t3);
 
-  std::string decode(const std::string& in) {
+    __m256i offsets = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+    offsets = _mm256_sub_epi8(
+        offsets, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+    __m256i out =
+        _mm256_add_epi8(indices, _mm256_shuffle_epi8(lut, offsets));
 
-    std::string out;
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), out);
+    src += 24;
+    dst += 32;
+  }
+}
+
+enum class Isa
+{
+  Scalar,
+  Sse41,
+  Avx2
+};
 
-    std::vector<int> T(256, -1);
-    for (int i = 0; i < 64; i++) {
-      T[(std::size_t)alphabet[(std::size_t)i]] = i;
+Isa detectIsa()
+{
+#  if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+  __cpuid(info, 1);
+  bool sse41 = (info[2] & (1 << 19)) != 0;
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx2 = false;
+  if (maxLeaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+    __cpuidex(info, 7, 0);
+    avx2 = (info[1] & (1 << 5)) != 0;
+  }
+#  else
+  __builtin_cpu_init();
+  bool sse41 = __builtin_cpu_supports("sse4.1");
+  bool avx2 = __builtin_cpu_supports("avx2");
+#  endif
+  return avx2 ? Isa::Avx2 : sse41 ? Isa::Sse41 : Isa::Scalar;
+}
+
+const Isa kIsa = detectIsa();
+
+#endif  // BASE64_X86
+
+[[noreturn]] void invalid(const std::string& what, std::size_t position)
+{
+  throw std::invalid_argument("base64: " + what + " at offset "
+                              + std::to_string(position));
+}
+
+}  // namespace
+
+std::size_t decodedSize(std::string_view in)
+{
+  std::size_t length = in.size();
+  for (int i = 0; i < 2 && length > 0 && in[length - 1] == '='; ++i) {
+    --length;
+  }
+  return length / 4 * 3 + (length % 4 * 3) / 4;
+}
+
+std::size_t encodedSize(std::size_t bytes)
+{
+  return (bytes + 2) / 3 * 4;
+}
+
+std::size_t decode(std::string_view in,
+                   std::span<std::byte> out,
+                   Validation validation)
+{
+  if (out.size() < decodedSize(in)) {
+    throw std::length_error("base64: output buffer too small");
+  }
+
+  const auto* begin = reinterpret_cast<const std::uint8_t*>(in.data());
+  const auto* src = begin;
+  const auto* srcEnd = begin + in.size();
+  auto* dst = reinterpret_cast<std::uint8_t*>(out.data());
+  const auto* dstEnd = dst + out.size();
+
+#ifdef BASE64_X86
+  if (kIsa == Isa::Avx2) {
+    decodeAvx2(src, srcEnd, dst, dstEnd);
+  }
+  if (kIsa != Isa::Scalar) {
+    decodeSse(src, srcEnd, dst, dstEnd);
+  }
+#endif
+
+  while (srcEnd - src >= 4) {
+    std::uint8_t a = kDecodeTable[src[0]];
+    std::uint8_t b = kDecodeTable[src[1]];
+    std::uint8_t c = kDecodeTable[src[2]];
+    std::uint8_t d = kDecodeTable[src[3]];
+    if ((a | b | c | d) & 0x80) {
+      break;
+    }
+    std::uint32_t triple = (std::uint32_t(a) << 18) | (std::uint32_t(b) << 12)
+        | (std::uint32_t(c) << 6) | d;
+    dst[0] = static_cast<std::uint8_t>(triple >> 16);
+    dst[1] = static_cast<std::uint8_t>(triple >> 8);
+    dst[2] = static_cast<std::uint8_t>(triple);
+    src += 4;
+    dst += 3;
+  }
+
+  // Tail, or the quad holding the first character outside the alphabet.
+  std::uint32_t val = 0;
+  int valb = -8;
+  for (; src < srcEnd; ++src) {
+    std::uint8_t sextet = kDecodeTable[*src];
+    if (sextet == kInvalid) {
+      break;
+    }
+    val = (val << 6) | sextet;
+    valb += 6;
+    if (valb >= 0) {
+      *dst++ = static_cast<std::uint8_t>((val >> valb) & 0xFF);
+      valb -= 8;
     }
+  }
 
-    int val = 0, valb = -8;
-    for (const char c : in) {
-      if (T[(std::size_t)c] == -1) {
-        break;
-      }
-      val = (val << 6) + T[(std::size_t)c];
-      valb += 6;
-      if (valb >= 0) {
-        out.push_back(char((val >> valb) & 0xFF));
-        valb -= 8;
-      }
+  if (validation == Validation::Strict) {
+    std::size_t data = static_cast<std::size_t>(src - begin);
+    std::size_t padding = 0;
+    while (src < srcEnd && *src == '=' && padding < 2) {
+      ++src;
+      ++padding;
+    }
+    if (src != srcEnd) {
+      invalid("invalid character", static_cast<std::size_t>(src - begin));
+    }
+    if (data % 4 == 1 || (padding > 0 && (data + padding) % 4 != 0)) {
+      invalid("invalid length or padding", data);
     }
-    return out;
   }
 
-}
\ No newline at end of file
+  return static_cast<std::size_t>(dst - reinterpret_cast<std::uint8_t*>(
+                                            out.data()));
+}
+
+void encode(std::span<const std::byte> in, std::string& out)
+{
+  out.resize(encodedSize(in.size()));
+
+  const auto* src = reinterpret_cast<const std::uint8_t*>(in.data());
+  const auto* srcEnd = src + in.size();
+  char* dst = out.data();
+
+#ifdef BASE64_X86
+  if (kIsa == Isa::Avx2) {
+    encodeAvx2(src, srcEnd, dst);
+  }
+  if (kIsa != Isa::Scalar) {
+    encodeSse(src, srcEnd, dst);
+  }
+#endif
+
+  for (; srcEnd - src >= 3; src += 3) {
+    std::uint32_t triple = (std::uint32_t(src[0]) << 16)
+        | (std::uint32_t(src[1]) << 8) | src[2];
+    *dst++ = kAlphabet[(triple >> 18) & 0x3F];
+    *dst++ = kAlphabet[(triple >> 12) & 0x3F];
+    *dst++ = kAlphabet[(triple >> 6) & 0x3F];
+    *dst++ = kAlphabet[triple & 0x3F];
+  }
+
+  if (srcEnd - src == 2) {
+    std::uint32_t pair = (std::uint32_t(src[0]) << 8) | src[1];
+    *dst++ = kAlphabet[(pair >> 10) & 0x3F];
+    *dst++ = kAlphabet[(pair >> 4) & 0x3F];
+    *dst++ = kAlphabet[(pair << 2) & 0x3F];
+    *dst++ = '=';
+  } else if (srcEnd - src == 1) {
+    *dst++ = kAlphabet[(src[0] >> 2) & 0x3F];
+    *dst++ = kAlphabet[(src[0] << 4) & 0x3F];
+    *dst++ = '=';
+    *dst++ = '=';
+  }
+}
+
+std::string encode(const std::string& in)
+{
+  std::string out;
+  encode(std::as_bytes(std::span(in.data(), in.size())), out);
+  return out;
+}
+
+std::string decode(const std::string& in)
+{
+  std::string out(decodedSize(in), '\0');
+  out.resize(decode(in, std::as_writable_bytes(std::span(out))));
+  return out;
+}
+
+}  // namespace base64
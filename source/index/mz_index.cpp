@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "index/mz_index.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+static_assert(std::endian::native == std::endian::little,
+              "The m/z index is stored little-endian");
+
+namespace
+{
+
+constexpr char kMagic[8] = {'M', 'H', 'M', 'Z', 'I', 'D', 'X', '\n'};
+constexpr std::uint32_t kVersion = 1;
+
+// Bins are only a jump table, so a width that needs more than this many is a
+// mistake rather than a finer index.
+constexpr double kMaxBins = 1 << 24;
+
+struct Header
+{
+  char Magic[8];
+  std::uint32_t Version;
+  std::uint32_t Reserved;
+  double Origin;
+  double BinWidth;
+  std::uint64_t BinCount;
+  std::uint64_t PostingCount;
+};
+
+static_assert(sizeof(Header) == 48);
+static_assert(sizeof(Posting) == 24);
+
+template<typename T>
+void writeArray(std::ostream& output, const std::vector<T>& values)
+{
+  output.write(reinterpret_cast<const char*>(values.data()),
+               static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+[[noreturn]] void truncated()
+{
+  throw std::runtime_error("m/z index is truncated");
+}
+
+// Bytes left to read, or the maximum when the stream cannot seek.
+std::uint64_t remaining(std::istream& input)
+{
+  const auto position = input.tellg();
+  if (position < 0 || !input.seekg(0, std::ios::end)) {
+    input.clear();
+    return std::numeric_limits<std::uint64_t>::max();
+  }
+  const auto end = input.tellg();
+  input.seekg(position);
+  return end > position ? static_cast<std::uint64_t>(end - position) : 0;
+}
+
+// Checks `count` against what is left before allocating, so a corrupt header
+// is reported as such rather than as bad_alloc.
+template<typename T>
+void readArray(std::istream& input, std::vector<T>& values, std::uint64_t count)
+{
+  if (count > remaining(input) / sizeof(T)) {
+    truncated();
+  }
+  values.resize(count);
+  input.read(reinterpret_cast<char*>(values.data()),
+             static_cast<std::streamsize>(count * sizeof(T)));
+}
+
+}  // namespace
+
+MzIndex::MzIndex(const SpectralStore& library,
+                 double binWidth,
+                 float minRelativeAbundance)
+    : m_binWidth(binWidth)
+{
+  if (!(binWidth > 0) || !std::isfinite(binWidth)) {
+    throw std::invalid_argument("m/z index bin width must be positive");
+  }
+  LIB_STATS_SCOPE(Build);
+
+  m_postings.reserve(library.peakCount());
+  for (const auto& spectrum : library.spectra()) {
+    double basePeak = 0;
+    for (auto abundance : spectrum.AbundanceValues) {
+      basePeak = std::max(basePeak, abundance);
+    }
+    if (!(basePeak > 0)) {
+      continue;
+    }
+
+    for (std::size_t i = 0; i < spectrum.MzValues.size(); ++i) {
+      auto relative =
+          static_cast<float>(spectrum.AbundanceValues[i] / basePeak);
+      if (relative > 0 && relative >= minRelativeAbundance
+          && std::isfinite(spectrum.MzValues[i]))
+      {
+        m_postings.push_back({spectrum.MzValues[i],
+                              spectrum.CompoundID,
+                              spectrum.SpectrumID,
+                              relative,
+                              0});
+      }
+    }
+  }
+
+  // Stable, so equal m/z keep library order.
+  std::stable_sort(m_postings.begin(),
+                   m_postings.end(),
+                   [](const Posting& a, const Posting& b)
+                   { return a.MzValue < b.MzValue; });
+
+  if (m_postings.empty()) {
+    return;
+  }
+  if (m_postings.size() > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error("m/z index postings exceed 32 bits");
+  }
+
+  m_origin = std::floor(m_postings.front().MzValue / m_binWidth) * m_binWidth;
+  double span = (m_postings.back().MzValue - m_origin) / m_binWidth;
+  if (!(span < kMaxBins)) {
+    throw std::length_error("m/z index bin width is too small for the m/z range");
+  }
+  auto bins = static_cast<std::size_t>(span) + 1;
+
+  m_binStarts.assign(bins + 1, 0);
+  std::size_t posting = 0;
+  for (std::size_t bin = 0; bin <= bins; ++bin) {
+    while (posting < m_postings.size()
+           && static_cast<std::size_t>(
+                  (m_postings[posting].MzValue - m_origin) / m_binWidth)
+               < bin)
+    {
+      ++posting;
+    }
+    m_binStarts[bin] = static_cast<std::uint32_t>(posting);
+  }
+}
+
+std::span<const Posting> MzIndex::range(double low, double high) const
+{
+  if (m_postings.empty() || !std::isfinite(low) || !std::isfinite(high)
+      || high < low)
+  {
+    return {};
+  }
+
+  // Widen by a bin either way so rounding in the bin arithmetic cannot clip
+  // the range; the exact bounds are found within it.
+  double first = std::floor((low - m_origin) / m_binWidth) - 1;
+  double last = std::floor((high - m_origin) / m_binWidth) + 2;
+  double bins = static_cast<double>(binCount());
+  if (last <= 0 || first >= bins) {
+    return {};
+  }
+
+  auto begin = m_postings.begin()
+      + m_binStarts[static_cast<std::size_t>(std::max(first, 0.0))];
+  auto end = m_postings.begin()
+      + m_binStarts[static_cast<std::size_t>(std::min(last, bins))];
+
+  begin = std::lower_bound(begin,
+                           end,
+                           low,
+                           [](const Posting& posting, double mz)
+                           { return posting.MzValue < mz; });
+  end = std::upper_bound(begin,
+                         end,
+                         high,
+                         [](double mz, const Posting& posting)
+                         { return mz < posting.MzValue; });
+  return {begin, end};
+}
+
+std::vector<Posting> MzIndex::query(double mz,
+                                    const MzTolerance& tolerance,
+                                    float minRelativeAbundance) const
+{
+  std::vector<Posting> result;
+  double window = tolerance.window(mz);
+  for (const auto& posting : range(mz - window, mz + window)) {
+    if (tolerance.matches(mz, posting.MzValue)
+        && posting.RelativeAbundance >= minRelativeAbundance)
+    {
+      result.push_back(posting);
+    }
+  }
+  return result;
+}
+
+std::vector<tCompoundID> MzIndex::intersect(std::span<const double> ions,
+                                            const MzTolerance& tolerance,
+                                            float minRelativeAbundance) const
+{
+  if (ions.empty()) {
+    return {};
+  }
+
+  // Start from the ion with the fewest candidate postings.
+  std::vector<std::pair<std::size_t, double>> order;
+  order.reserve(ions.size());
+  for (auto ion : ions) {
+    double window = tolerance.window(ion);
+    order.push_back({range(ion - window, ion + window).size(), ion});
+  }
+  std::sort(order.begin(), order.end());
+
+  auto compoundsNear = [&](double ion)
+  {
+    std::vector<tCompoundID> compounds;
+    for (const auto& posting : query(ion, tolerance, minRelativeAbundance)) {
+      compounds.push_back(posting.CompoundID);
+    }
+    std::sort(compounds.begin(), compounds.end());
+    compounds.erase(std::unique(compounds.begin(), compounds.end()),
+                    compounds.end());
+    return compounds;
+  };
+
+  std::vector<tCompoundID> result = compoundsNear(order.front().second);
+  for (std::size_t i = 1; i < order.size() && !result.empty(); ++i) {
+    auto next = compoundsNear(order[i].second);
+    std::vector<tCompoundID> both;
+    std::set_intersection(result.begin(),
+                          result.end(),
+                          next.begin(),
+                          next.end(),
+                          std::back_inserter(both));
+    result = std::move(both);
+  }
+  return result;
+}
+
+void writeMzIndex(const MzIndex& index, std::ostream& output)
+{
+  LIB_STATS_SCOPE(Write);
+  LIB_TRACE_SCOPE("write index");
+  Header header = {};
+  std::memcpy(header.Magic, kMagic, sizeof(header.Magic));
+  header.Version = kVersion;
+  header.Origin = index.m_origin;
+  header.BinWidth = index.m_binWidth;
+  header.BinCount = index.binCount();
+  header.PostingCount = index.m_postings.size();
+
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  writeArray(output, index.m_binStarts);
+  writeArray(output, index.m_postings);
+  LIB_STATS_ADD(BytesWritten,
+                sizeof(header)
+                    + index.m_binStarts.size() * sizeof(index.m_binStarts[0])
+                    + index.m_postings.size() * sizeof(index.m_postings[0]));
+
+  if (!output) {
+    throw std::runtime_error("Failed to write m/z index");
+  }
+}
+
+void writeMzIndex(const MzIndex& index, const std::string& path)
+{
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open m/z index: " + path);
+  }
+  writeMzIndex(index, output);
+}
+
+MzIndex readMzIndex(std::istream& input)
+{
+  Header header = {};
+  input.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!input || std::memcmp(header.Magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error("Not an m/z index");
+  }
+  if (header.Version != kVersion) {
+    throw std::runtime_error("Unsupported m/z index version "
+                             + std::to_string(header.Version));
+  }
+
+  if (!std::isfinite(header.Origin) || !(header.BinWidth > 0)
+      || !std::isfinite(header.BinWidth))
+  {
+    throw std::runtime_error("m/z index header is corrupt");
+  }
+
+  MzIndex index;
+  index.m_origin = header.Origin;
+  index.m_binWidth = header.BinWidth;
+  const std::uint64_t bins = header.BinCount == 0 ? 0 : header.BinCount + 1;
+  if (bins < header.BinCount) {
+    truncated();
+  }
+  readArray(input, index.m_binStarts, bins);
+  readArray(input, index.m_postings, header.PostingCount);
+  if (!input) {
+    truncated();
+  }
+
+  std::uint32_t previous = 0;
+  for (auto start : index.m_binStarts) {
+    if (start < previous || start > index.m_postings.size()) {
+      throw std::runtime_error("m/z index bin table is corrupt");
+    }
+    previous = start;
+  }
+  // range() indexes the bin table for any posting, and searches within bins
+  // assume m/z order.
+  const auto& postings = index.m_postings;
+  if ((index.m_binStarts.empty() != postings.empty())
+      || (!postings.empty() && index.m_binStarts.back() != postings.size())
+      || !std::all_of(postings.begin(),
+                      postings.end(),
+                      [](const Posting& posting)
+                      { return std::isfinite(posting.MzValue); })
+      || !std::is_sorted(postings.begin(),
+                         postings.end(),
+                         [](const Posting& a, const Posting& b)
+                         { return a.MzValue < b.MzValue; }))
+  {
+    throw std::runtime_error("m/z index bin table is corrupt");
+  }
+  return index;
+}
+
+MzIndex readMzIndex(const std::string& path)
+{
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("Failed to open m/z index: " + path);
+  }
+  return readMzIndex(input);
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <variant>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "io/chunked_reader.hpp"
+#include "io/numeric.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+// Chunks are aimed at this many per thread, but never below kMinChunkSize
+// so that small files are not shredded into per-record tasks.
+constexpr std::size_t kChunksPerThread = 8;
+constexpr std::size_t kMinChunkSize = 256 << 10;
+
+// Read-only streambuf over a byte range, so a chunk of the mapping can be
+// handed to LibraryReader without copying it first.
+class MemoryBuffer : public std::streambuf
+{
+public:
+  explicit MemoryBuffer(std::string_view data)
+  {
+    char* begin = const_cast<char*>(data.data());
+    setg(begin, begin, begin + data.size());
+  }
+};
+
+class Scanner
+{
+public:
+  Scanner(std::string_view document, const std::string& filename)
+      : m_document(document)
+      , m_filename(filename)
+  {
+  }
+
+  std::vector<LibraryElement> run()
+  {
+    std::vector<LibraryElement> elements;
+
+    // Prolog up to and including the root start tag.
+    while (true) {
+      std::size_t open = find('<', "no element found");
+      if (skipMarkup(open)) {
+        continue;
+      }
+      if (startTag(open)) {
+        return elements;
+      }
+      break;
+    }
+
+    std::size_t depth = 0;
+    std::size_t begin = 0;
+    std::string_view name;
+
+    while (true) {
+      std::size_t open = find('<', "unexpected end of data");
+      if (skipMarkup(open)) {
+        continue;
+      }
+
+      if (at(open + 1) == '/') {
+        m_pos = find('>', "unexpected end of data") + 1;
+        if (depth == 0) {
+          return elements;
+        }
+        if (--depth == 0) {
+          elements.push_back({kind(name), begin, m_pos});
+        }
+        continue;
+      }
+
+      std::size_t nameBegin = open + 1;
+      std::size_t nameEnd = nameBegin;
+      while (nameEnd < m_document.size()
+             && std::strchr(" \t\r\n/>", m_document[nameEnd]) == nullptr)
+      {
+        ++nameEnd;
+      }
+      bool selfClosing = startTag(open);
+
+      if (depth == 0) {
+        begin = open;
+        name = m_document.substr(nameBegin, nameEnd - nameBegin);
+        if (selfClosing) {
+          elements.push_back({kind(name), begin, m_pos});
+        }
+      }
+      if (!selfClosing) {
+        ++depth;
+      }
+    }
+  }
+
+private:
+  static LibraryReader::Record kind(std::string_view name)
+  {
+    return name == "Library" ? LibraryReader::Record::Library
+        : name == "Compound" ? LibraryReader::Record::Compound
+        : name == "Spectrum" ? LibraryReader::Record::Spectrum
+                             : LibraryReader::Record::Other;
+  }
+
+  char at(std::size_t pos) const
+  {
+    return pos < m_document.size() ? m_document[pos] : '\0';
+  }
+
+  std::size_t find(char c, const char* error)
+  {
+    std::size_t pos = m_document.find(c, m_pos);
+    if (pos == std::string_view::npos) {
+      fail(error);
+    }
+    m_pos = pos;
+    return pos;
+  }
+
+  void skipPast(std::string_view terminator)
+  {
+    std::size_t pos = m_document.find(terminator, m_pos);
+    if (pos == std::string_view::npos) {
+      fail("unexpected end of data");
+    }
+    m_pos = pos + terminator.size();
+  }
+
+  // Skips a comment, CDATA section, processing instruction or declaration
+  // starting at `open`; false if it is a tag instead.
+  bool skipMarkup(std::size_t open)
+  {
+    std::string_view rest = m_document.substr(open);
+    if (rest.starts_with("<!--")) {
+      m_pos = open + 4;
+      skipPast("-->");
+    } else if (rest.starts_with("<![CDATA[")) {
+      m_pos = open + 9;
+      skipPast("]]>");
+    } else if (rest.starts_with("<?")) {
+      m_pos = open + 2;
+      skipPast("?>");
+    } else if (rest.starts_with("<!")) {
+      int depth = 0;
+      for (m_pos = open; ; ++m_pos) {
+        char c = at(m_pos);
+        if (c == '\0' && m_pos >= m_document.size()) {
+          fail("unexpected end of data");
+        }
+        depth += c == '<' ? 1 : c == '>' ? -1 : 0;
+        if (depth == 0) {
+          break;
+        }
+      }
+      ++m_pos;
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  // Moves past the start tag at `open`, stepping over quoted attribute
+  // values; true if it closes itself.
+  bool startTag(std::size_t open)
+  {
+    for (m_pos = open + 1; m_pos < m_document.size(); ++m_pos) {
+      char c = m_document[m_pos];
+      if (c == '"' || c == '\'') {
+        m_pos = m_document.find(c, m_pos + 1);
+        if (m_pos == std::string_view::npos) {
+          break;
+        }
+      } else if (c == '>') {
+        ++m_pos;
+        return m_document[m_pos - 2] == '/';
+      }
+    }
+    m_pos = m_document.size();
+    fail("unexpected end of data");
+  }
+
+  [[noreturn]] void fail(const std::string& message) const
+  {
+    auto line = std::count(m_document.begin(),
+                           m_document.begin()
+                               + static_cast<std::ptrdiff_t>(
+                                   std::min(m_pos, m_document.size())),
+                           '\n');
+    throw boost::property_tree::xml_parser_error(
+        message, m_filename, static_cast<unsigned long>(line) + 1);
+  }
+
+  std::string_view m_document;
+  const std::string& m_filename;
+  std::size_t m_pos = 0;
+};
+
+struct Chunk
+{
+  std::size_t Begin;
+  std::size_t End;
+  std::size_t Records;
+};
+
+using Record = std::variant<Compound, Spectrum>;
+
+}  // namespace
+
+std::vector<LibraryElement> scanLibrary(std::string_view document,
+                                        const std::string& filename)
+{
+  return Scanner(document, filename).run();
+}
+
+Library readLibraryParallel(const std::string& path,
+                            Projection projection,
+                            unsigned threads,
+                            const Library::allocator_type& allocator)
+{
+  LIB_STATS_SCOPE(Read);
+  LIB_TRACE_SCOPE("parallel read");
+  threads = resolveThreads(threads);
+
+  std::error_code error;
+  if (std::filesystem::file_size(path, error) == 0 || error) {
+    // Nothing to map; the sequential reader reports why.
+    return readLibrary(path, projection, 1, allocator);
+  }
+
+  boost::interprocess::file_mapping file(path.c_str(),
+                                         boost::interprocess::read_only);
+  boost::interprocess::mapped_region region(file,
+                                            boost::interprocess::read_only);
+  std::string_view document(static_cast<const char*>(region.get_address()),
+                            region.get_size());
+
+  std::vector<LibraryElement> elements;
+  {
+    LIB_TRACE_SCOPE("scan");
+    elements = scanLibrary(document, path);
+  }
+
+  {
+    MemoryBuffer buffer(document);
+    std::istream input(&buffer);
+    LibraryReader(input, path).requireRoot(kLibraryRoot);
+  }
+
+  // The first <Library> names the library of every compound, wherever it
+  // sits, so it is read before anything else; the other records are cut
+  // into chunks.
+  Library library(allocator);
+  auto fragment = [&](std::size_t begin, std::size_t end)
+  {
+    return std::string_view(document.data() + begin, end - begin);
+  };
+
+  auto first = std::find_if(elements.begin(),
+                            elements.end(),
+                            [](const LibraryElement& element)
+                            {
+                              return element.Kind
+                                  == LibraryReader::Record::Library;
+                            });
+  if (first != elements.end()) {
+    MemoryBuffer buffer(fragment(first->Begin, first->End));
+    std::istream input(&buffer);
+    LibraryReader reader(input, path, LibraryReader::Mode::Fragment);
+    reader.next();
+    library.LibraryID = reader.tree().get<tLibraryID>(
+        "LibraryID", 0, numeric::translator<tLibraryID>);
+    library.AccurateMass = reader.tree().get(
+        "AccurateMass", false, numeric::translator<bool>);
+  }
+
+  std::vector<Chunk> chunks;
+  const std::size_t target =
+      std::max(document.size() / (threads * kChunksPerThread), kMinChunkSize);
+
+  for (const auto& element : elements) {
+    if (element.Kind == LibraryReader::Record::Library) {
+      continue;
+    }
+    if (chunks.empty() || chunks.back().End - chunks.back().Begin >= target) {
+      chunks.push_back({element.Begin, element.End, 1});
+    } else {
+      chunks.back().End = element.End;
+      ++chunks.back().Records;
+    }
+  }
+
+  std::vector<std::vector<Record>> records(chunks.size());
+
+  WorkStealingPool pool(threads);
+  pool.run(
+      chunks.size(),
+      [&](std::size_t c, unsigned)
+      {
+        LIB_TRACE_SCOPE("parse chunk", "chunk", c);
+        const auto& chunk = chunks[c];
+        MemoryBuffer buffer(fragment(chunk.Begin, chunk.End));
+        std::istream input(&buffer);
+
+        records[c].reserve(chunk.Records);
+        try {
+          LibraryReader reader(input, path, LibraryReader::Mode::Fragment);
+          for (auto record = reader.next();
+               record != LibraryReader::Record::End;
+               record = reader.next())
+          {
+            if (record == LibraryReader::Record::Compound) {
+              records[c].emplace_back(reader.compound(library.LibraryID));
+            } else if (record == LibraryReader::Record::Spectrum) {
+              auto spectrum = reader.spectrum(projection);
+              spectrum.MzValues.values();
+              spectrum.AbundanceValues.values();
+              records[c].emplace_back(std::move(spectrum));
+            }
+          }
+        } catch (const boost::property_tree::xml_parser_error& e) {
+          // Fragment lines count from the chunk; report document lines.
+          auto before = std::count(document.begin(),
+                                   document.begin()
+                                       + static_cast<std::ptrdiff_t>(
+                                           chunk.Begin),
+                                   '\n');
+          throw boost::property_tree::xml_parser_error(
+              e.message(),
+              path,
+              e.line() + static_cast<unsigned long>(before));
+        }
+      });
+
+  // Document order, so records replace and check each other exactly as in
+  // a sequential read.
+  LIB_TRACE_SCOPE("merge");
+  for (auto& chunk : records) {
+    for (auto& record : chunk) {
+      std::visit([&](auto& value) { library.insert(std::move(value)); },
+                 record);
+    }
+    std::vector<Record>().swap(chunk);
+  }
+
+  return library;
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include "io/csv_writer.hpp"
+#include "io/numeric.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+constexpr std::size_t kBufferSize = 1 << 20;
+
+}  // namespace
+
+CsvWriter::CsvWriter(std::ostream& output, CsvOptions options)
+    : m_output(output)
+    , m_options(options)
+{
+  m_buffer.reserve(kBufferSize + kBufferSize / 4);
+}
+
+CsvWriter::~CsvWriter()
+{
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+void CsvWriter::header(const SpectralStore& library)
+{
+  field("CompoundID");
+  if (m_options.EachSpectrum) {
+    field("SpectrumID");
+  }
+  field("RetentionIndex");
+  if (m_options.Metadata) {
+    for (auto name : {"CASNumber",
+                      "CompoundName",
+                      "Formula",
+                      "MolecularWeight",
+                      "RetentionTimeRTL"})
+    {
+      field(name);
+    }
+  }
+
+  std::size_t widest = 0;
+  if (m_options.Peaks != CsvPeaks::None) {
+    for (std::size_t s = 0; s < library.spectrumCount(); ++s) {
+      widest = std::max(widest,
+                        library.PeakOffsets[s + 1] - library.PeakOffsets[s]);
+    }
+  }
+  if (m_options.Peaks == CsvPeaks::Top) {
+    widest = std::min(widest, m_options.TopN);
+  }
+
+  std::string name;
+  for (std::size_t i = 1; i <= widest; ++i) {
+    name = "Mz";
+    name += std::to_string(i);
+    field(name);
+    if (m_options.Abundances) {
+      name = "Abundance";
+      name += std::to_string(i);
+      field(name);
+    }
+  }
+  endRow();
+}
+
+void CsvWriter::write(const CompoundView& compound)
+{
+  auto metadata = [&]
+  {
+    field(static_cast<double>(compound.RetentionIndex));
+    if (m_options.Metadata) {
+      field(compound.CASNumber);
+      field(compound.CompoundName);
+      field(compound.Formula);
+      field(static_cast<double>(compound.MolecularWeight));
+      field(static_cast<double>(compound.RetentionTimeRTL));
+    }
+  };
+
+  if (!m_options.EachSpectrum) {
+    field(std::uint64_t(compound.CompoundID));
+    metadata();
+    if (!compound.Spectra.empty()) {
+      peaks(compound.Spectra.front());
+    }
+    endRow();
+    return;
+  }
+
+  for (const auto& spectrum : compound.Spectra) {
+    field(std::uint64_t(compound.CompoundID));
+    field(std::uint64_t(spectrum.SpectrumID));
+    metadata();
+    peaks(spectrum);
+    endRow();
+  }
+}
+
+void CsvWriter::peaks(const SpectrumView& spectrum)
+{
+  auto peak = [&](std::size_t i)
+  {
+    field(spectrum.MzValues[i]);
+    if (m_options.Abundances) {
+      field(spectrum.AbundanceValues[i]);
+    }
+  };
+
+  std::size_t count = spectrum.MzValues.size();
+  if (m_options.Peaks == CsvPeaks::All) {
+    for (std::size_t i = 0; i < count; ++i) {
+      peak(i);
+    }
+    return;
+  }
+  if (m_options.Peaks == CsvPeaks::None) {
+    return;
+  }
+
+  // Most abundant first; equal abundances keep m/z order.
+  m_order.resize(count);
+  std::iota(m_order.begin(), m_order.end(), std::uint32_t(0));
+  auto top = m_order.begin()
+      + static_cast<std::ptrdiff_t>(std::min(m_options.TopN, count));
+  std::partial_sort(m_order.begin(),
+                    top,
+                    m_order.end(),
+                    [&](std::uint32_t a, std::uint32_t b)
+                    {
+                      auto lhs = spectrum.AbundanceValues[a];
+                      auto rhs = spectrum.AbundanceValues[b];
+                      return lhs > rhs || (!(lhs < rhs) && a < b);
+                    });
+  for (auto it = m_order.begin(); it != top; ++it) {
+    peak(*it);
+  }
+}
+
+void CsvWriter::field(std::string_view text)
+{
+  if (text.find_first_of(",\"\r\n") == std::string_view::npos) {
+    m_buffer += text;
+  } else {
+    m_buffer += '"';
+    for (char c : text) {
+      if (c == '"') {
+        m_buffer += '"';
+      }
+      m_buffer += c;
+    }
+    m_buffer += '"';
+  }
+  m_buffer += ',';
+}
+
+void CsvWriter::field(std::uint64_t value)
+{
+  numeric::append(m_buffer, value);
+  m_buffer += ',';
+}
+
+void CsvWriter::field(double value)
+{
+  numeric::append(m_buffer, value, std::chars_format::fixed, 6);
+  m_buffer += ',';
+}
+
+void CsvWriter::endRow()
+{
+  m_buffer += '\n';
+  if (m_buffer.size() >= kBufferSize) {
+    flush();
+  }
+}
+
+void CsvWriter::flush()
+{
+  LIB_STATS_SCOPE(Write);
+  LIB_TRACE_SCOPE("write", "bytes", m_buffer.size());
+  LIB_STATS_ADD(BytesWritten, m_buffer.size());
+  m_output.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  m_buffer.clear();
+  if (!m_output) {
+    throw std::runtime_error("Failed to write CSV");
+  }
+}
+
+void writeCsv(const SpectralStore& library,
+              std::ostream& output,
+              const CsvOptions& options)
+{
+  CsvWriter writer(output, options);
+  if (options.Header) {
+    writer.header(library);
+  }
+  for (const auto& compound : library.compounds()) {
+    writer.write(compound);
+  }
+  writer.flush();
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#include "io/library_cache.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+static_assert(std::endian::native == std::endian::little,
+              "The .mhlib cache is stored little-endian");
+
+namespace
+{
+
+std::uint64_t align(std::uint64_t offset)
+{
+  return (offset + cache::kAlignment - 1) & ~(cache::kAlignment - 1);
+}
+
+// Writes the cache front to back, so the stream needs no seeking and
+// whatever it already holds is left alone.
+class SequentialWriter
+{
+public:
+  explicit SequentialWriter(std::ostream& output)
+      : m_output(output)
+  {
+  }
+
+  template<typename T>
+  void write(const T* data, std::size_t count)
+  {
+    m_output.write(reinterpret_cast<const char*>(data),
+                   static_cast<std::streamsize>(count * sizeof(T)));
+    m_offset += count * sizeof(T);
+  }
+
+  // Zero-fills up to `offset`, so padding and unused peak slots are defined.
+  void padTo(std::uint64_t offset)
+  {
+    static constexpr char kZeros[256] = {};
+    while (m_offset < offset) {
+      auto count = std::min<std::uint64_t>(offset - m_offset, sizeof(kZeros));
+      write(kZeros, static_cast<std::size_t>(count));
+    }
+  }
+
+private:
+  std::ostream& m_output;
+  std::uint64_t m_offset = 0;
+};
+
+// The on-disk records hold 32-bit counts and offsets; refuse anything larger
+// rather than write a cache that reads back wrong.
+std::uint32_t narrow(std::size_t value, const char* what)
+{
+  if (value > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::length_error(std::string("Library cache ") + what
+                            + " exceeds 32 bits");
+  }
+  return static_cast<std::uint32_t>(value);
+}
+
+cache::StringRef addString(std::string& strings, std::string_view value)
+{
+  cache::StringRef ref = {narrow(strings.size(), "string table"),
+                          narrow(value.size(), "string")};
+  strings += value;
+  return ref;
+}
+
+}  // namespace
+
+void writeLibraryCache(const Library& library, std::ostream& output)
+{
+  std::vector<cache::CompoundRecord> compounds;
+  std::vector<cache::SpectrumRecord> spectra;
+  std::string strings;
+  std::uint64_t peaks = 0;
+
+  compounds.reserve(library.Compounds.size());
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    cache::CompoundRecord record = {};
+    record.LibraryID = compound.LibraryID;
+    record.CompoundID = compound.CompoundID;
+    record.FirstSpectrum = narrow(spectra.size(), "spectrum table");
+    record.SpectrumCount = narrow(compound.Spectra.size(), "spectrum count");
+    record.BoilingPoint = compound.BoilingPoint;
+    record.MeltingPoint = compound.MeltingPoint;
+    record.MolecularWeight = compound.MolecularWeight;
+    record.RetentionIndex = compound.RetentionIndex;
+    record.RetentionTimeRTL = compound.RetentionTimeRTL;
+    record.CASNumber = addString(strings, compound.CASNumber);
+    record.CompoundName = addString(strings, compound.CompoundName);
+    record.Formula = addString(strings, compound.Formula);
+    compounds.push_back(record);
+
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      cache::SpectrumRecord entry = {};
+      entry.LibraryID = spectrum.LibraryID;
+      entry.CompoundID = spectrum.CompoundID;
+      entry.SpectrumID = spectrum.SpectrumID;
+      entry.BasePeakMZ = spectrum.BasePeakMZ;
+      entry.FirstPeak = peaks;
+      entry.MzCount = narrow(spectrum.MzValues.size(), "peak count");
+      entry.AbundanceCount =
+          narrow(spectrum.AbundanceValues.size(), "peak count");
+      spectra.push_back(entry);
+
+      peaks += std::max(entry.MzCount, entry.AbundanceCount);
+    }
+  }
+
+  cache::Header header = {};
+  std::memcpy(header.Magic, cache::kMagic, sizeof(header.Magic));
+  header.Version = cache::kVersion;
+  header.Flags = library.AccurateMass ? cache::kAccurateMass : 0;
+  header.LibraryID = library.LibraryID;
+  header.CompoundCount = narrow(compounds.size(), "compound table");
+  header.SpectrumCount = spectra.size();
+  header.PeakCount = peaks;
+  header.StringsSize = strings.size();
+  header.CompoundsOffset = align(sizeof(cache::Header));
+  header.SpectraOffset = align(header.CompoundsOffset
+                               + compounds.size() * sizeof(cache::CompoundRecord));
+  header.MzValuesOffset = align(header.SpectraOffset
+                                + spectra.size() * sizeof(cache::SpectrumRecord));
+  header.AbundanceValuesOffset =
+      align(header.MzValuesOffset + peaks * sizeof(Spectrum::tMzValue));
+  header.StringsOffset = align(header.AbundanceValuesOffset
+                               + peaks * sizeof(Spectrum::tAbundanceValue));
+
+  LIB_STATS_SCOPE(Write);
+  LIB_TRACE_SCOPE("write cache");
+
+  LIB_STATS_ADD(BytesWritten, header.StringsOffset + strings.size());
+
+  // Sections in file order, each peak array in its spectrum's slot.
+  SequentialWriter writer(output);
+  writer.write(&header, 1);
+  writer.padTo(header.CompoundsOffset);
+  writer.write(compounds.data(), compounds.size());
+  writer.padTo(header.SpectraOffset);
+  writer.write(spectra.data(), spectra.size());
+
+  auto entry = spectra.begin();
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      writer.padTo(header.MzValuesOffset
+                   + entry->FirstPeak * sizeof(Spectrum::tMzValue));
+      writer.write(spectrum.MzValues.data(), spectrum.MzValues.size());
+      ++entry;
+    }
+  }
+  entry = spectra.begin();
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      writer.padTo(header.AbundanceValuesOffset
+                   + entry->FirstPeak * sizeof(Spectrum::tAbundanceValue));
+      writer.write(spectrum.AbundanceValues.data(),
+                   spectrum.AbundanceValues.size());
+      ++entry;
+    }
+  }
+
+  writer.padTo(header.StringsOffset);
+  writer.write(strings.data(), strings.size());
+
+  if (!output) {
+    throw std::runtime_error("Failed to write library cache");
+  }
+}
+
+void writeLibraryCache(const Library& library, const std::string& path)
+{
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open library cache: " + path);
+  }
+  writeLibraryCache(library, output);
+}
+
+bool isLibraryCache(const std::string& path)
+{
+  char magic[sizeof(cache::kMagic)] = {};
+  std::ifstream input(path, std::ios::binary);
+  input.read(magic, sizeof(magic));
+  return input && std::memcmp(magic, cache::kMagic, sizeof(magic)) == 0;
+}
+
+MappedLibrary::MappedLibrary(const std::string& path)
+    : m_file(path.c_str(), boost::interprocess::read_only)
+    , m_region(m_file, boost::interprocess::read_only)
+{
+  if (m_region.get_size() < sizeof(cache::Header)) {
+    throw std::runtime_error("Library cache is truncated: " + path);
+  }
+
+  m_header = static_cast<const cache::Header*>(m_region.get_address());
+
+  if (std::memcmp(m_header->Magic, cache::kMagic, sizeof(cache::kMagic)) != 0)
+  {
+    throw std::runtime_error("Not a library cache: " + path);
+  }
+  if (m_header->Version != cache::kVersion) {
+    throw std::runtime_error("Unsupported library cache version "
+                             + std::to_string(m_header->Version) + ": "
+                             + path);
+  }
+
+  // Bounds-check every section once so accessors can stay unchecked.
+  section<cache::CompoundRecord>(m_header->CompoundsOffset,
+                                 m_header->CompoundCount);
+  section<cache::SpectrumRecord>(m_header->SpectraOffset,
+                                 m_header->SpectrumCount);
+  section<Spectrum::tMzValue>(m_header->MzValuesOffset, m_header->PeakCount);
+  section<Spectrum::tAbundanceValue>(m_header->AbundanceValuesOffset,
+                                     m_header->PeakCount);
+  section<char>(m_header->StringsOffset, m_header->StringsSize);
+
+  for (const auto& spectrum : spectra()) {
+    std::uint64_t slots = std::max(spectrum.MzCount, spectrum.AbundanceCount);
+    if (spectrum.FirstPeak + slots > m_header->PeakCount) {
+      throw std::runtime_error("Library cache peak table is corrupt: " + path);
+    }
+  }
+  for (const auto& compound : compounds()) {
+    if (std::uint64_t(compound.FirstSpectrum) + compound.SpectrumCount
+        > m_header->SpectrumCount)
+    {
+      throw std::runtime_error("Library cache spectrum table is corrupt: "
+                               + path);
+    }
+  }
+}
+
+template<typename T>
+const T* MappedLibrary::section(std::uint64_t offset, std::uint64_t count) const
+{
+  if (offset % alignof(T) != 0 || offset > m_region.get_size()
+      || count > (m_region.get_size() - offset) / sizeof(T))
+  {
+    throw std::runtime_error("Library cache section out of bounds");
+  }
+  return reinterpret_cast<const T*>(
+      static_cast<const char*>(m_region.get_address()) + offset);
+}
+
+std::span<const cache::CompoundRecord> MappedLibrary::compounds() const
+{
+  return {section<cache::CompoundRecord>(m_header->CompoundsOffset, 0),
+          m_header->CompoundCount};
+}
+
+std::span<const cache::SpectrumRecord> MappedLibrary::spectra() const
+{
+  return {section<cache::SpectrumRecord>(m_header->SpectraOffset, 0),
+          m_header->SpectrumCount};
+}
+
+std::span<const cache::SpectrumRecord> MappedLibrary::spectra(
+    const cache::CompoundRecord& compound) const
+{
+  return spectra().subspan(compound.FirstSpectrum, compound.SpectrumCount);
+}
+
+const cache::CompoundRecord* MappedLibrary::find(tCompoundID compoundID) const
+{
+  auto table = compounds();
+  auto it = std::lower_bound(table.begin(),
+                             table.end(),
+                             compoundID,
+                             [](const cache::CompoundRecord& record,
+                                tCompoundID id)
+                             { return record.CompoundID < id; });
+  if (it == table.end() || it->CompoundID != compoundID) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+std::string_view MappedLibrary::string(cache::StringRef ref) const
+{
+  if (std::uint64_t(ref.Offset) + ref.Length > m_header->StringsSize) {
+    throw std::runtime_error("Library cache string out of bounds");
+  }
+  return {section<char>(m_header->StringsOffset, 0) + ref.Offset, ref.Length};
+}
+
+std::span<const Spectrum::tMzValue> MappedLibrary::mzValues(
+    const cache::SpectrumRecord& spectrum) const
+{
+  return {section<Spectrum::tMzValue>(m_header->MzValuesOffset, 0)
+              + spectrum.FirstPeak,
+          spectrum.MzCount};
+}
+
+std::span<const Spectrum::tAbundanceValue> MappedLibrary::abundanceValues(
+    const cache::SpectrumRecord& spectrum) const
+{
+  return {section<Spectrum::tAbundanceValue>(m_header->AbundanceValuesOffset,
+                                             0)
+              + spectrum.FirstPeak,
+          spectrum.AbundanceCount};
+}
+
+Library MappedLibrary::toLibrary(Projection projection,
+                                 const Library::allocator_type& allocator) const
+{
+  Library library(allocator);
+  library.LibraryID = libraryID();
+  library.AccurateMass = accurateMass();
+
+  for (const auto& record : compounds()) {
+    Compound compound(allocator);
+    compound.LibraryID = record.LibraryID;
+    compound.CompoundID = record.CompoundID;
+    compound.CASNumber = string(record.CASNumber);
+    compound.CompoundName = string(record.CompoundName);
+    compound.Formula = string(record.Formula);
+    compound.BoilingPoint = record.BoilingPoint;
+    compound.MeltingPoint = record.MeltingPoint;
+    compound.MolecularWeight = record.MolecularWeight;
+    compound.RetentionIndex = record.RetentionIndex;
+    compound.RetentionTimeRTL = record.RetentionTimeRTL;
+    library.insert(std::move(compound));
+
+    for (const auto& entry : spectra(record)) {
+      Spectrum spectrum(allocator);
+      spectrum.LibraryID = entry.LibraryID;
+      spectrum.CompoundID = entry.CompoundID;
+      spectrum.SpectrumID = entry.SpectrumID;
+      spectrum.BasePeakMZ = entry.BasePeakMZ;
+
+      if (includes(projection, Projection::MzValues)) {
+        auto mz = mzValues(entry);
+        spectrum.MzValues.assign(mz.begin(), mz.end());
+      }
+      if (includes(projection, Projection::AbundanceValues)) {
+        auto abundance = abundanceValues(entry);
+        spectrum.AbundanceValues.assign(abundance.begin(), abundance.end());
+      }
+      library.insert(std::move(spectrum));
+    }
+  }
+
+  return library;
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "io/library_generator.hpp"
+#include "io/numeric.hpp"
+
+#include "base64.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+constexpr std::size_t kBufferSize = 1 << 20;
+
+class Generator
+{
+public:
+  Generator(const GeneratorOptions& options, std::ostream& output)
+      : m_options(options)
+      , m_output(output)
+      , m_mz(options.PeaksPerSpectrum)
+      , m_abundance(options.PeaksPerSpectrum)
+  {
+    m_buffer.reserve(kBufferSize + kBufferSize / 4);
+  }
+
+  void run()
+  {
+    put("<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\"?>\n"
+        "<LibraryDataSet xmlns=\"http://tempuri.org/LibraryDataSet.xsd\">\n"
+        "  <Library>\n"
+        "    <LibraryID>1</LibraryID>\n"
+        "    <AccurateMass>");
+    put(m_options.AccurateMass ? "true" : "false");
+    put("</AccurateMass>\n"
+        "  </Library>\n");
+
+    for (std::uint64_t id = 1; id <= m_options.Compounds; ++id) {
+      compound(id);
+    }
+
+    std::uint64_t spectrumID = 1;
+    for (std::uint64_t id = 1; id <= m_options.Compounds; ++id) {
+      // Seeded per compound so the spectra need no state from the first pass.
+      std::mt19937_64 random(m_options.Seed * 0x9E3779B97F4A7C15ULL + id);
+      for (std::size_t s = 0; s < m_options.SpectraPerCompound; ++s) {
+        spectrum(id, spectrumID++, random);
+      }
+    }
+
+    put("</LibraryDataSet>\n");
+    flush();
+  }
+
+private:
+  void compound(std::uint64_t id)
+  {
+    put("  <Compound>\n"
+        "    <LibraryID>1</LibraryID>\n"
+        "    <CompoundID>");
+    put(id);
+    put("</CompoundID>\n"
+        "    <CASNumber>");
+    put(id);
+    put("-00-0</CASNumber>\n"
+        "    <CompoundName>Compound ");
+    put(id);
+    put("</CompoundName>\n"
+        "    <Formula>C");
+    put(id % 60 + 1);
+    put("H");
+    put(2 * (id % 60) + 4);
+    put("</Formula>\n"
+        "    <MolecularWeight>");
+    put(static_cast<double>(14 * (id % 60) + 16), 3);
+    put("</MolecularWeight>\n"
+        "    <RetentionIndex>");
+    put(1000 + id);
+    put("</RetentionIndex>\n"
+        "    <RetentionTimeRTL>");
+    put(static_cast<double>(id % 6000) / 100, 4);
+    put("</RetentionTimeRTL>\n"
+        "  </Compound>\n");
+    maybeFlush();
+  }
+
+  void spectrum(std::uint64_t compoundID,
+                std::uint64_t spectrumID,
+                std::mt19937_64& random)
+  {
+    std::uniform_real_distribution<double> uniform(m_options.MinMz,
+                                                   m_options.MaxMz);
+    std::exponential_distribution<double> exponential(
+        4 / (m_options.MaxMz - m_options.MinMz));
+    std::uniform_int_distribution<std::int64_t> nominal(
+        static_cast<std::int64_t>(std::ceil(m_options.MinMz)),
+        static_cast<std::int64_t>(std::floor(m_options.MaxMz)));
+    std::uniform_real_distribution<double> abundance(1, 9999);
+
+    for (auto& mz : m_mz) {
+      switch (m_options.Distribution) {
+        case MzDistribution::Uniform:
+          mz = uniform(random);
+          break;
+        case MzDistribution::Nominal:
+          mz = static_cast<double>(nominal(random));
+          break;
+        case MzDistribution::Exponential:
+          do {
+            mz = m_options.MinMz + exponential(random);
+          } while (mz > m_options.MaxMz);
+          break;
+      }
+    }
+    std::sort(m_mz.begin(), m_mz.end());
+
+    std::size_t base = 0;
+    for (std::size_t p = 0; p < m_abundance.size(); ++p) {
+      m_abundance[p] = abundance(random);
+      if (m_abundance[p] > m_abundance[base]) {
+        base = p;
+      }
+    }
+    if (!m_abundance.empty()) {
+      m_abundance[base] = 9999;
+    }
+
+    put("  <Spectrum>\n"
+        "    <LibraryID>1</LibraryID>\n"
+        "    <CompoundID>");
+    put(compoundID);
+    put("</CompoundID>\n"
+        "    <SpectrumID>");
+    put(spectrumID);
+    put("</SpectrumID>\n"
+        "    <BasePeakMZ>");
+    put(m_mz.empty() ? 0.0 : m_mz[base], 4);
+    put("</BasePeakMZ>\n"
+        "    <IonPolarity>Positive</IonPolarity>\n"
+        "    <MzValues>");
+    putArray(m_mz);
+    put("</MzValues>\n"
+        "    <AbundanceValues>");
+    putArray(m_abundance);
+    put("</AbundanceValues>\n"
+        "  </Spectrum>\n");
+    maybeFlush();
+  }
+
+  void put(std::string_view text) { m_buffer.append(text); }
+
+  void put(std::uint64_t value) { numeric::append(m_buffer, value); }
+
+  void put(double value, int decimals)
+  {
+    numeric::append(m_buffer, value, std::chars_format::fixed, decimals);
+  }
+
+  void putArray(const std::vector<double>& values)
+  {
+    if constexpr (std::endian::native == std::endian::little) {
+      base64::encode(std::as_bytes(std::span<const double>(values)), m_scratch);
+    } else {
+      m_scratch = base64::encodeArray<double>(values);
+    }
+    m_buffer.append(m_scratch);
+  }
+
+  void maybeFlush()
+  {
+    if (m_buffer.size() >= kBufferSize) {
+      flush();
+    }
+  }
+
+  void flush()
+  {
+    m_output.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    if (!m_output) {
+      throw std::runtime_error("Failed to write generated library");
+    }
+    m_buffer.clear();
+  }
+
+  const GeneratorOptions& m_options;
+  std::ostream& m_output;
+  std::string m_buffer;
+  std::string m_scratch;
+  std::vector<double> m_mz;
+  std::vector<double> m_abundance;
+};
+
+}  // namespace
+
+MzDistribution parseMzDistribution(std::string_view text)
+{
+  if (text == "uniform") {
+    return MzDistribution::Uniform;
+  }
+  if (text == "nominal") {
+    return MzDistribution::Nominal;
+  }
+  if (text == "exponential") {
+    return MzDistribution::Exponential;
+  }
+  throw std::invalid_argument("Unknown m/z distribution: " + std::string(text));
+}
+
+void generateLibrary(const GeneratorOptions& options, std::ostream& output)
+{
+  if (!(options.MinMz >= 0 && options.MinMz < options.MaxMz)
+      || !std::isfinite(options.MaxMz))
+  {
+    throw std::invalid_argument("Generator m/z range must be 0 <= min < max");
+  }
+  // Whole masses past 2^53 are no longer exact doubles.
+  if (options.Distribution == MzDistribution::Nominal
+      && (std::ceil(options.MinMz) > std::floor(options.MaxMz)
+          || options.MaxMz >= 0x1p53))
+  {
+    throw std::invalid_argument(
+        "Generator m/z range must contain a whole mass for nominal m/z");
+  }
+  Generator(options, output).run();
+  output.flush();
+}
+
+void generateLibrary(const GeneratorOptions& options, const std::string& path)
+{
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open output file: " + path);
+  }
+  generateLibrary(options, output);
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "io/chunked_reader.hpp"
+#include "io/library_cache.hpp"
+#include "io/library_reader.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+constexpr std::size_t kBufferSize = 1 << 16;
+
+bool isWhitespace(int c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool isNameChar(int c)
+{
+  return c != EOF && !isWhitespace(c) && c != '>' && c != '/' && c != '='
+      && c != '<';
+}
+
+void appendUtf8(std::string& out, unsigned long code)
+{
+  if (code < 0x80) {
+    out.push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+// The code point of a numeric character reference's digits, or nothing
+// when they are empty, malformed or beyond Unicode.
+std::optional<unsigned long> parseCodePoint(std::string_view digits, int base)
+{
+  unsigned long code = 0;
+  auto [end, error] =
+      std::from_chars(digits.data(), digits.data() + digits.size(), code, base);
+  if (digits.empty() || error != std::errc()
+      || end != digits.data() + digits.size() || code > 0x10FFFF)
+  {
+    return std::nullopt;
+  }
+  return code;
+}
+
+// Replaces the predefined and numeric character references in place.
+// Unknown references are kept verbatim, as rapidxml does. Returns false,
+// leaving `text` as it was, on a numeric reference that is not a code point.
+bool decodeEntities(std::string& text)
+{
+  std::size_t amp = text.find('&');
+  if (amp == std::string::npos) {
+    return true;
+  }
+
+  std::string out;
+  out.reserve(text.size());
+  out.append(text, 0, amp);
+
+  for (std::size_t i = amp; i < text.size();) {
+    if (text[i] != '&') {
+      out.push_back(text[i++]);
+      continue;
+    }
+
+    std::size_t semi = text.find(';', i);
+    if (semi == std::string::npos) {
+      out.append(text, i, std::string::npos);
+      break;
+    }
+
+    std::string_view entity(text.data() + i + 1, semi - i - 1);
+    if (entity == "amp") {
+      out.push_back('&');
+    } else if (entity == "lt") {
+      out.push_back('<');
+    } else if (entity == "gt") {
+      out.push_back('>');
+    } else if (entity == "quot") {
+      out.push_back('"');
+    } else if (entity == "apos") {
+      out.push_back('\'');
+    } else if (!entity.empty() && entity[0] == '#') {
+      bool hex = entity.size() > 1 && entity[1] == 'x';
+      auto code = parseCodePoint(entity.substr(hex ? 2 : 1), hex ? 16 : 10);
+      if (!code) {
+        return false;
+      }
+      appendUtf8(out, *code);
+    } else {
+      out.append(text, i, semi - i + 1);
+    }
+    i = semi + 1;
+  }
+
+  text.swap(out);
+  return true;
+}
+
+// The child for the next element named `name` under `node`: the one an
+// earlier record left at `cursor` if the names match, otherwise a new one
+// that replaces everything from `cursor` on.
+boost::property_tree::ptree& reuseChild(
+    boost::property_tree::ptree& node,
+    boost::property_tree::ptree::iterator& cursor,
+    const std::string& name)
+{
+  if (cursor != node.end() && cursor->first == name) {
+    return (cursor++)->second;
+  }
+  node.erase(cursor, node.end());
+  node.push_back({name, boost::property_tree::ptree()});
+  cursor = node.end();
+  return node.back().second;
+}
+
+#if LIB_STATS
+// A file that cannot be sized is left to the open that follows to report,
+// and adds nothing to the read volume.
+void countBytesRead(const std::string& path)
+{
+  std::error_code error;
+  const auto size = std::filesystem::file_size(path, error);
+  if (!error) {
+    LIB_STATS_ADD(BytesRead, size);
+  }
+}
+#endif
+
+}  // namespace
+
+LibraryReader::LibraryReader(std::istream& input,
+                             std::string filename,
+                             Mode mode)
+    : m_input(input)
+    , m_filename(std::move(filename))
+    , m_buffer(kBufferSize)
+    , m_fragment(mode == Mode::Fragment)
+{
+  if (m_fragment) {
+    return;
+  }
+
+  // Prolog: declaration, comments and doctype up to the root element.
+  while (true) {
+    skipWhitespace();
+    if (peek() == EOF) {
+      fail("no element found");
+    }
+    if (get() != '<') {
+      fail("expected <");
+    }
+    if (peek() == '?' || peek() == '!') {
+      skipMarkup();
+      continue;
+    }
+    break;
+  }
+
+  m_rootLine = m_line;
+  m_root = readName();
+  while (true) {
+    skipWhitespace();
+    int c = get();
+    if (c == '>') {
+      break;
+    }
+    if (c == '/' && get() == '>') {
+      m_done = true;
+      break;
+    }
+    if (c == EOF) {
+      fail("unexpected end of data");
+    }
+    if (c == '"' || c == '\'') {
+      std::string ignored;
+      readText(ignored, static_cast<char>(c));
+      get();
+    }
+  }
+}
+
+int LibraryReader::peek()
+{
+  if (m_pos == m_end && !fill()) {
+    return EOF;
+  }
+  return static_cast<unsigned char>(m_buffer[m_pos]);
+}
+
+int LibraryReader::get()
+{
+  int c = peek();
+  if (c != EOF) {
+    ++m_pos;
+    if (c == '\n') {
+      ++m_line;
+    }
+  }
+  return c;
+}
+
+bool LibraryReader::fill()
+{
+  if (!m_input) {
+    return false;
+  }
+  m_input.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  m_pos = 0;
+  m_end = static_cast<std::size_t>(m_input.gcount());
+  return m_end > 0;
+}
+
+// Consumes `literal` if the input continues with it. Only used on markup
+// openers, which never straddle more than one refill.
+bool LibraryReader::startsWith(const char* literal)
+{
+  std::size_t length = std::strlen(literal);
+  if (m_end - m_pos < length) {
+    std::memmove(m_buffer.data(), m_buffer.data() + m_pos, m_end - m_pos);
+    m_end -= m_pos;
+    m_pos = 0;
+    if (m_input) {
+      m_input.read(m_buffer.data() + m_end,
+                   static_cast<std::streamsize>(m_buffer.size() - m_end));
+      m_end += static_cast<std::size_t>(m_input.gcount());
+    }
+  }
+  if (m_end - m_pos < length
+      || std::memcmp(m_buffer.data() + m_pos, literal, length) != 0)
+  {
+    return false;
+  }
+  m_pos += length;
+  return true;
+}
+
+void LibraryReader::skipWhitespace()
+{
+  while (isWhitespace(peek())) {
+    get();
+  }
+}
+
+void LibraryReader::skipUntil(const char* terminator)
+{
+  while (!startsWith(terminator)) {
+    if (get() == EOF) {
+      fail("unexpected end of data");
+    }
+  }
+}
+
+// Skips a comment, processing instruction or declaration; the leading '<'
+// has already been consumed.
+void LibraryReader::skipMarkup()
+{
+  if (startsWith("!--")) {
+    skipUntil("-->");
+  } else if (startsWith("?")) {
+    skipUntil("?>");
+  } else {
+    int depth = 1;
+    while (depth > 0) {
+      int c = get();
+      if (c == EOF) {
+        fail("unexpected end of data");
+      }
+      depth += c == '<' ? 1 : c == '>' ? -1 : 0;
+    }
+  }
+}
+
+std::string LibraryReader::readName()
+{
+  std::string name;
+  while (isNameChar(peek())) {
+    name.push_back(static_cast<char>(get()));
+  }
+  if (name.empty()) {
+    fail("expected element or attribute name");
+  }
+  return name;
+}
+
+// Appends raw characters up to (not including) `terminator`.
+void LibraryReader::readText(std::string& text, char terminator)
+{
+  while (true) {
+    if (m_pos == m_end && !fill()) {
+      fail("unexpected end of data");
+    }
+    const char* begin = m_buffer.data() + m_pos;
+    const char* stop = static_cast<const char*>(
+        std::memchr(begin, terminator, m_end - m_pos));
+    const char* last = stop ? stop : m_buffer.data() + m_end;
+
+    text.append(begin, last);
+    m_line += static_cast<unsigned long>(std::count(begin, last, '\n'));
+    m_pos += static_cast<std::size_t>(last - begin);
+    if (stop) {
+      return;
+    }
+  }
+}
+
+// Reads the rest of an element whose tag name has been consumed, mapping it
+// the way read_xml does: attributes under <xmlattr>, text as the node data.
+// Whatever `node` held before is overwritten in place.
+void LibraryReader::readElement(boost::property_tree::ptree& node,
+                                const std::string& name)
+{
+  auto cursor = node.begin();
+  boost::property_tree::ptree* attributes = nullptr;
+  auto& data = node.data();
+  data.clear();
+
+  while (true) {
+    skipWhitespace();
+    int c = peek();
+    if (c == '>') {
+      get();
+      break;
+    }
+    if (c == '/') {
+      get();
+      if (get() != '>') {
+        fail("expected >");
+      }
+      node.erase(cursor, node.end());
+      return;
+    }
+    if (c == EOF) {
+      fail("unexpected end of data");
+    }
+
+    std::string attribute = readName();
+    skipWhitespace();
+    if (get() != '=') {
+      fail("expected =");
+    }
+    skipWhitespace();
+    int quote = get();
+    if (quote != '"' && quote != '\'') {
+      fail("expected ' or \"");
+    }
+    std::string value;
+    readText(value, static_cast<char>(quote));
+    get();
+    if (!decodeEntities(value)) {
+      fail("invalid numeric character entity");
+    }
+    if (!attributes) {
+      attributes = &reuseChild(node, cursor, "<xmlattr>");
+      attributes->clear();
+    }
+    attributes->put_child(
+        boost::property_tree::ptree::path_type(attribute, '/'),
+        boost::property_tree::ptree(std::move(value)));
+  }
+
+  while (true) {
+    std::size_t start = data.size();
+    readText(data, '<');
+    get();
+
+    // Whitespace only runs between child elements are not content.
+    if (std::all_of(data.begin() + static_cast<std::ptrdiff_t>(start),
+                    data.end(),
+                    isWhitespace))
+    {
+      data.resize(start);
+    } else if (data.find('&', start) != std::string::npos) {
+      std::string text = data.substr(start);
+      if (!decodeEntities(text)) {
+        fail("invalid numeric character entity");
+      }
+      data.replace(start, std::string::npos, text);
+    }
+
+    if (startsWith("/")) {
+      if (readName() != name) {
+        fail("invalid closing tag name");
+      }
+      skipWhitespace();
+      if (get() != '>') {
+        fail("expected >");
+      }
+      break;
+    }
+    if (startsWith("![CDATA[")) {
+      while (!startsWith("]]>")) {
+        int c = get();
+        if (c == EOF) {
+          fail("unexpected end of data");
+        }
+        data.push_back(static_cast<char>(c));
+      }
+      continue;
+    }
+    if (peek() == '!' || peek() == '?') {
+      skipMarkup();
+      continue;
+    }
+
+    std::string child = readName();
+    readElement(reuseChild(node, cursor, child), child);
+  }
+
+  node.erase(cursor, node.end());
+}
+
+LibraryReader::Record LibraryReader::next()
+{
+  m_name.clear();
+  m_record = Record::End;
+
+  while (!m_done) {
+    skipWhitespace();
+    int c = get();
+    if (c == EOF && m_fragment) {
+      m_done = true;
+      break;
+    }
+    if (c == EOF) {
+      fail("unexpected end of data");
+    }
+    if (c != '<') {
+      // Stray text directly under the root carries no records.
+      continue;
+    }
+    if (startsWith("/")) {
+      m_done = true;
+      break;
+    }
+    if (peek() == '!' || peek() == '?') {
+      skipMarkup();
+      continue;
+    }
+
+    m_name = readName();
+    auto record = m_name == "Library" ? Record::Library
+        : m_name == "Compound"        ? Record::Compound
+        : m_name == "Spectrum"        ? Record::Spectrum
+                                      : Record::Other;
+    readElement(m_trees[static_cast<std::size_t>(record)], m_name);
+    m_record = record;
+    return record;
+  }
+
+  return Record::End;
+}
+
+Compound LibraryReader::compound(tLibraryID libraryID,
+                                 const Compound::allocator_type& allocator)
+{
+  return Compound(libraryID, tree(), allocator);
+}
+
+Spectrum LibraryReader::spectrum(Projection projection,
+                                 const Spectrum::allocator_type& allocator)
+{
+  return Spectrum(tree(), projection, allocator);
+}
+
+void LibraryReader::requireRoot(std::string_view name) const
+{
+  if (!m_fragment && m_root != name) {
+    throw boost::property_tree::xml_parser_error(
+        "expected root element " + std::string(name), m_filename, m_rootLine);
+  }
+}
+
+void LibraryReader::fail(const std::string& message) const
+{
+  throw boost::property_tree::xml_parser_error(message, m_filename, m_line);
+}
+
+Library readLibrary(const std::string& path,
+                    Projection projection,
+                    unsigned threads,
+                    const Library::allocator_type& allocator)
+{
+  LIB_STATS_SCOPE(Read);
+  LIB_TRACE_SCOPE("load library");
+#if LIB_STATS
+  countBytesRead(path);
+#endif
+
+  if (isLibraryCache(path)) {
+    return MappedLibrary(path).toLibrary(projection, allocator);
+  }
+  if (resolveThreads(threads) > 1) {
+    return readLibraryParallel(
+        path, projection, resolveThreads(threads), allocator);
+  }
+
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    throw boost::property_tree::xml_parser_error(
+        "cannot open file", path, 0);
+  }
+
+  LibraryReader reader(input, path);
+  return Library(reader, projection, allocator);
+}
+
+SpectralStore readSpectralStore(const std::string& path,
+                                unsigned threads,
+                                const Library::allocator_type& allocator)
+{
+  if (isLibraryCache(path)) {
+    LIB_STATS_SCOPE(Read);
+    LIB_TRACE_SCOPE("load library");
+#if LIB_STATS
+    countBytesRead(path);
+#endif
+    return SpectralStore(MappedLibrary(path));
+  }
+  return SpectralStore(
+      readLibrary(path, Projection::All, threads, allocator));
+}
+
+}  // namespace LIB_NAMESPACE
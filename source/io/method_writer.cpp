@@ -0,0 +1,178 @@
+#include <vector>
+
+#include "io/method_writer.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+void writeLimit(XmlWriter& writer,
+                std::string_view name,
+                const Parameter::Limits_T::Limit_T& limit)
+{
+  writer.startElement(name);
+  writer.attribute("type", limit.attr.type);
+  writer.text(limit.value);
+  writer.endElement();
+}
+
+void writeOptional(XmlWriter& writer,
+                   std::string_view name,
+                   const std::optional<std::string>& value)
+{
+  if (value) {
+    writer.element(name, *value);
+  }
+}
+
+}  // namespace
+
+void writeXml(XmlWriter& writer, const Parameter& parameter)
+{
+  writer.startElement("Parameter");
+  writer.attribute("id", parameter.attrs.id);
+  writer.element("DisplayName", parameter.DisplayName);
+  writer.element("Value", parameter.Value);
+  writeOptional(writer, "Default", parameter.Default);
+
+  if (parameter.Limits) {
+    writer.startElement("Limits");
+    writeLimit(writer, "Minimum", parameter.Limits->Minimum);
+    writeLimit(writer, "Maximum", parameter.Limits->Maximum);
+    writer.endElement();
+  }
+
+  writeOptional(writer, "Units", parameter.XUnits);
+  writeOptional(writer, "DataValueType", parameter.DataValueType);
+  writeOptional(writer, "PrecisionType", parameter.PrecisionType);
+  writeOptional(writer, "PrecisionDigits", parameter.PrecisionDigits);
+  writeOptional(writer, "ConversionSupport", parameter.ConversionSupport);
+  writer.endElement();
+}
+
+void writeXml(XmlWriter& writer,
+              const IntegrationParameters::ParameterSet_T& parameterSet)
+{
+  writer.startElement("ParameterSet");
+  writer.attribute("usagekey", parameterSet.attrs.usageKey);
+  writer.attribute("assembly", parameterSet.attrs.assembly);
+  writer.attribute("class", parameterSet.attrs.class_);
+  writeXml(writer, parameterSet.DataPointSampling);
+  writeXml(writer, parameterSet.Smoothing);
+  writeXml(writer, parameterSet.DetectionFiltering);
+  writeXml(writer, parameterSet.StartThreshold);
+  writeXml(writer, parameterSet.StopThreshold);
+  writeXml(writer, parameterSet.PeakLocation);
+  writeXml(writer, parameterSet.BaselineReset);
+  writeXml(writer, parameterSet.BaselineValley);
+  writeXml(writer, parameterSet.BaselinePreference);
+  writer.endElement();
+}
+
+std::string encodeParameterSet(
+    const IntegrationParameters::ParameterSet_T& parameterSet)
+{
+  std::string encoded;
+  {
+    XmlWriter writer(encoded);
+    writer.declaration();
+    writeXml(writer, parameterSet);
+  }
+  return encoded;
+}
+
+void writeXml(XmlWriter& writer, const TargetCompound& target)
+{
+  writer.startElement("TargetCompound");
+  fields::forEach(kTargetCompoundFields,
+                  [&](const auto& field)
+                  { writer.element(field.Name, target.value(field.Member)); });
+  writer.endElement();
+}
+
+namespace
+{
+
+void startDataSet(XmlWriter& writer, const QuantitationDataSet& method)
+{
+  writer.startElement("QuantitationDataSet");
+  fields::forEach(kQuantitationDataSetAttributeFields,
+                  [&](const auto& field)
+                  { writer.attribute(field.Name, method.attr.*field.Member); });
+}
+
+// Serializes batches of targets into fragments on the pool and splices them
+// into `writer` in target order.
+void writeTargets(XmlWriter& writer,
+                  const QuantitationDataSet& method,
+                  unsigned threads)
+{
+  const auto& targets = method.Targets;
+  if (threads <= 1 || targets.size() < 2) {
+    for (const auto& target : targets) {
+      writeXml(writer, target);
+    }
+    return;
+  }
+
+  const WorkStealingPool pool(threads);
+  std::vector<std::uint64_t> weights(targets.size(), 1);
+  const auto batches = partitionByWeight(weights, pool.threads());
+  OrderedWriter output([&writer](std::string_view fragment)
+                       { writer.raw(fragment); },
+                       batches.size() - 1);
+
+  pool.run(batches.size() - 1,
+           [&](std::size_t batch, unsigned)
+           {
+             LIB_TRACE_SCOPE("format targets", "batch", batch);
+             std::string fragment;
+             {
+               XmlWriter local(fragment, 1);
+               for (auto i = batches[batch]; i < batches[batch + 1]; ++i) {
+                 writeXml(local, targets[i]);
+               }
+             }
+             output.write(batch, std::move(fragment));
+           });
+}
+
+void writeDocument(XmlWriter& writer,
+                   const QuantitationDataSet& method,
+                   unsigned threads)
+{
+  writer.declaration();
+  startDataSet(writer, method);
+  writeTargets(writer, method, threads);
+  writer.endElement();
+  writer.flush();
+}
+
+}  // namespace
+
+void writeXml(XmlWriter& writer, const QuantitationDataSet& method)
+{
+  startDataSet(writer, method);
+  writeTargets(writer, method, 1);
+  writer.endElement();
+}
+
+void writeMethod(const QuantitationDataSet& method,
+                 std::ostream& output,
+                 unsigned threads)
+{
+  XmlWriter writer(output);
+  writeDocument(writer, method, threads);
+}
+
+void writeMethod(const QuantitationDataSet& method, int fd, unsigned threads)
+{
+  XmlWriter writer(fd);
+  writeDocument(writer, method, threads);
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,295 @@
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include "io/xml_writer.hpp"
+#include "io/numeric.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+constexpr std::size_t kBufferSize = 1 << 16;
+constexpr std::string_view kIndent = "    ";
+
+}  // namespace
+
+void escapeXml(std::string_view text, std::string& output)
+{
+  if (text.empty()) {
+    return;
+  }
+
+  if (text.find_first_not_of(' ') == std::string_view::npos) {
+    output += "&#32;";
+    output.append(text.size() - 1, ' ');
+    return;
+  }
+
+  std::size_t start = 0;
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    std::string_view entity;
+    switch (text[i]) {
+      case '<': entity = "&lt;"; break;
+      case '>': entity = "&gt;"; break;
+      case '&': entity = "&amp;"; break;
+      case '"': entity = "&quot;"; break;
+      case '\'': entity = "&apos;"; break;
+      default: continue;
+    }
+    output.append(text.substr(start, i - start));
+    output.append(entity);
+    start = i + 1;
+  }
+  output.append(text.substr(start));
+}
+
+XmlWriter::XmlWriter(std::ostream& output)
+    : m_stream(&output)
+{
+  reserve();
+}
+
+XmlWriter::XmlWriter(int fd)
+    : m_fd(fd)
+{
+  reserve();
+}
+
+XmlWriter::XmlWriter(std::string& output, std::size_t depth)
+    : m_string(&output)
+    , m_depth(depth)
+{
+}
+
+XmlWriter::~XmlWriter()
+{
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+void XmlWriter::reserve()
+{
+  m_buffer.reserve(kBufferSize + kBufferSize / 4);
+}
+
+void XmlWriter::declaration()
+{
+  m_buffer += "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+}
+
+void XmlWriter::indent(std::size_t depth)
+{
+  for (std::size_t i = 0; i < depth; ++i) {
+    m_buffer += kIndent;
+  }
+}
+
+void XmlWriter::escape(std::string_view text)
+{
+  escapeXml(text, m_buffer);
+}
+
+void XmlWriter::closeStartTag()
+{
+  if (m_hasText) {
+    throw std::logic_error("XML element with text cannot take children");
+  }
+  if (m_startTagOpen) {
+    m_buffer += ">\n";
+    m_startTagOpen = false;
+  }
+}
+
+void XmlWriter::startElement(std::string_view name)
+{
+  closeStartTag();
+  indent(m_depth + m_open.size());
+  m_buffer += '<';
+  m_buffer += name;
+  m_open.emplace_back(name);
+  m_startTagOpen = true;
+}
+
+void XmlWriter::attribute(std::string_view name, std::string_view value)
+{
+  if (!m_startTagOpen) {
+    throw std::logic_error("XML attribute written outside a start tag");
+  }
+  m_buffer += ' ';
+  m_buffer += name;
+  m_buffer += "=\"";
+  escape(value);
+  m_buffer += '"';
+}
+
+void XmlWriter::attribute(std::string_view name, const char* value)
+{
+  attribute(name, std::string_view(value));
+}
+
+void XmlWriter::attribute(std::string_view name, bool value)
+{
+  attribute(name, std::string_view(value ? "true" : "false"));
+}
+
+void XmlWriter::text(std::string_view value)
+{
+  if (!m_startTagOpen) {
+    throw std::logic_error("XML text written outside a start tag");
+  }
+  // Like write_xml, empty text leaves an element with only attributes.
+  if (value.empty()) {
+    return;
+  }
+  m_buffer += '>';
+  escape(value);
+  m_startTagOpen = false;
+  m_hasText = true;
+}
+
+void XmlWriter::endElement()
+{
+  if (m_open.empty()) {
+    throw std::logic_error("XML end tag without an open element");
+  }
+
+  if (m_hasText) {
+    m_buffer += "</";
+    m_buffer += m_open.back();
+    m_buffer += ">\n";
+    m_hasText = false;
+  } else if (m_startTagOpen) {
+    m_buffer += "/>\n";
+    m_startTagOpen = false;
+  } else {
+    indent(m_depth + m_open.size() - 1);
+    m_buffer += "</";
+    m_buffer += m_open.back();
+    m_buffer += ">\n";
+  }
+  m_open.pop_back();
+
+  if (m_buffer.size() >= kBufferSize) {
+    flush();
+  }
+}
+
+void XmlWriter::element(std::string_view name, std::string_view value)
+{
+  closeStartTag();
+  indent(m_depth + m_open.size());
+  m_buffer += '<';
+  m_buffer += name;
+  if (value.empty()) {
+    m_buffer += "/>\n";
+    return;
+  }
+  m_buffer += '>';
+  escape(value);
+  m_buffer += "</";
+  m_buffer += name;
+  m_buffer += ">\n";
+}
+
+void XmlWriter::element(std::string_view name, const std::string& value)
+{
+  element(name, std::string_view(value));
+}
+
+void XmlWriter::element(std::string_view name, const char* value)
+{
+  element(name, std::string_view(value));
+}
+
+void XmlWriter::element(std::string_view name, bool value)
+{
+  element(name, std::string_view(value ? "true" : "false"));
+}
+
+void XmlWriter::element(std::string_view name, int value)
+{
+  char buffer[numeric::kMaxChars];
+  element(name,
+          std::string_view(
+              buffer, numeric::format(buffer, buffer + sizeof(buffer), value)));
+}
+
+void XmlWriter::element(std::string_view name, unsigned int value)
+{
+  char buffer[numeric::kMaxChars];
+  element(name,
+          std::string_view(
+              buffer, numeric::format(buffer, buffer + sizeof(buffer), value)));
+}
+
+void XmlWriter::element(std::string_view name, float value)
+{
+  // Shortest round-trip form, as the ptree conversions write it too.
+  char buffer[numeric::kMaxChars];
+  element(name,
+          std::string_view(
+              buffer, numeric::format(buffer, buffer + sizeof(buffer), value)));
+}
+
+void XmlWriter::raw(std::string_view fragment)
+{
+  closeStartTag();
+  m_buffer += fragment;
+  if (m_buffer.size() >= kBufferSize) {
+    flush();
+  }
+}
+
+void XmlWriter::flush()
+{
+  if (m_string) {
+    *m_string += m_buffer;
+  } else if (m_stream) {
+    LIB_STATS_SCOPE(Write);
+    LIB_TRACE_SCOPE("write", "bytes", m_buffer.size());
+    LIB_STATS_ADD(BytesWritten, m_buffer.size());
+    m_stream->write(m_buffer.data(),
+                    static_cast<std::streamsize>(m_buffer.size()));
+    if (!*m_stream) {
+      m_buffer.clear();
+      throw std::runtime_error("Failed to write XML");
+    }
+  } else {
+    LIB_STATS_SCOPE(Write);
+    LIB_TRACE_SCOPE("write", "bytes", m_buffer.size());
+    LIB_STATS_ADD(BytesWritten, m_buffer.size());
+    const char* data = m_buffer.data();
+    std::size_t remaining = m_buffer.size();
+    while (remaining > 0) {
+#ifdef _WIN32
+      auto written = ::_write(m_fd, data, static_cast<unsigned>(remaining));
+#else
+      auto written = ::write(m_fd, data, remaining);
+#endif
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        m_buffer.clear();
+        throw std::runtime_error("Failed to write XML");
+      }
+      data += written;
+      remaining -= static_cast<std::size_t>(written);
+    }
+  }
+  m_buffer.clear();
+}
+
+}  // namespace LIB_NAMESPACE
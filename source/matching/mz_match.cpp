@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matching/mz_match.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+std::string_view trim(std::string_view text)
+{
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front())))
+  {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+  {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs)
+{
+  return std::equal(lhs.begin(),
+                    lhs.end(),
+                    rhs.begin(),
+                    rhs.end(),
+                    [](char a, char b)
+                    {
+                      return std::tolower(static_cast<unsigned char>(a))
+                          == std::tolower(static_cast<unsigned char>(b));
+                    });
+}
+
+// Ascending by m/z with NaN last, a strict weak order even for NaN.
+bool mzLess(double lhs, double rhs)
+{
+  return !std::isnan(lhs) && (std::isnan(rhs) || lhs < rhs);
+}
+
+}  // namespace
+
+MzTolerance parseMzTolerance(std::string_view text)
+{
+  auto value = trim(text);
+  double number = 0;
+  auto [end, error] =
+      std::from_chars(value.data(), value.data() + value.size(), number);
+  if (error != std::errc() || !(number > 0) || !std::isfinite(number)) {
+    throw std::invalid_argument("Invalid m/z tolerance '" + std::string(text)
+                                + "'");
+  }
+
+  auto unit = trim({end, static_cast<std::size_t>(value.data() + value.size()
+                                                  - end)});
+  if (unit.empty() || equalsIgnoreCase(unit, "da")) {
+    return {number, ToleranceUnit::Dalton};
+  }
+  if (equalsIgnoreCase(unit, "ppm")) {
+    return MzTolerance::ppm(number);
+  }
+  throw std::invalid_argument("Unknown m/z tolerance unit '"
+                              + std::string(unit) + "', expected Da or ppm");
+}
+
+bool sortedByMz(std::span<const Spectrum::tMzValue> mzValues)
+{
+  if (!mzValues.empty() && std::isnan(mzValues.front())) {
+    return false;
+  }
+  for (std::size_t i = 1; i < mzValues.size(); ++i) {
+    if (!(mzValues[i] >= mzValues[i - 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void sortPeaks(std::span<Spectrum::tMzValue> mzValues,
+               std::span<Spectrum::tAbundanceValue> abundanceValues)
+{
+  if (mzValues.size() != abundanceValues.size()) {
+    throw std::invalid_argument("sortPeaks needs as many abundances as m/z");
+  }
+  if (std::is_sorted(mzValues.begin(), mzValues.end(), mzLess)) {
+    return;
+  }
+
+  std::vector<std::size_t> order(mzValues.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+  std::stable_sort(order.begin(),
+                   order.end(),
+                   [&](std::size_t a, std::size_t b)
+                   { return mzLess(mzValues[a], mzValues[b]); });
+
+  std::vector<Spectrum::tMzValue> mz(mzValues.begin(), mzValues.end());
+  std::vector<Spectrum::tAbundanceValue> abundance(abundanceValues.begin(),
+                                                   abundanceValues.end());
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    mzValues[i] = mz[order[i]];
+    abundanceValues[i] = abundance[order[i]];
+  }
+}
+
+std::size_t gallop(std::span<const Spectrum::tMzValue> values,
+                   std::size_t from,
+                   Spectrum::tMzValue target)
+{
+  std::size_t low = from;
+  std::size_t step = 1;
+  while (low < values.size() && values[low] < target) {
+    std::size_t probe = low + step;
+    if (probe >= values.size() || !(values[probe] < target)) {
+      auto last = std::min(probe, values.size());
+      return static_cast<std::size_t>(
+          std::lower_bound(values.begin() + static_cast<std::ptrdiff_t>(low),
+                           values.begin() + static_cast<std::ptrdiff_t>(last),
+                           target)
+          - values.begin());
+    }
+    low = probe + 1;
+    step *= 2;
+  }
+  return std::min(low, values.size());
+}
+
+}  // namespace LIB_NAMESPACE
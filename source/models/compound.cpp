@@ -3,19 +3,51 @@
 namespace LIB_NAMESPACE
 {
 
-Compound::Compound(tLibraryID libraryID, boost::property_tree::ptree tree)
-  : LibraryID(libraryID)
+Compound::Compound(const allocator_type& allocator)
+    : CASNumber(allocator)
+    , CompoundName(allocator)
+    , Formula(allocator)
+    , Spectra(allocator)
 {
-  CompoundID = tree.get<tCompoundID>("CompoundID", 0);
-  CASNumber = tree.get<std::string>("CASNumber", "");
-  CompoundName = tree.get<std::string>("CompoundName", "");
-  Formula = tree.get<std::string>("Formula", "");
-  BoilingPoint = tree.get<float>("BoilingPoint", 0.0f);
-  MeltingPoint = tree.get<float>("MeltingPoint", 0.0f);
-  MolecularWeight = tree.get<float>("MolecularWeight", 0.0f);
-  RetentionIndex = tree.get<float>("RetentionIndex", 0.0f);
-  RetentionTimeRTL = tree.get<float>("RetentionTimeRTL", 0.0f);
+}
+
+Compound::Compound(const Compound& other, const allocator_type& allocator)
+    : LibraryID(other.LibraryID)
+    , CompoundID(other.CompoundID)
+    , CASNumber(other.CASNumber, allocator)
+    , CompoundName(other.CompoundName, allocator)
+    , Formula(other.Formula, allocator)
+    , BoilingPoint(other.BoilingPoint)
+    , MeltingPoint(other.MeltingPoint)
+    , MolecularWeight(other.MolecularWeight)
+    , RetentionIndex(other.RetentionIndex)
+    , RetentionTimeRTL(other.RetentionTimeRTL)
+    , Spectra(other.Spectra, allocator)
+{
+}
 
+Compound::Compound(Compound&& other, const allocator_type& allocator)
+    : LibraryID(other.LibraryID)
+    , CompoundID(other.CompoundID)
+    , CASNumber(std::move(other.CASNumber), allocator)
+    , CompoundName(std::move(other.CompoundName), allocator)
+    , Formula(std::move(other.Formula), allocator)
+    , BoilingPoint(other.BoilingPoint)
+    , MeltingPoint(other.MeltingPoint)
+    , MolecularWeight(other.MolecularWeight)
+    , RetentionIndex(other.RetentionIndex)
+    , RetentionTimeRTL(other.RetentionTimeRTL)
+    , Spectra(std::move(other.Spectra), allocator)
+{
+}
+
+Compound::Compound(tLibraryID libraryID,
+                   const boost::property_tree::ptree& tree,
+                   const allocator_type& allocator)
+  : Compound(allocator)
+{
+  LibraryID = libraryID;
+  fields::read<kCompoundFields>(*this, tree);
 }
 
 }  // namespace LIB_NAMESPACE
@@ -1,35 +1,100 @@
+#include "io/library_reader.hpp"
+#include "io/numeric.hpp"
 #include "models/library.hpp"
 #include "models/compound.hpp"
 #include "models/spectrum.hpp"
+#include "profiling/stats.hpp"
 
 namespace LIB_NAMESPACE
 {
 
-  Library::Library(boost::property_tree::ptree tree) {
+  Library::Library(const boost::property_tree::ptree& tree) {
 
-    LibraryID = tree.get<tLibraryID>("LibraryDataSet.Library.LibraryID", NULL);
-    AccurateMass = tree.get<bool>("LibraryDataSet.Library.AccurateMass", false);
+    LibraryID = tree.get<tLibraryID>(
+        "LibraryDataSet.Library.LibraryID", 0, numeric::translator<tLibraryID>);
+    AccurateMass = tree.get("LibraryDataSet.Library.AccurateMass",
+                            false,
+                            numeric::translator<bool>);
 
     for (const auto& [field, subtree] : tree.get_child("LibraryDataSet")) {
 
       if (field == "Compound") {
-        Compound compound(LibraryID, subtree);
-        Compounds[compound.CompoundID] = compound;
+        insert(Compound(LibraryID, subtree));
 
       } else if (field == "Spectrum") {
-        auto spectrum = Spectrum(subtree);
+        insert(Spectrum(subtree));
 
-        if (Compounds.find(spectrum.CompoundID) != Compounds.end()) {
-          Compounds[spectrum.CompoundID].Spectra[spectrum.SpectrumID] =
-              spectrum;
-        } else {
-          throw std::runtime_error("Compound ID not found for Spectrum: "
-                                   + std::to_string(spectrum.CompoundID));
-        }
+      }
+    }
 
+  }
+
+  Library::Library(const allocator_type& allocator)
+      : Compounds(allocator) {
+  }
+
+  Library::Library(LibraryReader& reader,
+                   Projection projection,
+                   const allocator_type& allocator)
+      : Compounds(allocator) {
+
+    reader.requireRoot(kLibraryRoot);
+
+    // As with the ptree loader, the first <Library> names the library of
+    // every compound, including those that come before it.
+    bool haveLibrary = false;
+    bool deferred = false;
+    for (auto record = reader.next(); record != LibraryReader::Record::End;
+         record = reader.next())
+    {
+      switch (record) {
+        case LibraryReader::Record::Library:
+          if (!haveLibrary) {
+            LibraryID = reader.tree().get<tLibraryID>(
+                "LibraryID", 0, numeric::translator<tLibraryID>);
+            AccurateMass = reader.tree().get(
+                "AccurateMass", false, numeric::translator<bool>);
+            haveLibrary = true;
+          }
+          break;
+        case LibraryReader::Record::Compound:
+          insert(reader.compound(LibraryID, allocator));
+          deferred = deferred || !haveLibrary;
+          break;
+        case LibraryReader::Record::Spectrum:
+          insert(reader.spectrum(projection, allocator));
+          break;
+        default:
+          break;
       }
     }
 
+    if (deferred) {
+      for (auto& [id, compound] : Compounds) {
+        compound.LibraryID = LibraryID;
+      }
+    }
+
+  }
+
+  void Library::insert(Compound compound) {
+    LIB_STATS_ADD(Compounds, 1);
+    auto id = compound.CompoundID;
+    Compounds.insert_or_assign(id, std::move(compound));
+  }
+
+  void Library::insert(Spectrum spectrum) {
+    auto compound = Compounds.find(spectrum.CompoundID);
+
+    if (compound != Compounds.end()) {
+      LIB_STATS_ADD(Spectra, 1);
+      LIB_STATS_ADD(Peaks, spectrum.MzValues.peekSize());
+      auto id = spectrum.SpectrumID;
+      compound->second.Spectra.insert_or_assign(id, std::move(spectrum));
+    } else {
+      throw std::runtime_error("Compound ID not found for Spectrum: "
+                               + std::to_string(spectrum.CompoundID));
+    }
   }
 
 }
@@ -0,0 +1,24 @@
+#include "models/library_arena.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+LibraryArena::LibraryArena(std::size_t blockSize,
+                           std::pmr::memory_resource* upstream)
+    : std::pmr::monotonic_buffer_resource(blockSize, upstream)
+{
+}
+
+void LibraryArena::release()
+{
+  std::pmr::monotonic_buffer_resource::release();
+  m_used = 0;
+}
+
+void* LibraryArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  m_used += bytes;
+  return std::pmr::monotonic_buffer_resource::do_allocate(bytes, alignment);
+}
+
+}  // namespace LIB_NAMESPACE
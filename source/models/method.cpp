@@ -1,12 +1,42 @@
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
 #include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/xml_parser.hpp>
 
+#include "io/method_writer.hpp"
+#include "io/numeric.hpp"
 #include "models/method.hpp"
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
 
 namespace LIB_NAMESPACE
 {
 
+namespace
+{
+
+// ptree::put with numbers and flags formatted by numeric instead of a
+// stringstream.
+template<typename T>
+void putField(boost::property_tree::ptree& ptree,
+              const std::string& path,
+              const T& value)
+{
+  if constexpr (std::is_arithmetic_v<T>) {
+    ptree.put(path, value, numeric::translator<T>);
+  } else {
+    ptree.put(path, value);
+  }
+}
+
+}  // namespace
+
 Parameter::operator boost::property_tree::ptree() const
 {
   boost::property_tree::ptree ptree;
@@ -70,184 +100,273 @@ IntegrationParameters::ParameterSet_T::operator boost::property_tree::ptree()
   return ptree;
 }
 
-void EncodeParameterSet(const IntegrationParameters::ParameterSet_T& input,
-                        std::string& output)
+namespace
 {
-  boost::property_tree::ptree ptree = input;
 
-  std::ostringstream oss;
-  boost::property_tree::write_xml(
-      oss,
-      ptree,
-      boost::property_tree::xml_writer_make_settings<std::string>(' ', 4));
+void combine(std::size_t& seed, std::size_t hash)
+{
+  seed ^= hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
 
-  output = oss.str();
+void combine(std::size_t& seed, const std::string& value)
+{
+  combine(seed, std::hash<std::string>()(value));
 }
 
-TargetCompound::operator boost::property_tree::ptree() const
+void combine(std::size_t& seed, const std::optional<std::string>& value)
 {
-  boost::property_tree::ptree ptree;
+  combine(seed, value ? *value : std::string("\x01"));
+}
 
-  ptree.put("BatchID", BatchID);
-  ptree.put("SampleID", SampleID);
-  ptree.put("CompoundID", CompoundID);
-  ptree.put("AccuracyLimitMultiplierLOQ", AccuracyLimitMultiplierLOQ);
-  ptree.put("AccuracyMaximumPercentDeviation", AccuracyMaximumPercentDeviation);
-  ptree.put("CompoundName", CompoundName);
-  ptree.put("CompoundType", CompoundType);
-  ptree.put("ConcentrationUnits", ConcentrationUnits);
-  ptree.put("CurveFit", CurveFit);
-  ptree.put("CurveFitOrigin", CurveFitOrigin);
-  ptree.put("CurveFitWeight", CurveFitWeight);
-
-  std::string EncodedIntegrationParameters;
-  EncodeParameterSet(IntegrationParameters.ParameterSet,
-                     EncodedIntegrationParameters);
-  ptree.add("IntegrationParameters", EncodedIntegrationParameters);
-
-  ptree.put("IntegrationParametersModified", IntegrationParametersModified);
-  ptree.put("Integrator", Integrator);
-  ptree.put("IonPolarity", IonPolarity);
-  ptree.put("ISTDFlag", ISTDFlag);
-  ptree.put("LeftRetentionTimeDelta", LeftRetentionTimeDelta);
-  ptree.put("MaximumNumberOfHits", MaximumNumberOfHits);
-  ptree.put("Multiplier", Multiplier);
-  ptree.put("MZ", MZ);
-  ptree.put("MZExtractionWindowFilterLeft", MZExtractionWindowFilterLeft);
-  ptree.put("MZExtractionWindowFilterRight", MZExtractionWindowFilterRight);
-  ptree.put("MZExtractionWindowUnits", MZExtractionWindowUnits);
-  ptree.put("NoiseAlgorithmType", NoiseAlgorithmType);
-  ptree.put("NoiseOfRawSignal", NoiseOfRawSignal);
-  ptree.put("NoiseReference", NoiseReference);
-  ptree.put("NoiseStandardDeviationMultiplier",
-            NoiseStandardDeviationMultiplier);
-  ptree.put("PeakFilterThreshold", PeakFilterThreshold);
-  ptree.put("PeakFilterThresholdValue", PeakFilterThresholdValue);
-  ptree.put("PeakSelectionCriterion", PeakSelectionCriterion);
-  ptree.put("PrimaryHitPeakID", PrimaryHitPeakID);
-  ptree.put("QuantitateByHeight", QuantitateByHeight);
-  ptree.put("RetentionTime", RetentionTime);
-  ptree.put("RetentionTimeDeltaUnits", RetentionTimeDeltaUnits);
-  ptree.put("RetentionTimeWindow", RetentionTimeWindow);
-  ptree.put("RetentionTimeWindowUnits", RetentionTimeWindowUnits);
-  ptree.put("RightRetentionTimeDelta", RightRetentionTimeDelta);
-  ptree.put("ScanType", ScanType);
-  ptree.put("SelectedMZ", SelectedMZ);
-  ptree.put("SignalType", SignalType);
-  ptree.put("Smoothing", Smoothing);
-  ptree.put("SmoothingFunctionWidth", SmoothingFunctionWidth);
-  ptree.put("SmoothingGaussianWidth", SmoothingGaussianWidth);
-  ptree.put("SpectrumExtractionOverride", SpectrumExtractionOverride);
-  ptree.put("SpectrumScanInclusion", SpectrumScanInclusion);
-  ptree.put("ThresholdNumberOfPeaks", ThresholdNumberOfPeaks);
-  ptree.put("TimeReferenceFlag", TimeReferenceFlag);
-  ptree.put("TimeSegment", TimeSegment);
-  ptree.put("Transition", Transition);
-  ptree.put("UncertaintyRelativeOrAbsolute", UncertaintyRelativeOrAbsolute);
+std::size_t hashValue(const Parameter& parameter)
+{
+  std::size_t seed = 0;
+  combine(seed, parameter.attrs.id);
+  combine(seed, parameter.DisplayName);
+  combine(seed, parameter.Value);
+  combine(seed, parameter.Default);
+  if (parameter.Limits) {
+    combine(seed, parameter.Limits->Minimum.attr.type);
+    combine(seed, parameter.Limits->Minimum.value);
+    combine(seed, parameter.Limits->Maximum.attr.type);
+    combine(seed, parameter.Limits->Maximum.value);
+  }
+  combine(seed, parameter.XUnits);
+  combine(seed, parameter.DataValueType);
+  combine(seed, parameter.PrecisionType);
+  combine(seed, parameter.PrecisionDigits);
+  combine(seed, parameter.ConversionSupport);
+  return seed;
+}
 
-  return ptree;
+std::size_t hashValue(const IntegrationParameters::ParameterSet_T& input)
+{
+  std::size_t seed = 0;
+  combine(seed, input.attrs.usageKey);
+  combine(seed, input.attrs.assembly);
+  combine(seed, input.attrs.class_);
+  for (const Parameter* parameter : {&input.DataPointSampling,
+                                     &input.Smoothing,
+                                     &input.DetectionFiltering,
+                                     &input.StartThreshold,
+                                     &input.StopThreshold,
+                                     &input.PeakLocation,
+                                     &input.BaselineReset,
+                                     &input.BaselineValley,
+                                     &input.BaselinePreference})
+  {
+    combine(seed, hashValue(*parameter));
+  }
+  return seed;
+}
+
+}  // namespace
+
+ParameterSetCache& ParameterSetCache::instance()
+{
+  static ParameterSetCache cache;
+  return cache;
 }
 
-QuantitationDataSet::QuantitationDataSet(const Library& library)
-    : QuantitationDataSet()
+std::shared_ptr<const EncodedParameterSet> ParameterSetCache::intern(
+    const IntegrationParameters::ParameterSet_T& parameterSet)
 {
-  for (const auto& compound : library.Compounds) {
-    addTarget(compound.second);
+  std::size_t key = hashValue(parameterSet);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto [first, last] = m_entries.equal_range(key);
+    for (auto it = first; it != last; ++it) {
+      if (it->second->ParameterSet == parameterSet) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return it->second;
+      }
+    }
   }
+
+  // Encode outside the lock; a racing thread may encode the same set too,
+  // in which case the first one to insert wins.
+  auto encoded = std::make_shared<const EncodedParameterSet>(
+      EncodedParameterSet {parameterSet, encodeParameterSet(parameterSet)});
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto [first, last] = m_entries.equal_range(key);
+  for (auto it = first; it != last; ++it) {
+    if (it->second->ParameterSet == parameterSet) {
+      m_hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second;
+    }
+  }
+  m_misses.fetch_add(1, std::memory_order_relaxed);
+  m_entries.emplace(key, encoded);
+  return encoded;
 }
 
-void QuantitationDataSet::addTarget(const Compound& compound) {
+double ParameterSetCache::hitRate() const
+{
+  auto hits = this->hits();
+  auto lookups = hits + misses();
+  return lookups == 0 ? 0.0
+                      : static_cast<double>(hits) / static_cast<double>(lookups);
+}
+
+std::size_t ParameterSetCache::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+void ParameterSetCache::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_entries.clear();
+  m_hits.store(0, std::memory_order_relaxed);
+  m_misses.store(0, std::memory_order_relaxed);
+}
+
+namespace
+{
+
+std::shared_ptr<const SharedTargetSettings> share(TargetSettings values)
+{
+  auto encoded = ParameterSetCache::instance().intern(
+      values.IntegrationParameters.ParameterSet);
+  return std::make_shared<const SharedTargetSettings>(
+      SharedTargetSettings {std::move(values), std::move(encoded)});
+}
+
+}  // namespace
+
+std::shared_ptr<const SharedTargetSettings> SharedTargetSettings::make(
+    TargetSettings values)
+{
+  const auto& shared = defaults();
+  if (values == shared->Values) {
+    return shared;
+  }
+  return share(std::move(values));
+}
+
+const std::shared_ptr<const SharedTargetSettings>&
+SharedTargetSettings::defaults()
+{
+  static const std::shared_ptr<const SharedTargetSettings> shared =
+      share(TargetSettings {});
+  return shared;
+}
+
+TargetCompound::operator boost::property_tree::ptree() const
+{
+  boost::property_tree::ptree ptree;
+  fields::forEach(
+      kTargetCompoundFields,
+      [&](const auto& field)
+      { putField(ptree, std::string(field.Name), value(field.Member)); });
+
+  return ptree;
+}
+
+namespace
+{
+
+TargetCompound makeTarget(const Compound& compound)
+{
   if (compound.Spectra.empty()) {
-    throw;
+    throw std::runtime_error("Compound "
+                             + std::to_string(compound.CompoundID)
+                             + " has no spectra");
   }
 
   TargetCompound target = {
       .CompoundID = compound.CompoundID,
-      .CompoundName = compound.CompoundName,
+      .CompoundName = std::string(compound.CompoundName),
       .MZ = compound.Spectra.begin()->second.BasePeakMZ,
       .RetentionTime = compound.RetentionTimeRTL,
       .Transition = compound.Spectra.begin()->second.BasePeakMZ,
   };
 
-  Targets.push_back(target);
+  return target;
+}
+
+}  // namespace
+
+QuantitationDataSet::QuantitationDataSet(const allocator_type& allocator)
+    : Targets(allocator)
+{
+}
+
+QuantitationDataSet::QuantitationDataSet(const Library& library,
+                                         unsigned threads,
+                                         const allocator_type& allocator)
+    : QuantitationDataSet(allocator)
+{
+  LIB_STATS_SCOPE(Build);
+  LIB_TRACE_SCOPE("build targets");
+  if (threads <= 1) {
+    for (const auto& compound : library.Compounds) {
+      addTarget(compound.second);
+    }
+    return;
+  }
+
+  std::vector<const Compound*> compounds;
+  compounds.reserve(library.Compounds.size());
+  for (const auto& compound : library.Compounds) {
+    compounds.push_back(&compound.second);
+  }
+
+  const WorkStealingPool pool(threads);
+  std::vector<std::uint64_t> weights(compounds.size(), 1);
+  const auto batches = partitionByWeight(weights, pool.threads());
+  std::vector<std::vector<TargetCompound>> parts(batches.size() - 1);
+
+  pool.run(parts.size(),
+           [&](std::size_t batch, unsigned)
+           {
+             LIB_TRACE_SCOPE("build batch", "batch", batch);
+             parts[batch].reserve(batches[batch + 1] - batches[batch]);
+             for (auto i = batches[batch]; i < batches[batch + 1]; ++i) {
+               parts[batch].push_back(makeTarget(*compounds[i]));
+             }
+           });
+
+  Targets.reserve(compounds.size());
+  for (auto& part : parts) {
+    std::move(part.begin(), part.end(), std::back_inserter(Targets));
+  }
+}
+
+QuantitationDataSet& QuantitationDataSet::operator=(QuantitationDataSet&& other)
+{
+  attr = std::move(other.attr);
+  if (Targets.get_allocator() == other.Targets.get_allocator()) {
+    Targets.swap(other.Targets);
+    other.Targets.clear();
+  } else {
+    Targets.clear();
+    Targets.reserve(other.Targets.size());
+    for (auto& target : other.Targets) {
+      Targets.push_back(std::move(target));
+    }
+  }
+  return *this;
+}
+
+void QuantitationDataSet::addTarget(const Compound& compound) {
+  Targets.push_back(makeTarget(compound));
 }
 
 QuantitationDataSet::operator boost::property_tree::ptree() const {
   boost::property_tree::ptree ptree;
 
-  ptree.put("QuantitationDataSet.<xmlattr>.SchemaVersion", attr.SchemaVersion);
-  ptree.put("QuantitationDataSet.<xmlattr>.DataVersion", attr.DataVersion);
-  ptree.put("QuantitationDataSet.<xmlattr>.BatchState", attr.BatchState);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReferenceWindow",
-            attr.ReferenceWindow);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReferenceWindowPercentOrMinutes",
-            attr.ReferenceWindowPercentOrMinutes);
-  ptree.put("QuantitationDataSet.<xmlattr>.NonReferenceWindow",
-            attr.NonReferenceWindow);
-  ptree.put("QuantitationDataSet.<xmlattr>.NonReferenceWindowPercentOrMinutes",
-            attr.NonReferenceWindowPercentOrMinutes);
-  ptree.put("QuantitationDataSet.<xmlattr>.CorrelationWindow",
-            attr.CorrelationWindow);
-  ptree.put("QuantitationDataSet.<xmlattr>.ApplyMultiplierTarget",
-            attr.ApplyMultiplierTarget);
-  ptree.put("QuantitationDataSet.<xmlattr>.ApplyMultiplierSurrogate",
-            attr.ApplyMultiplierSurrogate);
-  ptree.put("QuantitationDataSet.<xmlattr>.ApplyMultiplierMatrixSpike",
-            attr.ApplyMultiplierMatrixSpike);
-  ptree.put("QuantitationDataSet.<xmlattr>.ApplyMultiplierISTD",
-            attr.ApplyMultiplierISTD);
-  ptree.put("QuantitationDataSet.<xmlattr>.IgnorePeaksNotFound",
-            attr.IgnorePeaksNotFound);
-  ptree.put("QuantitationDataSet.<xmlattr>.RelativeISTD", attr.RelativeISTD);
-  ptree.put("QuantitationDataSet.<xmlattr>.AuditTrail", attr.AuditTrail);
-  ptree.put("QuantitationDataSet.<xmlattr>.LibraryPathFileName",
-            attr.LibraryPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.LibraryMethodPathFileName",
-            attr.LibraryMethodPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.RefLibraryPathFileName",
-            attr.RefLibraryPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.RefLibraryPatternPathFileName",
-            attr.RefLibraryPatternPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.CCMaximumElapsedTimeInHours",
-            attr.CCMaximumElapsedTimeInHours);
-  ptree.put("QuantitationDataSet.<xmlattr>.BracketingType",
-            attr.BracketingType);
-  ptree.put("QuantitationDataSet.<xmlattr>.StandardAddition",
-            attr.StandardAddition);
-  ptree.put("QuantitationDataSet.<xmlattr>.DynamicBackgroundSubtraction",
-            attr.DynamicBackgroundSubtraction);
-  ptree.put("QuantitationDataSet.<xmlattr>.BatchName", attr.BatchName);
-  ptree.put("QuantitationDataSet.<xmlattr>.BatchDataPathFileName",
-            attr.BatchDataPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.DAMethodPathFileNameOrigin",
-            attr.DAMethodPathFileNameOrigin);
-  ptree.put("QuantitationDataSet.<xmlattr>.AnalystName", attr.AnalystName);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReportGeneratorName",
-            attr.ReportGeneratorName);
-  ptree.put("QuantitationDataSet.<xmlattr>.AnalysisTimeStamp",
-            attr.AnalysisTimeStamp);
-  ptree.put("QuantitationDataSet.<xmlattr>.DAMethodLastAppliedTimeStamp",
-            attr.DAMethodLastAppliedTimeStamp);
-  ptree.put("QuantitationDataSet.<xmlattr>.CalibrationLastUpdatedTimeStamp",
-            attr.CalibrationLastUpdatedTimeStamp);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReportGenerationStartedTimeStamp",
-            attr.ReportGenerationStartedTimeStamp);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReportResultsDataPathFileName",
-            attr.ReportResultsDataPathFileName);
-  ptree.put("QuantitationDataSet.<xmlattr>.AnalyzeQuantVersion",
-            attr.AnalyzeQuantVersion);
-  ptree.put("QuantitationDataSet.<xmlattr>.ReportQuantVersion",
-            attr.ReportQuantVersion);
-  ptree.put("QuantitationDataSet.<xmlattr>.ComplianceName",
-            attr.ComplianceName);
-  ptree.put("QuantitationDataSet.<xmlattr>.ComplianceVersion",
-            attr.ComplianceVersion);
-  ptree.put("QuantitationDataSet.<xmlattr>.ComplianceServer",
-            attr.ComplianceServer);
-  ptree.put("QuantitationDataSet.<xmlattr>.FeatureDetection",
-            attr.FeatureDetection);
-  ptree.put("QuantitationDataSet.<xmlattr>.HashCode", attr.HashCode);
-  ptree.put("QuantitationDataSet.<xmlattr>.xmlns", attr.xmlns);
+  fields::forEach(
+      kQuantitationDataSetAttributeFields,
+      [&](const auto& field)
+      {
+        putField(ptree,
+                 "QuantitationDataSet.<xmlattr>." + std::string(field.Name),
+                 attr.*field.Member);
+      });
 
   for (const auto& target : Targets) {
     ptree.add_child("QuantitationDataSet.TargetCompound", target);
@@ -0,0 +1,198 @@
+#include <algorithm>
+
+#include "io/library_cache.hpp"
+#include "matching/mz_match.hpp"
+#include "models/spectral_store.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+SpectralStore::SpectralStore(const Library& library)
+    : LibraryID(library.LibraryID)
+    , AccurateMass(library.AccurateMass)
+{
+  LIB_STATS_SCOPE(Build);
+  LIB_TRACE_SCOPE("build store");
+  std::size_t spectra = 0;
+  std::size_t peaks = 0;
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    spectra += compound.Spectra.size();
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      peaks += std::min(spectrum.MzValues.size(),
+                        spectrum.AbundanceValues.size());
+    }
+  }
+  reserve(library.Compounds.size(), spectra, peaks);
+
+  // std::map iterates in key order, so the compound and spectrum columns come
+  // out sorted by ID without an extra pass.
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    addCompound({.LibraryID = compound.LibraryID,
+                 .CompoundID = compound.CompoundID,
+                 .CASNumber = compound.CASNumber,
+                 .CompoundName = compound.CompoundName,
+                 .Formula = compound.Formula,
+                 .BoilingPoint = compound.BoilingPoint,
+                 .MeltingPoint = compound.MeltingPoint,
+                 .MolecularWeight = compound.MolecularWeight,
+                 .RetentionIndex = compound.RetentionIndex,
+                 .RetentionTimeRTL = compound.RetentionTimeRTL,
+                 .Spectra = {}});
+
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      addSpectrum({.LibraryID = spectrum.LibraryID,
+                   .CompoundID = spectrum.CompoundID,
+                   .SpectrumID = spectrum.SpectrumID,
+                   .BasePeakMZ = spectrum.BasePeakMZ,
+                   .MzValues = spectrum.MzValues,
+                   .AbundanceValues = spectrum.AbundanceValues});
+    }
+  }
+}
+
+SpectralStore::SpectralStore(const MappedLibrary& library)
+    : LibraryID(library.libraryID())
+    , AccurateMass(library.accurateMass())
+{
+  LIB_STATS_SCOPE(Build);
+  LIB_TRACE_SCOPE("build store");
+  std::size_t peaks = 0;
+  for (const auto& spectrum : library.spectra()) {
+    peaks += std::min(spectrum.MzCount, spectrum.AbundanceCount);
+  }
+  // Nothing is inserted into a Library on this path, so count the load here.
+  LIB_STATS_ADD(Compounds, library.compounds().size());
+  LIB_STATS_ADD(Spectra, library.spectra().size());
+  LIB_STATS_ADD(Peaks, peaks);
+  reserve(library.compounds().size(), library.spectra().size(), peaks);
+
+  for (const auto& compound : library.compounds()) {
+    addCompound({.LibraryID = compound.LibraryID,
+                 .CompoundID = compound.CompoundID,
+                 .CASNumber = library.string(compound.CASNumber),
+                 .CompoundName = library.string(compound.CompoundName),
+                 .Formula = library.string(compound.Formula),
+                 .BoilingPoint = compound.BoilingPoint,
+                 .MeltingPoint = compound.MeltingPoint,
+                 .MolecularWeight = compound.MolecularWeight,
+                 .RetentionIndex = compound.RetentionIndex,
+                 .RetentionTimeRTL = compound.RetentionTimeRTL,
+                 .Spectra = {}});
+
+    for (const auto& spectrum : library.spectra(compound)) {
+      addSpectrum({.LibraryID = spectrum.LibraryID,
+                   .CompoundID = spectrum.CompoundID,
+                   .SpectrumID = spectrum.SpectrumID,
+                   .BasePeakMZ = spectrum.BasePeakMZ,
+                   .MzValues = library.mzValues(spectrum),
+                   .AbundanceValues = library.abundanceValues(spectrum)});
+    }
+  }
+}
+
+void SpectralStore::reserve(std::size_t compounds,
+                            std::size_t spectra,
+                            std::size_t peaks)
+{
+  CompoundLibraryIDs.reserve(compounds);
+  CompoundIDs.reserve(compounds);
+  CASNumbers.reserve(compounds);
+  CompoundNames.reserve(compounds);
+  Formulas.reserve(compounds);
+  BoilingPoints.reserve(compounds);
+  MeltingPoints.reserve(compounds);
+  MolecularWeights.reserve(compounds);
+  RetentionIndices.reserve(compounds);
+  RetentionTimesRTL.reserve(compounds);
+  SpectrumOffsets.reserve(compounds + 1);
+
+  SpectrumLibraryIDs.reserve(spectra);
+  SpectrumCompoundIDs.reserve(spectra);
+  SpectrumIDs.reserve(spectra);
+  BasePeakMZs.reserve(spectra);
+  PeakOffsets.reserve(spectra + 1);
+
+  MzValues.reserve(peaks);
+  AbundanceValues.reserve(peaks);
+}
+
+void SpectralStore::addCompound(const CompoundView& compound)
+{
+  CompoundLibraryIDs.push_back(compound.LibraryID);
+  CompoundIDs.push_back(compound.CompoundID);
+  CASNumbers.emplace_back(compound.CASNumber);
+  CompoundNames.emplace_back(compound.CompoundName);
+  Formulas.emplace_back(compound.Formula);
+  BoilingPoints.push_back(compound.BoilingPoint);
+  MeltingPoints.push_back(compound.MeltingPoint);
+  MolecularWeights.push_back(compound.MolecularWeight);
+  RetentionIndices.push_back(compound.RetentionIndex);
+  RetentionTimesRTL.push_back(compound.RetentionTimeRTL);
+  SpectrumOffsets.push_back(SpectrumOffsets.back());
+}
+
+// Appends to the compound added last.
+void SpectralStore::addSpectrum(const SpectrumView& spectrum)
+{
+  std::size_t peaks =
+      std::min(spectrum.MzValues.size(), spectrum.AbundanceValues.size());
+
+  SpectrumLibraryIDs.push_back(spectrum.LibraryID);
+  SpectrumCompoundIDs.push_back(spectrum.CompoundID);
+  SpectrumIDs.push_back(spectrum.SpectrumID);
+  BasePeakMZs.push_back(spectrum.BasePeakMZ);
+  MzValues.insert(MzValues.end(),
+                  spectrum.MzValues.begin(),
+                  spectrum.MzValues.begin() + static_cast<std::ptrdiff_t>(peaks));
+  AbundanceValues.insert(
+      AbundanceValues.end(),
+      spectrum.AbundanceValues.begin(),
+      spectrum.AbundanceValues.begin() + static_cast<std::ptrdiff_t>(peaks));
+  PeakOffsets.push_back(MzValues.size());
+  ++SpectrumOffsets.back();
+
+  auto first = static_cast<std::ptrdiff_t>(PeakOffsets[PeakOffsets.size() - 2]);
+  sortPeaks({MzValues.begin() + first, MzValues.end()},
+            {AbundanceValues.begin() + first, AbundanceValues.end()});
+}
+
+CompoundView SpectralStore::compound(std::size_t index) const
+{
+  return {.LibraryID = CompoundLibraryIDs[index],
+          .CompoundID = CompoundIDs[index],
+          .CASNumber = CASNumbers[index],
+          .CompoundName = CompoundNames[index],
+          .Formula = Formulas[index],
+          .BoilingPoint = BoilingPoints[index],
+          .MeltingPoint = MeltingPoints[index],
+          .MolecularWeight = MolecularWeights[index],
+          .RetentionIndex = RetentionIndices[index],
+          .RetentionTimeRTL = RetentionTimesRTL[index],
+          .Spectra = {this, SpectrumOffsets[index], SpectrumOffsets[index + 1]}};
+}
+
+SpectrumView SpectralStore::spectrum(std::size_t index) const
+{
+  std::size_t first = PeakOffsets[index];
+  std::size_t count = PeakOffsets[index + 1] - first;
+
+  return {.LibraryID = SpectrumLibraryIDs[index],
+          .CompoundID = SpectrumCompoundIDs[index],
+          .SpectrumID = SpectrumIDs[index],
+          .BasePeakMZ = BasePeakMZs[index],
+          .MzValues = {MzValues.data() + first, count},
+          .AbundanceValues = {AbundanceValues.data() + first, count}};
+}
+
+std::size_t SpectralStore::find(tCompoundID compoundID) const
+{
+  auto it = std::lower_bound(CompoundIDs.begin(), CompoundIDs.end(), compoundID);
+  if (it == CompoundIDs.end() || *it != compoundID) {
+    return compoundCount();
+  }
+  return static_cast<std::size_t>(it - CompoundIDs.begin());
+}
+
+}  // namespace LIB_NAMESPACE
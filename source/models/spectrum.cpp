@@ -1,45 +1,83 @@
 
 #include <iostream>
+#include <stdexcept>
 #include <string>
-
-#include "base64.hpp"
+#include <utility>
 
 #include "models/spectrum.hpp"
 
 namespace LIB_NAMESPACE
 {
 
-  namespace detail
-  {
-    template<typename T>
-    std::vector<T> decodeBase64Binary(std::string input)
-    {
-      std::string decoded = base64::decode(input);
-      std::vector<T> decoded_floats;
-      decoded_floats.reserve(decoded.size() / sizeof(T));
-
-      for (size_t i = 0; i + sizeof(T) <= decoded.size(); i += sizeof(T)) {
-        T value;
-        std::memcpy(&value, &decoded[i], sizeof(T));
-        decoded_floats.push_back(value);
-      }
-      return decoded_floats;
-    }
+namespace
+{
+
+// The column a projection asks for, which the record must have.
+const std::string& required(const std::string* column, const char* name)
+{
+  if (!column) {
+    throw std::runtime_error(std::string("Missing ") + name);
   }
+  return *column;
+}
+
+}  // namespace
+
+Spectrum::Spectrum(const allocator_type& allocator)
+    : MzValues(allocator)
+    , AbundanceValues(allocator)
+{
+}
 
-Spectrum::Spectrum(boost::property_tree::ptree tree)
+Spectrum::Spectrum(const Spectrum& other, const allocator_type& allocator)
+    : LibraryID(other.LibraryID)
+    , CompoundID(other.CompoundID)
+    , SpectrumID(other.SpectrumID)
+    , BasePeakMZ(other.BasePeakMZ)
+    , MzValues(other.MzValues, allocator)
+    , AbundanceValues(other.AbundanceValues, allocator)
 {
-  LibraryID = tree.get<tLibraryID>("LibraryID", 0);
-  CompoundID = tree.get<tCompoundID>("CompoundID", 0);
-  SpectrumID = tree.get<tSpectrumID>("SpectrumID", 0);
-  BasePeakMZ = tree.get<float>("BasePeakMZ", 0.0f);
+}
+
+Spectrum::Spectrum(Spectrum&& other, const allocator_type& allocator)
+    : LibraryID(other.LibraryID)
+    , CompoundID(other.CompoundID)
+    , SpectrumID(other.SpectrumID)
+    , BasePeakMZ(other.BasePeakMZ)
+    , MzValues(std::move(other.MzValues), allocator)
+    , AbundanceValues(std::move(other.AbundanceValues), allocator)
+{
+}
+
+Spectrum::Spectrum(const boost::property_tree::ptree& tree,
+                   Projection projection,
+                   const allocator_type& allocator)
+    : Spectrum(allocator)
+{
+  const std::string* mzValues = nullptr;
+  const std::string* abundanceValues = nullptr;
+  fields::read<kSpectrumFields>(
+      *this,
+      tree,
+      [&](std::string_view name, const boost::property_tree::ptree& child)
+      {
+        if (name == "MzValues" && !mzValues) {
+          mzValues = &child.data();
+        } else if (name == "AbundanceValues" && !abundanceValues) {
+          abundanceValues = &child.data();
+        }
+      });
 
   try {
-    MzValues =
-        detail::decodeBase64Binary<double>(tree.get<std::string>("MzValues"));
+    if (includes(projection, Projection::MzValues)) {
+      MzValues = LazyArray<tMzValue>::encoded(required(mzValues, "MzValues"),
+                                              allocator);
+    }
 
-    AbundanceValues = detail::decodeBase64Binary<double>(
-        tree.get<std::string>("AbundanceValues"));
+    if (includes(projection, Projection::AbundanceValues)) {
+      AbundanceValues = LazyArray<tAbundanceValue>::encoded(
+          required(abundanceValues, "AbundanceValues"), allocator);
+    }
   
   } catch (const std::exception&) {
     //throw std::runtime_error("Failed to decode MzValues or AbundanceValues: "
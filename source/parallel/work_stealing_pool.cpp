@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+struct TaskQueue
+{
+  std::mutex Mutex;
+  std::deque<std::size_t> Tasks;
+};
+
+}  // namespace
+
+unsigned resolveThreads(unsigned requested)
+{
+  if (requested != 0) {
+    return requested;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::vector<std::size_t> partitionByWeight(
+    std::span<const std::uint64_t> weights,
+    unsigned threads,
+    unsigned batchesPerThread)
+{
+  std::vector<std::size_t> bounds = {0};
+  if (weights.empty()) {
+    return bounds;
+  }
+
+  std::uint64_t total = std::accumulate(weights.begin(), weights.end(),
+                                        std::uint64_t(0));
+  std::uint64_t batches = std::uint64_t(std::max(1u, threads))
+      * std::max(1u, batchesPerThread);
+  std::uint64_t grain = std::max<std::uint64_t>(1, total / batches);
+
+  std::uint64_t weight = 0;
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    weight += weights[i];
+    if (weight >= grain) {
+      bounds.push_back(i + 1);
+      weight = 0;
+    }
+  }
+  if (bounds.back() != weights.size()) {
+    bounds.push_back(weights.size());
+  }
+  return bounds;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+    : m_threads(std::max(1u, threads))
+{
+}
+
+void WorkStealingPool::run(std::size_t tasks, const Task& task) const
+{
+  unsigned workers = static_cast<unsigned>(
+      std::min<std::size_t>(m_threads, std::max<std::size_t>(tasks, 1)));
+
+  if (workers == 1) {
+    for (std::size_t i = 0; i < tasks; ++i) {
+      task(i, 0);
+    }
+    return;
+  }
+
+  std::vector<TaskQueue> queues(workers);
+  for (std::size_t i = 0; i < tasks; ++i) {
+    queues[i % workers].Tasks.push_back(i);
+  }
+
+  std::atomic<bool> failed = false;
+  std::exception_ptr error;
+  std::mutex errorMutex;
+
+  auto take = [&](unsigned worker, std::size_t& next)
+  {
+    for (unsigned offset = 0; offset < workers; ++offset) {
+      auto& queue = queues[(worker + offset) % workers];
+      std::lock_guard<std::mutex> lock(queue.Mutex);
+      if (queue.Tasks.empty()) {
+        continue;
+      }
+      if (offset == 0) {
+        next = queue.Tasks.front();
+        queue.Tasks.pop_front();
+      } else {
+        next = queue.Tasks.back();
+        queue.Tasks.pop_back();
+      }
+      return true;
+    }
+    // No task is ever added after the start, so empty everywhere means done.
+    return false;
+  };
+
+  auto work = [&](unsigned worker)
+  {
+    std::size_t next = 0;
+    while (!failed.load(std::memory_order_relaxed) && take(worker, next)) {
+      try {
+        task(next, worker);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed.store(true, std::memory_order_relaxed);
+      }
+    }
+  };
+
+  {
+    std::vector<std::jthread> threads;
+    threads.reserve(workers - 1);
+    for (unsigned worker = 1; worker < workers; ++worker) {
+      threads.emplace_back(work, worker);
+    }
+    work(0);
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+OrderedWriter::OrderedWriter(std::ostream& output, std::size_t chunks)
+    : OrderedWriter(
+        [&output](std::string_view chunk)
+        {
+          LIB_STATS_SCOPE(Write);
+          LIB_TRACE_SCOPE("write", "bytes", chunk.size());
+          LIB_STATS_ADD(BytesWritten, chunk.size());
+          output.write(chunk.data(),
+                       static_cast<std::streamsize>(chunk.size()));
+          if (!output) {
+            throw std::runtime_error("Failed to write output");
+          }
+        },
+        chunks)
+{
+}
+
+OrderedWriter::OrderedWriter(Sink sink, std::size_t chunks)
+    : m_sink(std::move(sink))
+    , m_chunks(chunks)
+    , m_ready(chunks, false)
+{
+}
+
+void OrderedWriter::write(std::size_t index, std::string chunk)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  if (index >= m_chunks.size() || m_ready[index]) {
+    throw std::logic_error("OrderedWriter chunk written twice or out of range");
+  }
+
+  m_chunks[index] = std::move(chunk);
+  m_ready[index] = true;
+  if (m_writing) {
+    // The thread already writing picks the chunk up when it is due.
+    return;
+  }
+
+  // Take the due chunks and write them with the lock released, so the other
+  // threads can keep handing in chunks meanwhile. A sink that throws leaves
+  // m_writing set, so nothing after the lost chunks is ever written.
+  m_writing = true;
+  std::vector<std::string> due;
+  for (;;) {
+    while (m_next < m_chunks.size() && m_ready[m_next]) {
+      due.push_back(std::move(m_chunks[m_next]));
+      ++m_next;
+    }
+    if (due.empty()) {
+      break;
+    }
+
+    lock.unlock();
+    for (const auto& text : due) {
+      m_sink(text);
+    }
+    lock.lock();
+    m_written += due.size();
+    due.clear();
+  }
+  m_writing = false;
+}
+
+std::size_t OrderedWriter::written() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_written;
+}
+
+}  // namespace LIB_NAMESPACE
@@ -0,0 +1,204 @@
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "profiling/allocation.hpp"
+
+namespace LIB_NAMESPACE::allocation
+{
+
+namespace
+{
+
+struct Registry
+{
+  std::atomic<bool> Enabled {false};
+  TrackingResource Total;
+  std::array<TrackingResource, kSubsystems> Subsystems {
+      TrackingResource(std::pmr::new_delete_resource(), &Total),
+      TrackingResource(std::pmr::new_delete_resource(), &Total),
+      TrackingResource(std::pmr::new_delete_resource(), &Total)};
+};
+
+Registry& registry()
+{
+  static Registry registry;
+  return registry;
+}
+
+void row(std::ostream& output, const char* label, const Usage& usage)
+{
+  output << std::left << std::setw(12) << label << std::right
+         << std::setw(14) << usage.Bytes << std::setw(14) << usage.PeakBytes
+         << std::setw(14) << usage.TotalBytes << std::setw(12)
+         << usage.Allocations << std::setw(12) << usage.Deallocations << "\n";
+}
+
+void object(std::ostream& output, const Usage& usage)
+{
+  output << "{\"bytes\": " << usage.Bytes
+         << ", \"peak_bytes\": " << usage.PeakBytes
+         << ", \"total_bytes\": " << usage.TotalBytes
+         << ", \"allocations\": " << usage.Allocations
+         << ", \"deallocations\": " << usage.Deallocations << "}";
+}
+
+}  // namespace
+
+const char* name(Subsystem subsystem)
+{
+  static constexpr const char* kNames[] = {"library", "queries", "method"};
+  return kNames[static_cast<std::size_t>(subsystem)];
+}
+
+TrackingResource::TrackingResource(std::pmr::memory_resource* upstream,
+                                   TrackingResource* parent)
+    : m_upstream(upstream)
+    , m_parent(parent)
+{
+}
+
+Usage TrackingResource::usage() const
+{
+  return {m_bytes.load(std::memory_order_relaxed),
+          m_peak.load(std::memory_order_relaxed),
+          m_total.load(std::memory_order_relaxed),
+          m_allocations.load(std::memory_order_relaxed),
+          m_deallocations.load(std::memory_order_relaxed)};
+}
+
+void TrackingResource::reset()
+{
+  m_peak.store(m_bytes.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+  m_total.store(0, std::memory_order_relaxed);
+  m_allocations.store(0, std::memory_order_relaxed);
+  m_deallocations.store(0, std::memory_order_relaxed);
+}
+
+void* TrackingResource::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+  void* pointer = m_upstream->allocate(bytes, alignment);
+  allocated(bytes);
+  return pointer;
+}
+
+void TrackingResource::do_deallocate(void* pointer,
+                                     std::size_t bytes,
+                                     std::size_t alignment)
+{
+  m_upstream->deallocate(pointer, bytes, alignment);
+  deallocated(bytes);
+}
+
+bool TrackingResource::do_is_equal(
+    const std::pmr::memory_resource& other) const noexcept
+{
+  return this == &other;
+}
+
+void TrackingResource::allocated(std::uint64_t bytes)
+{
+  auto live = m_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  auto peak = m_peak.load(std::memory_order_relaxed);
+  while (live > peak
+         && !m_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+  {
+  }
+  m_total.fetch_add(bytes, std::memory_order_relaxed);
+  m_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (m_parent) {
+    m_parent->allocated(bytes);
+  }
+}
+
+void TrackingResource::deallocated(std::uint64_t bytes)
+{
+  m_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+  m_deallocations.fetch_add(1, std::memory_order_relaxed);
+  if (m_parent) {
+    m_parent->deallocated(bytes);
+  }
+}
+
+void enable()
+{
+  auto& tracking = registry();
+  tracking.Total.reset();
+  for (auto& subsystem : tracking.Subsystems) {
+    subsystem.reset();
+  }
+  tracking.Enabled.store(true, std::memory_order_release);
+}
+
+void disable()
+{
+  registry().Enabled.store(false, std::memory_order_release);
+}
+
+bool enabled()
+{
+  return registry().Enabled.load(std::memory_order_acquire);
+}
+
+std::pmr::memory_resource* resource(Subsystem subsystem)
+{
+  if (!enabled()) {
+    return std::pmr::get_default_resource();
+  }
+  return &registry().Subsystems[static_cast<std::size_t>(subsystem)];
+}
+
+Snapshot snapshot()
+{
+  const auto& tracking = registry();
+  Snapshot snapshot;
+  for (std::size_t s = 0; s < kSubsystems; ++s) {
+    snapshot.Subsystems[s] = tracking.Subsystems[s].usage();
+  }
+  snapshot.Total = tracking.Total.usage();
+  return snapshot;
+}
+
+void report(const Snapshot& snapshot, std::ostream& output)
+{
+  auto flags = output.flags();
+
+  output << std::left << std::setw(12) << "subsystem" << std::right
+         << std::setw(14) << "live bytes" << std::setw(14) << "peak bytes"
+         << std::setw(14) << "total bytes" << std::setw(12) << "allocs"
+         << std::setw(12) << "frees" << "\n";
+  for (std::size_t s = 0; s < kSubsystems; ++s) {
+    row(output, name(static_cast<Subsystem>(s)), snapshot.Subsystems[s]);
+  }
+  row(output, "total", snapshot.Total);
+
+  output.flags(flags);
+}
+
+void writeJson(const Snapshot& snapshot, std::ostream& output)
+{
+  output << "{\n  \"subsystems\": {";
+  for (std::size_t s = 0; s < kSubsystems; ++s) {
+    output << (s ? ",\n" : "\n") << "    \""
+           << name(static_cast<Subsystem>(s)) << "\": ";
+    object(output, snapshot.Subsystems[s]);
+  }
+  output << "\n  },\n  \"total\": ";
+  object(output, snapshot.Total);
+  output << "\n}\n";
+}
+
+void writeJson(const Snapshot& snapshot, const std::string& path)
+{
+  std::ofstream output(path, std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open allocation stats file: " + path);
+  }
+  writeJson(snapshot, output);
+  if (!output) {
+    throw std::runtime_error("Failed to write allocation stats file: " + path);
+  }
+}
+
+}  // namespace LIB_NAMESPACE::allocation
@@ -0,0 +1,52 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "profiling/heap_counter.hpp"
+
+namespace
+{
+
+std::atomic<std::uint64_t> g_allocations = 0;
+
+}  // namespace
+
+namespace LIB_NAMESPACE::allocation
+{
+
+std::uint64_t heapAllocations()
+{
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+}  // namespace LIB_NAMESPACE::allocation
+
+// GCC pairs the inlined free() below with operator new at call sites and
+// cannot see that the replacement new allocates with malloc.
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* pointer = std::malloc(size ? size : 1)) {
+    return pointer;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+  std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+  std::free(pointer);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic pop
+#endif
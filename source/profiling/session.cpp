@@ -0,0 +1,97 @@
+#include <exception>
+#include <iostream>
+
+#include <boost/program_options/value_semantic.hpp>
+
+#include "profiling/session.hpp"
+#include "profiling/stats.hpp"
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE::profiling
+{
+
+void addOptions(boost::program_options::options_description& desc,
+                Options& options)
+{
+  desc.add_options()(
+      "arena",
+      boost::program_options::bool_switch(&options.Arena),
+      "build the library in one arena, freed in a single release")(
+      "stats",
+      boost::program_options::bool_switch(&options.Stats),
+      "print phase timings and counts to stderr")(
+      "stats-json",
+      boost::program_options::value<std::string>(&options.StatsJson),
+      "write phase timings and counts as JSON to this file")(
+      "alloc-stats",
+      boost::program_options::bool_switch(&options.AllocStats),
+      "print memory use per subsystem to stderr")(
+      "alloc-stats-json",
+      boost::program_options::value<std::string>(&options.AllocStatsJson),
+      "write memory use per subsystem as JSON to this file")(
+      "trace",
+      boost::program_options::value<std::string>(&options.TraceFile),
+      "write a Chrome trace of the run to this file");
+}
+
+Session::Session(const Options& options)
+    : m_options(options)
+{
+  if (m_options.Stats || !m_options.StatsJson.empty()) {
+    stats::enable();
+  }
+  if (m_options.AllocStats || !m_options.AllocStatsJson.empty()) {
+    allocation::enable();
+  }
+  if (!m_options.TraceFile.empty()) {
+    trace::enable();
+  }
+}
+
+std::pmr::memory_resource* Session::resource(allocation::Subsystem subsystem)
+{
+  auto* upstream = allocation::resource(subsystem);
+  if (!m_options.Arena) {
+    return upstream;
+  }
+  return &m_arenas.emplace_back(LibraryArena::kDefaultBlockSize, upstream);
+}
+
+void Session::releaseArenas()
+{
+  for (auto& arena : m_arenas) {
+    arena.release();
+  }
+}
+
+bool Session::finish() const
+{
+  // Reports go out in this order; the first that fails ends the run.
+  try {
+    auto snapshot = stats::snapshot();
+    if (m_options.Stats) {
+      stats::report(snapshot, std::cerr);
+    }
+    if (!m_options.StatsJson.empty()) {
+      stats::writeJson(snapshot, m_options.StatsJson);
+    }
+
+    auto memory = allocation::snapshot();
+    if (m_options.AllocStats) {
+      allocation::report(memory, std::cerr);
+    }
+    if (!m_options.AllocStatsJson.empty()) {
+      allocation::writeJson(memory, m_options.AllocStatsJson);
+    }
+
+    if (!m_options.TraceFile.empty()) {
+      trace::writeJson(m_options.TraceFile);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+}  // namespace LIB_NAMESPACE::profiling
@@ -0,0 +1,215 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "profiling/stats.hpp"
+
+namespace LIB_NAMESPACE::stats
+{
+
+namespace
+{
+
+thread_local ScopedTimer* t_current = nullptr;
+
+std::int64_t now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// The counter a phase's throughput is measured in.
+Counter unitOf(Phase phase)
+{
+  switch (phase) {
+    case Phase::Read:
+      return Counter::BytesRead;
+    case Phase::Decode:
+      return Counter::Peaks;
+    case Phase::Write:
+      return Counter::BytesWritten;
+    default:
+      return Counter::Compounds;
+  }
+}
+
+bool inBytes(Phase phase)
+{
+  return unitOf(phase) == Counter::BytesRead
+      || unitOf(phase) == Counter::BytesWritten;
+}
+
+double throughput(const Snapshot& snapshot, Phase phase)
+{
+  const auto& sample = snapshot[phase];
+  if (!(sample.Seconds > 0)) {
+    return 0;
+  }
+  double amount = static_cast<double>(snapshot[unitOf(phase)]);
+  return (inBytes(phase) ? amount / 1e6 : amount) / sample.Seconds;
+}
+
+}  // namespace
+
+const char* name(Phase phase)
+{
+  static constexpr const char* kNames[] = {
+      "read", "decode", "build", "transform", "write"};
+  return kNames[static_cast<std::size_t>(phase)];
+}
+
+const char* name(Counter counter)
+{
+  static constexpr const char* kNames[] = {"compounds",
+                                           "spectra",
+                                           "peaks",
+                                           "decode_failures",
+                                           "bytes_read",
+                                           "bytes_written"};
+  return kNames[static_cast<std::size_t>(counter)];
+}
+
+void enable()
+{
+  auto& registry = detail::g_registry;
+  for (std::size_t p = 0; p < kPhases; ++p) {
+    registry.Nanoseconds[p].store(0, std::memory_order_relaxed);
+    registry.Calls[p].store(0, std::memory_order_relaxed);
+  }
+  for (auto& counter : registry.Counters) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+  registry.Start.store(now(), std::memory_order_relaxed);
+  registry.Enabled.store(true, std::memory_order_release);
+}
+
+void disable()
+{
+  detail::g_registry.Enabled.store(false, std::memory_order_release);
+}
+
+void ScopedTimer::begin(Phase phase)
+{
+  auto time = now();
+  m_phase = phase;
+  m_active = true;
+  m_parent = t_current;
+  if (m_parent) {
+    m_parent->m_elapsed += time - m_parent->m_start;
+  }
+  m_start = time;
+  t_current = this;
+}
+
+void ScopedTimer::end()
+{
+  auto time = now();
+  m_elapsed += time - m_start;
+
+  auto index = static_cast<std::size_t>(m_phase);
+  detail::g_registry.Nanoseconds[index].fetch_add(
+      static_cast<std::uint64_t>(m_elapsed), std::memory_order_relaxed);
+  detail::g_registry.Calls[index].fetch_add(1, std::memory_order_relaxed);
+
+  t_current = m_parent;
+  if (m_parent) {
+    m_parent->m_start = time;
+  }
+}
+
+Snapshot snapshot()
+{
+  const auto& registry = detail::g_registry;
+  Snapshot snapshot;
+  snapshot.WallSeconds =
+      static_cast<double>(now() - registry.Start.load(std::memory_order_relaxed))
+      / 1e9;
+  for (std::size_t p = 0; p < kPhases; ++p) {
+    snapshot.Phases[p].Seconds =
+        static_cast<double>(
+            registry.Nanoseconds[p].load(std::memory_order_relaxed))
+        / 1e9;
+    snapshot.Phases[p].Calls = registry.Calls[p].load(std::memory_order_relaxed);
+  }
+  for (std::size_t c = 0; c < kCounters; ++c) {
+    snapshot.Counters[c] = registry.Counters[c].load(std::memory_order_relaxed);
+  }
+  return snapshot;
+}
+
+void report(const Snapshot& snapshot, std::ostream& output)
+{
+  auto flags = output.flags();
+  auto precision = output.precision();
+
+#if !LIB_STATS
+  output << "statistics were compiled out (LIB_STATS=0)\n";
+#endif
+  output << std::fixed << std::setprecision(3) << "wall time "
+         << snapshot.WallSeconds << " s\n";
+  output << std::left << std::setw(12) << "phase" << std::right
+         << std::setw(12) << "seconds" << std::setw(10) << "calls"
+         << std::setw(18) << "throughput" << "\n";
+  for (std::size_t p = 0; p < kPhases; ++p) {
+    auto phase = static_cast<Phase>(p);
+    const auto& sample = snapshot[phase];
+    output << std::left << std::setw(12) << name(phase) << std::right
+           << std::setw(12) << std::setprecision(3) << sample.Seconds
+           << std::setw(10) << sample.Calls << std::setw(12)
+           << std::setprecision(1) << throughput(snapshot, phase) << " "
+           << (inBytes(phase) ? "MB/s"
+                   : phase == Phase::Decode ? "pk/s"
+                                            : "cp/s")
+           << "\n";
+  }
+  for (std::size_t c = 0; c < kCounters; ++c) {
+    output << std::left << std::setw(16) << name(static_cast<Counter>(c))
+           << std::right << snapshot.Counters[c] << "\n";
+  }
+
+  output.flags(flags);
+  output.precision(precision);
+}
+
+void writeJson(const Snapshot& snapshot, std::ostream& output)
+{
+  auto precision = output.precision();
+  output << std::setprecision(9);
+
+  output << "{\n  \"wall_seconds\": " << snapshot.WallSeconds
+         << ",\n  \"phases\": {";
+  for (std::size_t p = 0; p < kPhases; ++p) {
+    auto phase = static_cast<Phase>(p);
+    output << (p ? ",\n" : "\n") << "    \"" << name(phase)
+           << "\": {\"seconds\": " << snapshot[phase].Seconds
+           << ", \"calls\": " << snapshot[phase].Calls << ", \""
+           << (inBytes(phase) ? "megabytes"
+                   : phase == Phase::Decode ? "peaks"
+                                            : "compounds")
+           << "_per_second\": " << throughput(snapshot, phase) << "}";
+  }
+  output << "\n  },\n  \"counters\": {";
+  for (std::size_t c = 0; c < kCounters; ++c) {
+    output << (c ? ",\n" : "\n") << "    \"" << name(static_cast<Counter>(c))
+           << "\": " << snapshot.Counters[c];
+  }
+  output << "\n  }\n}\n";
+
+  output.precision(precision);
+}
+
+void writeJson(const Snapshot& snapshot, const std::string& path)
+{
+  std::ofstream output(path, std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open stats file: " + path);
+  }
+  writeJson(snapshot, output);
+  if (!output) {
+    throw std::runtime_error("Failed to write stats file: " + path);
+  }
+}
+
+}  // namespace LIB_NAMESPACE::stats
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+#include "profiling/trace.hpp"
+
+namespace LIB_NAMESPACE::trace
+{
+
+namespace
+{
+
+// One thread's ring. Only its current owner writes Events and Written; a
+// reader takes Written with acquire and sees the events before it.
+struct Buffer
+{
+  explicit Buffer(std::size_t capacity)
+      : Events(capacity)
+  {
+  }
+
+  std::vector<Event> Events;
+  std::atomic<std::uint64_t> Written {0};
+  std::atomic<bool> InUse {true};
+  Buffer* Next = nullptr;
+};
+
+// Buffers are pushed onto this list and never freed, so events survive the
+// threads that recorded them.
+std::atomic<Buffer*> g_buffers {nullptr};
+std::atomic<std::size_t> g_capacity {kDefaultCapacity};
+std::atomic<std::int64_t> g_start {0};
+std::atomic<std::uint32_t> g_threads {0};
+
+std::int64_t ticks()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+Buffer* acquire()
+{
+  auto capacity = g_capacity.load(std::memory_order_relaxed);
+  for (auto* buffer = g_buffers.load(std::memory_order_acquire); buffer;
+       buffer = buffer->Next)
+  {
+    bool inUse = false;
+    if (buffer->Events.size() == capacity
+        && buffer->InUse.compare_exchange_strong(
+            inUse, true, std::memory_order_acquire))
+    {
+      return buffer;
+    }
+  }
+
+  auto* buffer = new Buffer(capacity);
+  buffer->Next = g_buffers.load(std::memory_order_relaxed);
+  while (!g_buffers.compare_exchange_weak(buffer->Next,
+                                          buffer,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+  {
+  }
+  return buffer;
+}
+
+// The calling thread's buffer, taken on its first span and handed back
+// when the thread exits.
+struct Lease
+{
+  Lease() = default;
+  Lease(const Lease&) = delete;
+  Lease& operator=(const Lease&) = delete;
+
+  ~Lease()
+  {
+    if (Ring) {
+      Ring->InUse.store(false, std::memory_order_release);
+    }
+  }
+
+  Buffer* Ring = nullptr;
+  std::uint32_t Thread = 0;
+};
+
+thread_local Lease t_lease;
+
+void writeTime(std::ostream& output, std::int64_t nanoseconds)
+{
+  // Microseconds, as the format expects.
+  output << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0')
+         << nanoseconds % 1000 << std::setfill(' ');
+}
+
+}  // namespace
+
+void enable(std::size_t capacity)
+{
+  if (capacity == 0) {
+    throw std::invalid_argument("Trace capacity must be positive");
+  }
+  g_capacity.store(capacity, std::memory_order_relaxed);
+  for (auto* buffer = g_buffers.load(std::memory_order_acquire); buffer;
+       buffer = buffer->Next)
+  {
+    buffer->Written.store(0, std::memory_order_relaxed);
+  }
+  g_start.store(ticks(), std::memory_order_relaxed);
+  detail::g_enabled.store(true, std::memory_order_release);
+}
+
+void disable()
+{
+  detail::g_enabled.store(false, std::memory_order_release);
+}
+
+std::int64_t now()
+{
+  return ticks() - g_start.load(std::memory_order_relaxed);
+}
+
+void record(const Event& event)
+{
+  auto& lease = t_lease;
+  if (!lease.Ring) {
+    lease.Ring = acquire();
+    lease.Thread = g_threads.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto* buffer = lease.Ring;
+  auto written = buffer->Written.load(std::memory_order_relaxed);
+  auto& slot = buffer->Events[written % buffer->Events.size()];
+  slot = event;
+  slot.Thread = lease.Thread;
+  buffer->Written.store(written + 1, std::memory_order_release);
+}
+
+std::vector<Event> events()
+{
+  std::vector<Event> result;
+  for (auto* buffer = g_buffers.load(std::memory_order_acquire); buffer;
+       buffer = buffer->Next)
+  {
+    auto written = buffer->Written.load(std::memory_order_acquire);
+    auto capacity = buffer->Events.size();
+    auto kept = std::min<std::uint64_t>(written, capacity);
+    for (auto i = written - kept; i < written; ++i) {
+      result.push_back(buffer->Events[i % capacity]);
+    }
+  }
+  std::stable_sort(result.begin(),
+                   result.end(),
+                   [](const Event& a, const Event& b)
+                   { return a.Begin < b.Begin; });
+  return result;
+}
+
+std::uint64_t dropped()
+{
+  std::uint64_t count = 0;
+  for (auto* buffer = g_buffers.load(std::memory_order_acquire); buffer;
+       buffer = buffer->Next)
+  {
+    auto written = buffer->Written.load(std::memory_order_acquire);
+    count += written - std::min<std::uint64_t>(written, buffer->Events.size());
+  }
+  return count;
+}
+
+void writeJson(std::ostream& output)
+{
+  auto trace = events();
+
+  output << "{\"traceEvents\": [";
+  for (std::size_t i = 0; i < trace.size(); ++i) {
+    const auto& event = trace[i];
+    output << (i ? ",\n" : "\n") << "{\"name\": \"" << event.Name
+           << "\", \"cat\": \"mhltq\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+           << event.Thread << ", \"ts\": ";
+    writeTime(output, event.Begin);
+    output << ", \"dur\": ";
+    writeTime(output, event.End - event.Begin);
+    if (event.ArgName) {
+      output << ", \"args\": {\"" << event.ArgName << "\": " << event.Arg
+             << "}";
+    }
+    output << "}";
+  }
+  output << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": "
+         << dropped() << "}}\n";
+}
+
+void writeJson(const std::string& path)
+{
+  std::ofstream output(path, std::ios::trunc);
+  if (!output) {
+    throw std::runtime_error("Failed to open trace file: " + path);
+  }
+  writeJson(output);
+  if (!output) {
+    throw std::runtime_error("Failed to write trace file: " + path);
+  }
+}
+
+}  // namespace LIB_NAMESPACE::trace
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/algorithm/string.hpp>
+
+#include "scoring/kernel_scorer.hpp"
+
+#include "io/numeric.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+// Peaks are binned in blocks so the index computation vectorizes.
+constexpr std::size_t kBlockSize = 256;
+
+}  // namespace
+
+std::vector<Kernel> defaultKernels()
+{
+  return {
+      {"Alkane", {29, 43, 57, 71, 85, 99, 113, 127, 141}},
+      {"Alcohol", {31, 45, 59, 73, 87, 101, 115, 129, 143}},
+      {"Ester", {43, 60, 74, 88, 102, 116, 130, 144}},
+      {"Amine", {30, 44, 58, 72, 86, 100, 114, 128, 142}},
+      {"Aldehyde", {29, 44, 58, 72, 86, 100, 114, 128}},
+      {"Ketone", {43, 58, 72, 86, 100, 114, 128, 142}},
+      {"Chloroalkane", {49, 63, 77, 91, 105, 119, 133, 147}},
+      {"Chlorobiphenyl", {152, 154, 156}},
+      {"Halogenated", {50, 80, 94, 108, 122, 136}},
+      {"Sulphur", {47, 61, 75, 89, 103, 117, 131, 145}},
+      {"Furan Ether", {68, 82, 96, 110, 124, 138}},
+      {"Carboxylic acid", {45, 60, 74, 88, 102, 116, 130, 144}},
+      {"Aromatic", {77, 91, 105, 119, 133, 147}},
+  };
+}
+
+MzTolerance defaultKernelTolerance(bool accurateMass)
+{
+  return accurateMass ? 0.5 : 0.1;
+}
+
+std::vector<Kernel> readKernels(std::istream& input)
+{
+  std::vector<Kernel> kernels;
+  std::string line;
+  unsigned long number = 0;
+
+  while (std::getline(input, line)) {
+    ++number;
+    boost::algorithm::trim(line);
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+
+    std::vector<std::string> fields;
+    boost::algorithm::split(fields, line, boost::algorithm::is_any_of(","));
+
+    Kernel kernel;
+    kernel.Name = boost::algorithm::trim_copy(fields.front());
+    for (std::size_t i = 1; i < fields.size(); ++i) {
+      auto mz = numeric::parse<double>(fields[i]);
+      if (!mz || !std::isfinite(*mz)) {
+        throw std::runtime_error("Invalid m/z '" + fields[i]
+                                 + "' in kernel file line "
+                                 + std::to_string(number));
+      }
+      kernel.MzValues.push_back(*mz);
+    }
+
+    if (kernel.Name.empty() || kernel.MzValues.empty()) {
+      throw std::runtime_error("Kernel file line " + std::to_string(number)
+                               + " needs a name and at least one m/z");
+    }
+    kernels.push_back(std::move(kernel));
+  }
+
+  return kernels;
+}
+
+std::vector<Kernel> readKernels(const std::string& path)
+{
+  std::ifstream input(path);
+  if (!input) {
+    throw std::runtime_error("Failed to open kernel file: " + path);
+  }
+  return readKernels(input);
+}
+
+KernelScorer::KernelScorer(std::vector<Kernel> kernels, MzTolerance tolerance)
+    : m_kernels(std::move(kernels))
+    , m_tolerance(tolerance)
+{
+  if (!(m_tolerance.Value > 0)) {
+    throw std::invalid_argument("Kernel tolerance must be positive");
+  }
+
+  for (const auto& kernel : m_kernels) {
+    for (auto mz : kernel.MzValues) {
+      if (!std::isfinite(mz)) {
+        throw std::invalid_argument("Kernel '" + kernel.Name
+                                    + "' has a non-finite m/z");
+      }
+    }
+  }
+
+  auto merge = [this]
+  {
+    std::vector<Candidate> ions;
+    for (std::uint32_t k = 0; k < m_kernels.size(); ++k) {
+      for (auto mz : m_kernels[k].MzValues) {
+        ions.push_back({k, mz});
+      }
+    }
+    std::stable_sort(ions.begin(),
+                     ions.end(),
+                     [](const Candidate& a, const Candidate& b)
+                     { return a.MzValue < b.MzValue; });
+    for (const auto& ion : ions) {
+      m_ionMzValues.push_back(ion.MzValue);
+      m_ionKernels.push_back(ion.Kernel);
+    }
+  };
+
+  if (m_tolerance.Unit == ToleranceUnit::Ppm) {
+    merge();
+    return;
+  }
+  const double window = m_tolerance.Value;
+
+  double lowest = 0;
+  double highest = 0;
+  bool any = false;
+  for (const auto& kernel : m_kernels) {
+    for (auto mz : kernel.MzValues) {
+      lowest = any ? std::min(lowest, mz) : mz;
+      highest = any ? std::max(highest, mz) : mz;
+      any = true;
+    }
+  }
+  if (!any) {
+    return;
+  }
+
+  // Windows get a spare bin on either side so that rounding in the bin
+  // index can never move a matching peak outside the table.
+  double binWidth = window / 4;
+  m_inverseBinWidth = 1 / binWidth;
+  m_origin = lowest - window - 2 * binWidth;
+  double span = std::ceil((highest + window + 2 * binWidth - m_origin)
+                          * m_inverseBinWidth);
+  // A tolerance far below the spread of the ions would need a huge table;
+  // such scorers merge against the sorted ions like ppm ones do.
+  if (!(span < static_cast<double>(kMaxBins))) {
+    merge();
+    return;
+  }
+  auto bins = static_cast<std::size_t>(span) + 1;
+
+  std::vector<std::vector<Candidate>> clipped(bins);
+  m_masks.assign(bins, 0);
+
+  for (std::uint32_t k = 0; k < m_kernels.size(); ++k) {
+    for (auto mz : m_kernels[k].MzValues) {
+      auto first = static_cast<std::size_t>(
+          std::floor((mz - window - m_origin) * m_inverseBinWidth));
+      auto last = static_cast<std::size_t>(
+          std::floor((mz + window - m_origin) * m_inverseBinWidth));
+
+      for (std::size_t bin = first - 1; bin <= last + 1; ++bin) {
+        // Bins two away from the window edges lie strictly inside it.
+        bool inside = bin >= first + 2 && bin + 2 <= last;
+        std::uint64_t bit = k < kMaskBits ? std::uint64_t(1) << k : 0;
+
+        // A kernel ion counted twice in one bin needs the exact path too.
+        if (inside && bit && !(m_masks[bin] & bit)) {
+          m_masks[bin] |= bit;
+        } else {
+          clipped[bin].push_back({k, mz});
+        }
+      }
+    }
+  }
+
+  m_offsets.reserve(bins + 1);
+  m_offsets.push_back(0);
+  for (const auto& candidates : clipped) {
+    m_candidates.insert(m_candidates.end(), candidates.begin(), candidates.end());
+    m_offsets.push_back(static_cast<std::uint32_t>(m_candidates.size()));
+  }
+}
+
+void KernelScorer::accumulate(
+    std::span<const Spectrum::tMzValue> mzValues,
+    std::span<const Spectrum::tAbundanceValue> abundanceValues,
+    std::span<double> scores) const
+{
+  if (m_masks.empty()) {
+    accumulateMerged(mzValues, abundanceValues, scores);
+    return;
+  }
+
+  std::size_t peaks = std::min(mzValues.size(), abundanceValues.size());
+  const double limit = static_cast<double>(m_masks.size());
+  std::int64_t bins[kBlockSize];
+
+  for (std::size_t block = 0; block < peaks; block += kBlockSize) {
+    std::size_t count = std::min(kBlockSize, peaks - block);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      double position = (mzValues[block + i] - m_origin) * m_inverseBinWidth;
+      // Out of range and NaN peaks map to -1.
+      bins[i] = position >= 0 && position < limit
+          ? static_cast<std::int64_t>(position)
+          : -1;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+      if (bins[i] < 0) {
+        continue;
+      }
+      auto bin = static_cast<std::size_t>(bins[i]);
+      double mz = mzValues[block + i];
+      double value = abundanceValues[block + i] / 10000;
+
+      for (std::uint64_t mask = m_masks[bin]; mask; mask &= mask - 1) {
+        scores[static_cast<std::size_t>(std::countr_zero(mask))] += value;
+      }
+      for (auto c = m_offsets[bin]; c < m_offsets[bin + 1]; ++c) {
+        if (std::abs(mz - m_candidates[c].MzValue) < m_tolerance.Value) {
+          scores[m_candidates[c].Kernel] += value;
+        }
+      }
+    }
+  }
+}
+
+void KernelScorer::accumulateMerged(
+    std::span<const Spectrum::tMzValue> mzValues,
+    std::span<const Spectrum::tAbundanceValue> abundanceValues,
+    std::span<double> scores) const
+{
+  std::size_t peaks = std::min(mzValues.size(), abundanceValues.size());
+
+  forEachMatch(m_ionMzValues,
+               mzValues.first(peaks),
+               m_tolerance,
+               [&](std::size_t ion, std::size_t peak)
+               {
+                 // The shared matcher's window is closed; ours is open.
+                 if (std::abs(mzValues[peak] - m_ionMzValues[ion])
+                     < m_tolerance.window(m_ionMzValues[ion]))
+                 {
+                   scores[m_ionKernels[ion]] += abundanceValues[peak] / 10000;
+                 }
+               });
+}
+
+void KernelScorer::score(const CompoundView& compound,
+                         std::span<double> scores) const
+{
+  std::fill(scores.begin(), scores.end(), 0.0);
+
+  for (const auto& spectrum : compound.Spectra) {
+    accumulate(spectrum.MzValues, spectrum.AbundanceValues, scores);
+  }
+
+  for (auto& score : scores) {
+    score /= static_cast<double>(compound.Spectra.size());
+  }
+}
+
+std::vector<double> KernelScorer::score(const CompoundView& compound) const
+{
+  std::vector<double> scores(m_kernels.size());
+  score(compound, scores);
+  return scores;
+}
+
+}  // namespace LIB_NAMESPACE
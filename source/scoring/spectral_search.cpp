@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/stats.hpp"
+#include "scoring/spectral_search.hpp"
+
+namespace LIB_NAMESPACE
+{
+
+namespace
+{
+
+constexpr std::uint32_t kNoClaim = ~std::uint32_t(0);
+
+struct Claim
+{
+  std::uint32_t Query;
+  std::uint32_t Previous;
+  double MzValue;
+};
+
+// Per-spectrum sums and claims of the search running on this thread. Only
+// the spectra in Touched hold anything, and they are reset when the search
+// ends, so a query costs nothing for the spectra it does not reach. The
+// arrays grow to the largest library searched and are then reused.
+struct Scratch
+{
+  std::vector<double> Dots;
+  std::vector<std::uint32_t> Matches;
+  // Claims of each spectrum, newest first, chained through Claims.
+  std::vector<std::uint32_t> LastClaim;
+  std::vector<Claim> Claims;
+  std::vector<std::uint32_t> Touched;
+};
+
+thread_local Scratch t_scratch;
+
+// Takes this thread's scratch for one search and leaves it clean again.
+class ScratchLease
+{
+public:
+  explicit ScratchLease(std::size_t spectra)
+      : m_scratch(t_scratch)
+  {
+    if (m_scratch.LastClaim.size() < spectra) {
+      m_scratch.Dots.resize(spectra, 0.0);
+      m_scratch.Matches.resize(spectra, 0);
+      m_scratch.LastClaim.resize(spectra, kNoClaim);
+    }
+  }
+
+  ScratchLease(const ScratchLease&) = delete;
+  ScratchLease& operator=(const ScratchLease&) = delete;
+
+  ~ScratchLease()
+  {
+    for (auto s : m_scratch.Touched) {
+      m_scratch.Dots[s] = 0;
+      m_scratch.Matches[s] = 0;
+      m_scratch.LastClaim[s] = kNoClaim;
+    }
+    m_scratch.Touched.clear();
+    m_scratch.Claims.clear();
+  }
+
+  Scratch& operator*() const { return m_scratch; }
+
+private:
+  Scratch& m_scratch;
+};
+
+bool better(const SearchHit& lhs, const SearchHit& rhs)
+{
+  if (lhs.Score > rhs.Score) {
+    return true;
+  }
+  if (rhs.Score > lhs.Score) {
+    return false;
+  }
+  return lhs.CompoundID < rhs.CompoundID;
+}
+
+}  // namespace
+
+MzTolerance defaultSearchTolerance(bool accurateMass)
+{
+  return accurateMass ? MzTolerance::ppm(20) : 0.5;
+}
+
+SpectralSearch::SpectralSearch(const SpectralStore& library,
+                               SearchOptions options)
+    : m_library(library)
+    , m_options(options)
+{
+  LIB_STATS_SCOPE(Build);
+  if (!(m_options.Tolerance.Value > 0)) {
+    throw std::invalid_argument("Search tolerance must be positive");
+  }
+
+  std::vector<double> weights(library.peakCount());
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    weights[i] = weight(library.MzValues[i], library.AbundanceValues[i]);
+  }
+
+  m_norms.resize(library.spectrumCount());
+  m_compoundOf.resize(library.spectrumCount());
+  for (std::size_t c = 0; c < library.compoundCount(); ++c) {
+    std::fill(m_compoundOf.begin()
+                  + static_cast<std::ptrdiff_t>(library.SpectrumOffsets[c]),
+              m_compoundOf.begin()
+                  + static_cast<std::ptrdiff_t>(library.SpectrumOffsets[c + 1]),
+              static_cast<std::uint32_t>(c));
+  }
+  std::vector<std::uint32_t> spectrumOf(library.peakCount());
+  for (std::size_t s = 0; s < m_norms.size(); ++s) {
+    double sum = 0;
+    for (auto i = library.PeakOffsets[s]; i < library.PeakOffsets[s + 1]; ++i)
+    {
+      sum += weights[i] * weights[i];
+      spectrumOf[i] = static_cast<std::uint32_t>(s);
+    }
+    m_norms[s] = std::sqrt(sum);
+  }
+
+  // Peaks that can contribute, in m/z order; equal m/z keep store order.
+  std::vector<std::size_t> order;
+  order.reserve(weights.size());
+  for (std::size_t i = 0; i < weights.size(); ++i) {
+    if (weights[i] > 0) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(),
+                   order.end(),
+                   [&](std::size_t a, std::size_t b)
+                   { return library.MzValues[a] < library.MzValues[b]; });
+
+  m_mzValues.reserve(order.size());
+  m_weights.reserve(order.size());
+  m_spectrumOf.reserve(order.size());
+  for (auto i : order) {
+    m_mzValues.push_back(library.MzValues[i]);
+    m_weights.push_back(weights[i]);
+    m_spectrumOf.push_back(spectrumOf[i]);
+  }
+}
+
+double SpectralSearch::weight(double mz, double abundance) const
+{
+  if (!(abundance > 0) || !(mz > 0)) {
+    return 0;
+  }
+  const double abundancePower = m_options.AbundancePower;
+  const double mzPower = m_options.MzPower;
+  double value = !(abundancePower < 1 || abundancePower > 1)
+      ? abundance
+      : std::pow(abundance, abundancePower);
+  if (mzPower < 0 || mzPower > 0) {
+    value *= std::pow(mz, m_options.MzPower);
+  }
+  return value;
+}
+
+std::vector<SearchHit> SpectralSearch::search(const SpectrumView& query) const
+{
+  return search(query.MzValues, query.AbundanceValues);
+}
+
+std::vector<SearchHit> SpectralSearch::search(
+    std::span<const Spectrum::tMzValue> mzValues,
+    std::span<const Spectrum::tAbundanceValue> abundanceValues) const
+{
+  const MzTolerance& tolerance = m_options.Tolerance;
+
+  std::vector<double> queryMz;
+  std::vector<double> queryWeights;
+  // Window half-widths around the query peaks, widened a hair so that
+  // rounding can only let extra peaks through to the exact check, never drop
+  // a match. Sorted query peaks keep both window edges ascending.
+  std::vector<double> windows;
+  double queryNorm = 0;
+  {
+    std::size_t count = std::min(mzValues.size(), abundanceValues.size());
+    std::vector<std::size_t> order;
+    order.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      if (weight(mzValues[i], abundanceValues[i]) > 0) {
+        order.push_back(i);
+      }
+    }
+    std::sort(order.begin(),
+              order.end(),
+              [&](std::size_t a, std::size_t b)
+              { return mzValues[a] < mzValues[b]; });
+
+    for (auto i : order) {
+      queryMz.push_back(mzValues[i]);
+      queryWeights.push_back(weight(mzValues[i], abundanceValues[i]));
+      windows.push_back(tolerance.window(mzValues[i]) * (1 + 1e-9));
+      queryNorm += queryWeights.back() * queryWeights.back();
+    }
+    queryNorm = std::sqrt(queryNorm);
+  }
+
+  if (queryMz.empty() || m_options.TopK == 0) {
+    return {};
+  }
+
+  // Walk the library peaks inside the union of the query windows once, in
+  // m/z order. Claims and sums are kept per library spectrum. Library peaks
+  // arrive in m/z order, so only claims made within two of the widest window
+  // below the current peak can involve its candidates, and the chain walk
+  // stops there.
+  const ScratchLease lease(m_library.spectrumCount());
+  auto& [dots, matches, lastClaim, claims, touched] = *lease;
+
+  const std::size_t peaks = m_mzValues.size();
+  const std::size_t unmatched = queryMz.size();
+  std::size_t cursor = 0;
+  std::size_t firstCandidate = 0;
+  const double reach = 2 * *std::max_element(windows.begin(), windows.end());
+
+  for (std::size_t w = 0; w < queryMz.size(); ++w) {
+    auto from = std::lower_bound(
+        m_mzValues.begin() + static_cast<std::ptrdiff_t>(cursor),
+        m_mzValues.end(),
+        queryMz[w] - windows[w]);
+    cursor = static_cast<std::size_t>(from - m_mzValues.begin());
+
+    for (; cursor < peaks && m_mzValues[cursor] <= queryMz[w] + windows[w];
+         ++cursor)
+    {
+      const double mz = m_mzValues[cursor];
+      const std::size_t s = m_spectrumOf[cursor];
+
+      while (queryMz[firstCandidate] + windows[firstCandidate] < mz) {
+        ++firstCandidate;
+      }
+
+      auto claimed = [&](std::size_t q)
+      {
+        for (auto c = lastClaim[s];
+             c != kNoClaim && claims[c].MzValue >= mz - reach;
+             c = claims[c].Previous)
+        {
+          if (claims[c].Query == q) {
+            return true;
+          }
+        }
+        return false;
+      };
+
+      // Nearest query peak within the tolerance not yet claimed by this
+      // spectrum; ties go to the lower m/z.
+      std::size_t nearest = unmatched;
+      double distance = 0;
+      for (auto q = firstCandidate;
+           q < queryMz.size() && queryMz[q] - windows[q] <= mz;
+           ++q)
+      {
+        double delta = std::abs(queryMz[q] - mz);
+        if (tolerance.matches(queryMz[q], mz)
+            && (nearest == unmatched || delta < distance) && !claimed(q))
+        {
+          nearest = q;
+          distance = delta;
+        }
+      }
+      if (nearest != unmatched) {
+        if (matches[s] == 0) {
+          touched.push_back(static_cast<std::uint32_t>(s));
+        }
+        claims.push_back({static_cast<std::uint32_t>(nearest), lastClaim[s], mz});
+        lastClaim[s] = static_cast<std::uint32_t>(claims.size() - 1);
+        dots[s] += queryWeights[nearest] * m_weights[cursor];
+        ++matches[s];
+      }
+    }
+  }
+
+  // Best spectrum per compound, then the top k compounds.
+  std::vector<SearchHit> heap;
+  heap.reserve(m_options.TopK + 1);
+
+  auto offer = [&](const SearchHit& hit)
+  {
+    if (heap.size() < m_options.TopK) {
+      heap.push_back(hit);
+      std::push_heap(heap.begin(), heap.end(), better);
+    } else if (better(hit, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), better);
+      heap.back() = hit;
+      std::push_heap(heap.begin(), heap.end(), better);
+    }
+  };
+
+  // Spectra of a compound are contiguous, so in index order each compound's
+  // matched spectra come together, lowest first.
+  std::sort(touched.begin(), touched.end());
+  SearchHit best = {};
+  bool found = false;
+  for (auto s : touched) {
+    const std::size_t c = m_compoundOf[s];
+    if (found && c != best.Compound) {
+      offer(best);
+      found = false;
+    }
+
+    double score = dots[s];
+    if (m_options.Metric == Similarity::Cosine) {
+      double norm = queryNorm * m_norms[s];
+      score = norm > 0 ? dots[s] / norm : 0;
+    }
+
+    if (!found || score > best.Score) {
+      best = {.CompoundID = m_library.CompoundIDs[c],
+              .SpectrumID = m_library.SpectrumIDs[s],
+              .Compound = c,
+              .Score = score,
+              .MatchedPeaks = matches[s]};
+      found = true;
+    }
+  }
+  if (found) {
+    offer(best);
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), better);
+  return heap;
+}
+
+std::vector<std::vector<SearchHit>> SpectralSearch::search(
+    const SpectralStore& queries, unsigned threads) const
+{
+  std::vector<std::vector<SearchHit>> results(queries.spectrumCount());
+
+  WorkStealingPool pool(threads);
+  pool.run(results.size(),
+           [&](std::size_t s, unsigned)
+           { results[s] = search(queries.spectrum(s)); });
+
+  return results;
+}
+
+}  // namespace LIB_NAMESPACE
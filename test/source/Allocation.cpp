@@ -0,0 +1,181 @@
+#include <filesystem>
+#include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "io/chunked_reader.hpp"
+#include "io/library_generator.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "models/method.hpp"
+#include "profiling/allocation.hpp"
+
+#include "check.hpp"
+
+// Every string, map node and decoded array of the library is served by
+// `resource`.
+void checkOwnership(const LIB_NAMESPACE::Library& library,
+                    std::pmr::memory_resource* resource)
+{
+  check(library.get_allocator().resource() == resource, "library resource");
+  for (const auto& [compoundID, compound] : library.Compounds) {
+    check(compound.CompoundName.get_allocator().resource() == resource,
+          "compound name resource");
+    check(compound.Spectra.get_allocator().resource() == resource,
+          "spectra resource");
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      check(spectrum.MzValues.values().get_allocator().resource() == resource,
+            "m/z values resource");
+      check(spectrum.AbundanceValues.values().get_allocator().resource()
+                == resource,
+            "abundance values resource");
+    }
+  }
+}
+
+int main()
+{
+  namespace allocation = LIB_NAMESPACE::allocation;
+
+  // Counts balance, the peak holds, and a parent sees its children.
+  {
+    allocation::TrackingResource parent;
+    allocation::TrackingResource child(std::pmr::new_delete_resource(),
+                                       &parent);
+    {
+      std::pmr::vector<int> values(&child);
+      values.reserve(100);
+      check(child.usage().Bytes == 100 * sizeof(int), "live bytes");
+      check(child.usage().Allocations == 1, "allocation count");
+    }
+    auto usage = child.usage();
+    check(usage.Bytes == 0, "bytes returned");
+    check(usage.PeakBytes == 100 * sizeof(int), "peak bytes");
+    check(usage.TotalBytes == 100 * sizeof(int), "total bytes");
+    check(usage.Deallocations == 1, "deallocation count");
+    check(parent.usage().PeakBytes == usage.PeakBytes, "parent peak");
+    check(parent.usage().Allocations == 1, "parent allocations");
+
+    child.reset();
+    check(child.usage().PeakBytes == 0 && child.usage().Allocations == 0,
+          "reset");
+  }
+
+  // Off until enabled.
+  check(!allocation::enabled(), "disabled by default");
+  check(allocation::resource(allocation::Subsystem::Library)
+            == std::pmr::get_default_resource(),
+        "default resource while disabled");
+
+  LIB_NAMESPACE::GeneratorOptions options;
+  options.Compounds = 50;
+  options.SpectraPerCompound = 2;
+  options.PeaksPerSpectrum = 20;
+
+  std::ostringstream xml;
+  LIB_NAMESPACE::generateLibrary(options, xml);
+
+  // A library read into a tracking resource allocates nothing else there
+  // and gives it all back when destroyed.
+  {
+    allocation::TrackingResource resource;
+    {
+      std::istringstream input(xml.str());
+      LIB_NAMESPACE::LibraryReader reader(input);
+      LIB_NAMESPACE::Library library(
+          reader, LIB_NAMESPACE::Projection::All, &resource);
+      checkOwnership(library, &resource);
+      check(resource.usage().Allocations > options.Compounds, "tracked");
+
+      // Copies into another resource, moves within one.
+      allocation::TrackingResource other;
+      LIB_NAMESPACE::Library copy(&other);
+      copy = library;
+      checkOwnership(copy, &other);
+      auto before = resource.usage().Allocations;
+      LIB_NAMESPACE::Library moved(&resource);
+      moved = std::move(library);
+      check(resource.usage().Allocations == before, "move allocates nothing");
+      check(moved.Compounds.size() == options.Compounds, "moved compounds");
+
+      allocation::TrackingResource targets;
+      LIB_NAMESPACE::QuantitationDataSet method(moved, 1, &targets);
+      check(method.Targets.size() == options.Compounds, "targets");
+      check(targets.usage().Bytes > 0, "targets tracked");
+
+      LIB_NAMESPACE::QuantitationDataSet assigned;
+      assigned = std::move(method);
+      check(assigned.Targets.size() == options.Compounds, "moved targets");
+      check(assigned.get_allocator().resource()
+                == std::pmr::get_default_resource(),
+            "assignment keeps allocator");
+    }
+    check(resource.usage().Bytes == 0, "all bytes returned");
+    check(resource.usage().Allocations == resource.usage().Deallocations,
+          "allocations balance");
+  }
+
+  // The file readers, sequential and chunked, honour the allocator too.
+  auto path = std::filesystem::temp_directory_path() / "Allocation_test.xml";
+  LIB_NAMESPACE::generateLibrary(options, path.string());
+  {
+    allocation::TrackingResource resource;
+    auto sequential = LIB_NAMESPACE::readLibrary(
+        path.string(), LIB_NAMESPACE::Projection::All, 1, &resource);
+    checkOwnership(sequential, &resource);
+    auto parallel = LIB_NAMESPACE::readLibraryParallel(
+        path.string(), LIB_NAMESPACE::Projection::All, 4, &resource);
+    checkOwnership(parallel, &resource);
+    check(parallel.Compounds.size() == sequential.Compounds.size(),
+          "parallel compounds");
+  }
+  std::filesystem::remove(path);
+
+  // Subsystems report separately and add up in the total.
+  allocation::enable();
+  check(allocation::resource(allocation::Subsystem::Library)
+            != allocation::resource(allocation::Subsystem::Method),
+        "one resource per subsystem");
+  {
+    std::istringstream input(xml.str());
+    LIB_NAMESPACE::LibraryReader reader(input);
+    LIB_NAMESPACE::Library library(
+        reader,
+        LIB_NAMESPACE::Projection::All,
+        allocation::resource(allocation::Subsystem::Library));
+    LIB_NAMESPACE::QuantitationDataSet method(
+        library, 1, allocation::resource(allocation::Subsystem::Method));
+
+    auto snapshot = allocation::snapshot();
+    const auto& libraryUsage = snapshot[allocation::Subsystem::Library];
+    const auto& methodUsage = snapshot[allocation::Subsystem::Method];
+    check(libraryUsage.Bytes > 0 && methodUsage.Bytes > 0,
+          "live per subsystem");
+    check(snapshot[allocation::Subsystem::Queries].Allocations == 0,
+          "untouched subsystem");
+    check(snapshot.Total.Bytes == libraryUsage.Bytes + methodUsage.Bytes,
+          "total live bytes");
+    check(snapshot.Total.PeakBytes >= snapshot.Total.Bytes, "total peak");
+  }
+  auto snapshot = allocation::snapshot();
+  check(snapshot.Total.Bytes == 0, "everything returned");
+  check(snapshot.Total.PeakBytes > 0, "peak kept");
+
+  std::ostringstream table;
+  allocation::report(snapshot, table);
+  check(table.str().find("library") != std::string::npos, "report rows");
+  std::ostringstream json;
+  allocation::writeJson(snapshot, json);
+  check(json.str().find("\"peak_bytes\"") != std::string::npos, "json");
+
+  allocation::disable();
+  check(allocation::resource(allocation::Subsystem::Library)
+            == std::pmr::get_default_resource(),
+        "default resource after disable");
+
+  std::cout << "Allocation tests passed\n";
+  return 0;
+}
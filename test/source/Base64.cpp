@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "base64.hpp"
+
+#include "check.hpp"
+
+// The original byte-at-a-time decoder, kept as the reference for Lenient.
+std::string referenceDecode(const std::string& in)
+{
+  std::string out;
+  std::vector<int> T(256, -1);
+  for (int i = 0; i < 64; i++) {
+    T[static_cast<unsigned char>(base64::alphabet[static_cast<std::size_t>(i)])] =
+        i;
+  }
+  int val = 0, valb = -8;
+  for (const char c : in) {
+    int sextet = T[static_cast<unsigned char>(c)];
+    if (sextet == -1) {
+      break;
+    }
+    val = ((val << 6) + sextet) & 0xFFFFFF;
+    valb += 6;
+    if (valb >= 0) {
+      out.push_back(char((val >> valb) & 0xFF));
+      valb -= 8;
+    }
+  }
+  return out;
+}
+
+std::string referenceEncode(const std::string& in)
+{
+  std::string out;
+  std::size_t i = 0;
+  for (; i + 3 <= in.size(); i += 3) {
+    unsigned int triple = (static_cast<unsigned char>(in[i]) << 16)
+        | (static_cast<unsigned char>(in[i + 1]) << 8)
+        | static_cast<unsigned char>(in[i + 2]);
+    for (int shift = 18; shift >= 0; shift -= 6) {
+      out.push_back(base64::alphabet[(triple >> shift) & 0x3F]);
+    }
+  }
+  if (in.size() - i == 1) {
+    unsigned int byte = static_cast<unsigned char>(in[i]);
+    out += base64::alphabet[byte >> 2];
+    out += base64::alphabet[(byte << 4) & 0x3F];
+    out += "==";
+  } else if (in.size() - i == 2) {
+    unsigned int pair = (static_cast<unsigned char>(in[i]) << 8)
+        | static_cast<unsigned char>(in[i + 1]);
+    out += base64::alphabet[pair >> 10];
+    out += base64::alphabet[(pair >> 4) & 0x3F];
+    out += base64::alphabet[(pair << 2) & 0x3F];
+    out += "=";
+  }
+  return out;
+}
+
+bool throwsStrict(const std::string& in)
+{
+  std::vector<std::byte> out(base64::decodedSize(in));
+  try {
+    base64::decode(in, out, base64::Validation::Strict);
+  } catch (const std::invalid_argument&) {
+    return true;
+  }
+  return false;
+}
+
+int main()
+{
+  std::mt19937 random(42);
+
+  for (std::size_t size = 0; size < 400; ++size) {
+    std::string bytes(size, '\0');
+    for (auto& byte : bytes) {
+      byte = static_cast<char>(random() & 0xFF);
+    }
+
+    std::string encoded = base64::encode(bytes);
+    check(encoded == referenceEncode(bytes), "encode " + std::to_string(size));
+    check(base64::decode(encoded) == bytes, "decode " + std::to_string(size));
+    check(!throwsStrict(encoded), "strict " + std::to_string(size));
+
+    // Any character outside the alphabet must stop decoding at that point,
+    // wherever it lands relative to the vector blocks.
+    if (!encoded.empty()) {
+      std::string damaged = encoded;
+      damaged[random() % damaged.size()] =
+          "\n -=*\x80\xff"[random() % 7];
+      check(base64::decode(damaged) == referenceDecode(damaged),
+            "lenient " + std::to_string(size));
+      check(throwsStrict(damaged) || damaged == encoded,
+            "strict damaged " + std::to_string(size));
+    }
+  }
+
+  for (int c = 0; c < 256; ++c) {
+    std::string block(64, 'A');
+    block[37] = static_cast<char>(c);
+    check(base64::decode(block) == referenceDecode(block),
+          "character " + std::to_string(c));
+  }
+
+  check(throwsStrict("QUJD="), "padding after full quad");
+  check(throwsStrict("Q"), "dangling sextet");
+  check(!throwsStrict("QQ"), "unpadded");
+
+  std::vector<double> values = {41.0, 55.5, -1e300, 0.0, 3.25};
+  std::string encoded =
+      base64::encodeArray(std::span<const double>(values));
+  check(encoded
+            == "AAAAAACAREAAAAAAAMBLQJx1AIg85Df+AAAAAAAAAAAAAAAAAAAKQA==",
+        "encodeArray");
+
+  std::vector<double> decoded;
+  base64::decodeInto(encoded, decoded, base64::Validation::Strict);
+  check(decoded == values, "decodeInto");
+
+  std::cout << "Base64: OK" << std::endl;
+  return 0;
+}
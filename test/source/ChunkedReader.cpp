@@ -0,0 +1,190 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "base64.hpp"
+#include "io/chunked_reader.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+
+#include "check.hpp"
+
+std::string encodePeaks(const std::vector<double>& values)
+{
+  std::string out;
+  base64::encode(std::as_bytes(std::span<const double>(values)), out);
+  return out;
+}
+
+std::string spectrumXml(int compound, int spectrum)
+{
+  std::vector<double> mz;
+  std::vector<double> abundance;
+  for (int p = 0; p < 40; ++p) {
+    mz.push_back(30 + p * 1.5 + compound % 7);
+    abundance.push_back((p * 37 + spectrum) % 1000);
+  }
+  return "  <Spectrum>\n    <CompoundID>" + std::to_string(compound)
+      + "</CompoundID>\n    <SpectrumID>" + std::to_string(spectrum)
+      + "</SpectrumID>\n    <MzValues>" + encodePeaks(mz)
+      + "</MzValues>\n    <AbundanceValues>" + encodePeaks(abundance)
+      + "</AbundanceValues>\n  </Spectrum>\n";
+}
+
+std::string writeFile(const std::string& name, const std::string& content)
+{
+  auto path = (std::filesystem::temp_directory_path() / name).string();
+  std::ofstream(path, std::ios::binary) << content;
+  return path;
+}
+
+void checkSame(const LIB_NAMESPACE::Library& expected,
+               const LIB_NAMESPACE::Library& actual)
+{
+  check(actual.LibraryID == expected.LibraryID, "LibraryID");
+  check(actual.AccurateMass == expected.AccurateMass, "AccurateMass");
+  check(actual.Compounds.size() == expected.Compounds.size(), "compounds");
+  for (const auto& [id, compound] : expected.Compounds) {
+    const auto& other = actual.Compounds.at(id);
+    check(other.LibraryID == compound.LibraryID, "compound LibraryID");
+    check(other.CompoundName == compound.CompoundName, "CompoundName");
+    check(other.Spectra.size() == compound.Spectra.size(), "spectra");
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      const auto& copy = other.Spectra.at(spectrumID);
+      check(copy.MzValues.decoded(), "decoded by the workers");
+      check(copy.MzValues == spectrum.MzValues, "MzValues");
+      check(copy.AbundanceValues == spectrum.AbundanceValues,
+            "AbundanceValues");
+    }
+  }
+}
+
+int main()
+{
+  // Large enough for several chunks, with markup that a naive scan for
+  // "</Spectrum>" or '>' would trip over.
+  std::string document =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<!DOCTYPE LibraryDataSet [ <!ENTITY x \"y\"> ]>\n"
+      "<LibraryDataSet xmlns=\"http://tempuri.org/LibraryDataSet.xsd\">\n"
+      "  <Compound><CompoundID>9998</CompoundID></Compound>\n"
+      "  <Library><LibraryID>4</LibraryID>"
+      "<AccurateMass>true</AccurateMass></Library>\n";
+  const int compounds = 1500;
+  for (int c = 1; c <= compounds; ++c) {
+    document += "  <Compound>\n    <CompoundID>" + std::to_string(c)
+        + "</CompoundID>\n    <CompoundName><![CDATA[</Compound> " + std::to_string(c)
+        + "]]></CompoundName>\n  </Compound>\n";
+    if (c % 100 == 0) {
+      document += "  <!-- <Spectrum> in a comment -->\n"
+                  "  <Extra note=\"a > b\" other='</Extra>'/>\n";
+    }
+    // Compound 1's spectra trail far behind it, in other chunks.
+    if (c > 1) {
+      document += spectrumXml(c, c * 10) + spectrumXml(c, c * 10 + 1);
+    }
+  }
+  document += spectrumXml(1, 10);
+  document += "  <Library><LibraryID>5</LibraryID></Library>\n"
+              "  <Compound><CompoundID>9999</CompoundID></Compound>\n"
+              "</LibraryDataSet>\n";
+  check(document.size() > (1 << 20), "document spans several chunks");
+
+  auto elements = LIB_NAMESPACE::scanLibrary(document);
+  check(elements.size() == 4 + compounds * 3 - 1 + 15, "element count");
+  check(elements[1].Kind == LIB_NAMESPACE::LibraryReader::Record::Library,
+        "first library");
+  for (const auto& element : elements) {
+    auto text = std::string_view(document).substr(
+        element.Begin, element.End - element.Begin);
+    check(text.front() == '<' && text.back() == '>', "element bounds");
+  }
+
+  auto path = writeFile("ChunkedReader.mslibrary.xml", document);
+  auto sequential = LIB_NAMESPACE::readLibrary(path);
+  for (unsigned threads : {2u, 4u, 16u}) {
+    checkSame(sequential, LIB_NAMESPACE::readLibraryParallel(
+                              path, LIB_NAMESPACE::Projection::All, threads));
+  }
+  // The first <Library> holds for every compound, before or after it.
+  check(sequential.LibraryID == 4
+            && sequential.Compounds.at(9998).LibraryID == 4
+            && sequential.Compounds.at(9999).LibraryID == 4
+            && sequential.Compounds.at(1).LibraryID == 4,
+        "first LibraryID for every compound");
+
+  auto projected = LIB_NAMESPACE::readLibrary(
+      path, LIB_NAMESPACE::Projection::Metadata, 4);
+  check(projected.Compounds.at(2).Spectra.at(20).MzValues.empty(),
+        "projected parallel load");
+
+  // A spectrum ahead of its compound is rejected, even chunks apart.
+  std::string orphan = document;
+  orphan.insert(orphan.find("  <Compound>"), spectrumXml(1400, 1));
+  auto orphanPath = writeFile("ChunkedReaderOrphan.mslibrary.xml", orphan);
+  for (unsigned threads : {1u, 4u}) {
+    bool rejected = false;
+    try {
+      LIB_NAMESPACE::readLibrary(
+          orphanPath, LIB_NAMESPACE::Projection::All, threads);
+    } catch (const std::runtime_error& e) {
+      rejected = std::string(e.what())
+          == "Compound ID not found for Spectrum: 1400";
+    }
+    check(rejected, "orphan spectrum");
+  }
+
+  // Parse errors carry the same document line either way.
+  std::string broken = document;
+  auto at = broken.rfind("<SpectrumID>");
+  broken.replace(at, 12, "<SpectrumID x=>");
+  auto brokenPath = writeFile("ChunkedReaderBroken.mslibrary.xml", broken);
+  unsigned long lines[2] = {};
+  for (unsigned threads : {1u, 4u}) {
+    try {
+      LIB_NAMESPACE::readLibrary(
+          brokenPath, LIB_NAMESPACE::Projection::All, threads);
+    } catch (const boost::property_tree::xml_parser_error& e) {
+      lines[threads == 4] = e.line();
+    }
+  }
+  check(lines[0] > 0 && lines[0] == lines[1], "error line");
+
+  // Only LibraryDataSet documents are libraries.
+  std::string foreign = document;
+  foreign.replace(foreign.find("<LibraryDataSet xmlns"), 15, "<QuantDataSet");
+  foreign.replace(foreign.rfind("</LibraryDataSet>"), 17, "</QuantDataSet>");
+  auto foreignPath = writeFile("ChunkedReaderForeign.mslibrary.xml", foreign);
+  for (unsigned threads : {1u, 4u}) {
+    bool rejected = false;
+    try {
+      LIB_NAMESPACE::readLibrary(
+          foreignPath, LIB_NAMESPACE::Projection::All, threads);
+    } catch (const boost::property_tree::xml_parser_error& e) {
+      rejected = e.line() == 3;
+    }
+    check(rejected, "root element");
+  }
+
+  bool truncated = false;
+  try {
+    LIB_NAMESPACE::scanLibrary(document.substr(0, document.size() / 2));
+  } catch (const boost::property_tree::xml_parser_error&) {
+    truncated = true;
+  }
+  check(truncated, "truncated document");
+
+  std::filesystem::remove(path);
+  std::filesystem::remove(orphanPath);
+  std::filesystem::remove(brokenPath);
+  std::filesystem::remove(foreignPath);
+
+  std::cout << "ChunkedReader: OK" << std::endl;
+  return 0;
+}
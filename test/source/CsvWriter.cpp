@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "io/csv_writer.hpp"
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+
+#include "check.hpp"
+
+// The conversion LibraryToCSV used before the writer existed, with a stable
+// sort so that ties are deterministic.
+std::string legacyConvert(const LIB_NAMESPACE::SpectralStore& library)
+{
+  std::string output;
+  for (const auto& compound : library.compounds()) {
+    std::string line = std::to_string(compound.CompoundID) + ","
+        + std::to_string(compound.RetentionIndex) + ",";
+    for (const auto& spectrum : compound.Spectra) {
+      std::vector<std::pair<double, double>> zipped;
+      for (std::size_t i = 0; i < spectrum.MzValues.size(); ++i) {
+        zipped.emplace_back(spectrum.AbundanceValues[i], spectrum.MzValues[i]);
+      }
+      std::stable_sort(zipped.begin(),
+                       zipped.end(),
+                       [](const auto& a, const auto& b)
+                       { return a.first > b.first; });
+      zipped.resize(std::min<std::size_t>(zipped.size(), 5));
+      for (const auto& peak : zipped) {
+        line += std::to_string(peak.second) + ",";
+      }
+      break;
+    }
+    output += line + "\n";
+  }
+  return output;
+}
+
+int main()
+{
+  std::mt19937 random(13);
+  std::uniform_real_distribution<double> mz(30, 500);
+  std::uniform_int_distribution<int> abundance(0, 20);
+
+  LIB_NAMESPACE::Library library;
+  for (LIB_NAMESPACE::tCompoundID id = 1; id <= 400; ++id) {
+    LIB_NAMESPACE::Compound compound;
+    compound.CompoundID = id;
+    compound.RetentionIndex = 1000.25f + static_cast<float>(id);
+    compound.CompoundName = id % 3 == 1 ? "Name, with \"quotes\"" : "Plain";
+    compound.Formula = "C2H6O";
+    library.insert(compound);
+
+    // Compound 7 has no spectra; small abundances force ties.
+    for (LIB_NAMESPACE::tSpectrumID s = 0; id != 7 && s < id % 3; ++s) {
+      LIB_NAMESPACE::Spectrum spectrum;
+      spectrum.CompoundID = id;
+      spectrum.SpectrumID = id * 10 + s;
+      for (LIB_NAMESPACE::tCompoundID p = 0; p < id % 9; ++p) {
+        spectrum.MzValues.push_back(mz(random));
+        spectrum.AbundanceValues.push_back(abundance(random) * 50.0);
+      }
+      library.insert(spectrum);
+    }
+  }
+  LIB_NAMESPACE::SpectralStore store(library);
+
+  std::ostringstream defaults;
+  LIB_NAMESPACE::writeCsv(store, defaults);
+  check(defaults.str() == legacyConvert(store), "default layout unchanged");
+
+  // Metadata quoting, every peak with abundances, one row per spectrum.
+  LIB_NAMESPACE::CsvOptions options;
+  options.Peaks = LIB_NAMESPACE::CsvPeaks::All;
+  options.Abundances = true;
+  options.Metadata = true;
+  options.EachSpectrum = true;
+  options.Header = true;
+  std::ostringstream full;
+  LIB_NAMESPACE::writeCsv(store, full, options);
+
+  std::istringstream rows(full.str());
+  std::string row;
+  std::getline(rows, row);
+  check(row.starts_with("CompoundID,SpectrumID,RetentionIndex,CASNumber,")
+            && row.ends_with(",Mz8,Abundance8,"),
+        "header: " + row);
+
+  std::size_t count = 0;
+  bool quoted = false;
+  while (std::getline(rows, row)) {
+    ++count;
+    quoted |= row.starts_with("4,40,1004.250000,,\"Name, with \"\"quotes\"\"\","
+                              "C2H6O,0.000000,0.000000,");
+  }
+  check(quoted, "quoted metadata");
+  check(count == store.spectrumCount(), "one row per spectrum");
+
+  // Peaks in m/z order with --peaks=all, and no peaks with none.
+  auto spectrum = store.spectrum(5);
+  options = {};
+  options.Peaks = LIB_NAMESPACE::CsvPeaks::All;
+  std::ostringstream all;
+  LIB_NAMESPACE::CsvWriter writer(all, options);
+  writer.write(store.compound(store.find(spectrum.CompoundID)));
+  writer.flush();
+  std::string expected = std::to_string(spectrum.CompoundID) + ","
+      + std::to_string(store.compound(store.find(spectrum.CompoundID))
+                           .RetentionIndex)
+      + ",";
+  for (auto value : store.compound(store.find(spectrum.CompoundID))
+                        .Spectra.front()
+                        .MzValues)
+  {
+    expected += std::to_string(value) + ",";
+  }
+  check(all.str() == expected + "\n", "all peaks");
+
+  options.Peaks = LIB_NAMESPACE::CsvPeaks::None;
+  std::ostringstream none;
+  LIB_NAMESPACE::writeCsv(store, none, options);
+  check(none.str().starts_with("1,1001.250000,\n2,1002.250000,\n"), "no peaks");
+
+  std::cout << "CsvWriter: OK" << std::endl;
+  return 0;
+}
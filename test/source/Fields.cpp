@@ -0,0 +1,125 @@
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include "models/compound.hpp"
+#include "models/method.hpp"
+#include "models/spectrum.hpp"
+
+#include "check.hpp"
+#include "xml.hpp"
+
+namespace fields = LIB_NAMESPACE::fields;
+
+struct Sample
+{
+  int Count;
+  float Ratio;
+  std::string Label;
+};
+
+inline constexpr auto kSampleFields =
+    std::tuple {fields::field("Count", &Sample::Count),
+                fields::field("Ratio", &Sample::Ratio),
+                fields::field("Label", &Sample::Label)};
+
+int main()
+{
+  // The index is built at compile time and maps every name to its field.
+  constexpr auto names = fields::names(LIB_NAMESPACE::kCompoundFields);
+  constexpr fields::NameIndex<names.size()> index(names);
+  static_assert(index.find("CompoundID") == 0);
+  static_assert(index.find("RetentionTimeRTL") == names.size() - 1);
+  static_assert(index.find("SpectrumID") == names.size());
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    check(index.find(names[i]) == i, "index of " + std::string(names[i]));
+  }
+  check(index.find("") == names.size(), "empty name");
+  check(index.find("CompoundId") == names.size(), "case");
+
+  // First of a name wins, bad numbers read as zero, missing fields are
+  // reset and unknown children are handed on.
+  Sample sample {5, 2.5f, "stale"};
+  std::vector<std::string> others;
+  fields::read<kSampleFields>(
+      sample,
+      parse("<Sample><Count> 7 </Count><Extra>x</Extra><Count>8</Count>"
+            "<Ratio>abc</Ratio></Sample>")
+          .get_child("Sample"),
+      [&](std::string_view name, const boost::property_tree::ptree&)
+      { others.emplace_back(name); });
+  check(sample.Count == 7, "first duplicate");
+  check(same(sample.Ratio, 0.0f), "malformed number");
+  check(sample.Label.empty(), "missing field");
+  check(others == std::vector<std::string> {"Extra"}, "unknown children");
+
+  // A compound reads as it did through ptree::get.
+  auto compoundTree = parse(
+      "<Compound><CompoundID>12</CompoundID><CASNumber>67-64-1</CASNumber>"
+      "<CompoundName>Acetone</CompoundName><Formula>C3H6O</Formula>"
+      "<MolecularWeight>58.08</MolecularWeight><Unused>1</Unused>"
+      "<RetentionTimeRTL>2.5</RetentionTimeRTL></Compound>");
+  LIB_NAMESPACE::Compound compound(3, compoundTree.get_child("Compound"));
+  check(compound.LibraryID == 3, "LibraryID");
+  check(compound.CompoundID == 12, "CompoundID");
+  check(compound.CASNumber == "67-64-1", "CASNumber");
+  check(compound.CompoundName == "Acetone", "CompoundName");
+  check(compound.Formula == "C3H6O", "Formula");
+  check(same(compound.MolecularWeight, 58.08f), "MolecularWeight");
+  check(same(compound.BoilingPoint, 0.0f), "BoilingPoint");
+  check(same(compound.RetentionTimeRTL, 2.5f), "RetentionTimeRTL");
+
+  // Peak columns come through the handler for unknown children.
+  auto spectrumTree = parse(
+      "<Spectrum><CompoundID>12</CompoundID><SpectrumID>4</SpectrumID>"
+      "<BasePeakMZ>41</BasePeakMZ>"
+      "<MzValues>AAAAAACAREAAAAAAAMBLQA==</MzValues>"
+      "<AbundanceValues>AAAAAABAj0AAAAAAAEBvQA==</AbundanceValues>"
+      "</Spectrum>");
+  LIB_NAMESPACE::Spectrum spectrum(spectrumTree.get_child("Spectrum"));
+  check(spectrum.CompoundID == 12 && spectrum.SpectrumID == 4, "IDs");
+  check(spectrum.LibraryID == 0, "LibraryID");
+  check(same(spectrum.BasePeakMZ, 41.0f), "BasePeakMZ");
+  check(spectrum.MzValues.size() == 2 && same(spectrum.MzValues[1], 55.5),
+        "MzValues");
+  check(spectrum.AbundanceValues.size() == 2
+            && same(spectrum.AbundanceValues[0], 1000.0),
+        "AbundanceValues");
+
+  // The target table covers every element, each name once, and its values
+  // come from the target or from its settings.
+  constexpr auto targetNames =
+      fields::names(LIB_NAMESPACE::kTargetCompoundFields);
+  static_assert(targetNames.size() == 50);
+  constexpr fields::NameIndex<targetNames.size()> targetIndex(targetNames);
+  static_assert(targetIndex.find("Transition") == targetNames.size() - 2);
+
+  LIB_NAMESPACE::TargetCompound target = {.CompoundID = 9,
+                                          .CompoundName = "Ethanol",
+                                          .MZ = 31.0f,
+                                          .RetentionTime = 0.0f,
+                                          .Transition = 0.0f};
+  target.edit([](auto& settings) { settings.BatchID = 4; });
+  check(target.value(&LIB_NAMESPACE::TargetCompound::CompoundID) == 9u,
+        "target member");
+  check(target.value(&LIB_NAMESPACE::TargetSettings::BatchID) == 4,
+        "settings member");
+  check(&target.value(&LIB_NAMESPACE::TargetCompound::integrationParametersXml)
+            == &target.encodedIntegrationParameters()->Xml,
+        "accessor");
+
+  boost::property_tree::ptree targetTree = target;
+  check(targetTree.size() == targetNames.size(), "target elements");
+  auto element = targetTree.begin();
+  for (auto name : targetNames) {
+    check(element++->first == name, "order of " + std::string(name));
+  }
+
+  std::cout << "Fields: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "scoring/kernel_scorer.hpp"
+
+#include "check.hpp"
+
+// The per-kernel loop LibraryToScore used before the scorer existed.
+double naiveScore(const std::vector<double>& mz,
+                  const std::vector<double>& abundance,
+                  const std::vector<double>& kernel,
+                  const LIB_NAMESPACE::MzTolerance& tolerance)
+{
+  double score = 0;
+  for (auto k : kernel) {
+    for (std::size_t i = 0; i < mz.size(); ++i) {
+      if (std::abs(mz[i] - k) < tolerance.window(k)) {
+        score += abundance[i] / 10000;
+      }
+    }
+  }
+  return score;
+}
+
+int main()
+{
+  std::istringstream file(
+      "# name,ions\n"
+      "\n"
+      "Alkane,29,43,57\n"
+      "Doublet, 100, 100.15\n");
+  auto kernels = LIB_NAMESPACE::readKernels(file);
+  check(kernels.size() == 2 && kernels[1].Name == "Doublet", "readKernels");
+  check(same(kernels[1].MzValues[1], 100.15), "readKernels m/z");
+
+  for (const char* line : {"Odd,nan,100\n", "Odd,inf,100\n"}) {
+    std::istringstream bad(line);
+    bool rejected = false;
+    try {
+      LIB_NAMESPACE::readKernels(bad);
+    } catch (const std::runtime_error&) {
+      rejected = true;
+    }
+    check(rejected, std::string("readKernels rejects ") + line);
+  }
+
+  kernels = LIB_NAMESPACE::defaultKernels();
+  kernels.push_back({"Doublet", {100, 100.15}});
+
+  std::mt19937 random(7);
+  std::uniform_real_distribution<double> offset(-0.2, 0.2);
+
+  for (double tolerance : {0.1, 0.5, 0.013}) {
+    LIB_NAMESPACE::KernelScorer scorer(kernels, tolerance);
+
+    // Peaks clustered on and around the window edges of every kernel ion.
+    std::vector<double> mz;
+    std::vector<double> abundance;
+    for (const auto& kernel : kernels) {
+      for (auto k : kernel.MzValues) {
+        for (double edge : {k - tolerance, k + tolerance, k}) {
+          mz.push_back(edge);
+          mz.push_back(std::nextafter(edge, 0.0));
+          mz.push_back(std::nextafter(edge, 1e9));
+          mz.push_back(edge + offset(random) * tolerance);
+        }
+      }
+    }
+    mz.push_back(NAN);
+    mz.push_back(-5);
+    mz.push_back(1e9);
+    for (std::size_t i = 0; i < mz.size(); ++i) {
+      abundance.push_back(static_cast<double>(i % 97) * 13);
+    }
+
+    std::vector<double> scores(kernels.size());
+    scorer.accumulate(mz, abundance, scores);
+
+    for (std::size_t k = 0; k < kernels.size(); ++k) {
+      double expected =
+          naiveScore(mz, abundance, kernels[k].MzValues, tolerance);
+      check(std::abs(scores[k] - expected) <= 1e-9 * std::abs(expected),
+            kernels[k].Name + " at tolerance " + std::to_string(tolerance));
+    }
+  }
+
+  // ppm windows, with the peaks both in generated order and sorted.
+  for (double ppm : {500.0, 2000.0}) {
+    auto tolerance = LIB_NAMESPACE::MzTolerance::ppm(ppm);
+    LIB_NAMESPACE::KernelScorer scorer(kernels, tolerance);
+
+    std::vector<double> mz;
+    for (const auto& kernel : kernels) {
+      for (auto k : kernel.MzValues) {
+        double window = tolerance.window(k);
+        for (double edge : {k - window, k + window, k}) {
+          mz.push_back(edge);
+          mz.push_back(std::nextafter(edge, 0.0));
+          mz.push_back(std::nextafter(edge, 1e9));
+          mz.push_back(edge + offset(random) * window);
+        }
+      }
+    }
+
+    for (bool sorted : {false, true}) {
+      if (sorted) {
+        std::sort(mz.begin(), mz.end());
+      }
+      std::vector<double> abundance;
+      for (std::size_t i = 0; i < mz.size(); ++i) {
+        abundance.push_back(static_cast<double>(i % 97) * 13);
+      }
+
+      std::vector<double> scores(kernels.size());
+      scorer.accumulate(mz, abundance, scores);
+
+      for (std::size_t k = 0; k < kernels.size(); ++k) {
+        double expected =
+            naiveScore(mz, abundance, kernels[k].MzValues, tolerance);
+        check(std::abs(scores[k] - expected) <= 1e-9 * std::abs(expected),
+              kernels[k].Name + " at " + std::to_string(ppm) + " ppm");
+      }
+    }
+  }
+
+  // Non-finite kernel ions are rejected whatever the tolerance.
+  for (double odd : {static_cast<double>(NAN), static_cast<double>(INFINITY)}) {
+    for (auto tolerance : {LIB_NAMESPACE::MzTolerance(0.1),
+                           LIB_NAMESPACE::MzTolerance::ppm(100)})
+    {
+      bool rejected = false;
+      try {
+        LIB_NAMESPACE::KernelScorer scorer({{"Odd", {odd, 50, 40}}},
+                                           tolerance);
+      } catch (const std::invalid_argument&) {
+        rejected = true;
+      }
+      check(rejected, "non-finite kernel ion is rejected");
+    }
+  }
+
+  // Tolerances far below the spread of the ions, which would need a huge
+  // bin table, still score exactly.
+  for (auto [ion, tolerance] :
+       {std::pair {100.0, 1e-7}, std::pair {1e7, 0.001}})
+  {
+    std::vector<LIB_NAMESPACE::Kernel> wide = {{"Wide", {29, ion}}};
+    LIB_NAMESPACE::KernelScorer scorer(wide, tolerance);
+    std::vector<double> mz = {29, ion + tolerance / 2, ion + 2 * tolerance};
+    std::vector<double> abundance = {10000, 10000, 10000};
+    std::vector<double> scores(1);
+    scorer.accumulate(mz, abundance, scores);
+    check(same(scores[0], 2.0), "wide kernel span");
+  }
+
+  check(same(LIB_NAMESPACE::defaultKernelTolerance(false).Value, 0.1)
+            && same(LIB_NAMESPACE::defaultKernelTolerance(true).Value, 0.5),
+        "default tolerances");
+
+  std::cout << "KernelScorer: OK" << std::endl;
+  return 0;
+}
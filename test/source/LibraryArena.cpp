@@ -0,0 +1,83 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "io/library_generator.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "models/library_arena.hpp"
+#include "profiling/allocation.hpp"
+
+#include "check.hpp"
+
+LIB_NAMESPACE::Library load(const std::string& xml,
+                            std::pmr::memory_resource* resource)
+{
+  std::istringstream input(xml);
+  LIB_NAMESPACE::LibraryReader reader(input);
+  return LIB_NAMESPACE::Library(
+      reader, LIB_NAMESPACE::Projection::All, resource);
+}
+
+int main()
+{
+  LIB_NAMESPACE::GeneratorOptions options;
+  options.Compounds = 300;
+  options.SpectraPerCompound = 2;
+  options.PeaksPerSpectrum = 20;
+
+  std::ostringstream xml;
+  LIB_NAMESPACE::generateLibrary(options, xml);
+  const auto records =
+      options.Compounds + options.Compounds * options.SpectraPerCompound;
+
+  const auto expected = load(xml.str(), std::pmr::get_default_resource());
+
+  LIB_NAMESPACE::allocation::TrackingResource upstream;
+  {
+    LIB_NAMESPACE::LibraryArena arena(1 << 12, &upstream);
+    auto library = load(xml.str(), &arena);
+    check(library.get_allocator().resource() == &arena, "library in arena");
+    check(arena.used() > 0, "arena used");
+
+    // Same content as a load on the default resource.
+    check(library.Compounds.size() == expected.Compounds.size(), "size");
+    for (const auto& [id, compound] : expected.Compounds) {
+      const auto& actual = library.Compounds.at(id);
+      check(actual.CompoundName == compound.CompoundName, "CompoundName");
+      check(actual.Spectra.size() == compound.Spectra.size(), "Spectra");
+      for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+        const auto& other = actual.Spectra.at(spectrumID);
+        check(other.MzValues == spectrum.MzValues, "MzValues");
+        check(other.AbundanceValues == spectrum.AbundanceValues,
+              "AbundanceValues");
+      }
+    }
+
+    // Blocks grow geometrically, so the upstream sees far fewer calls than
+    // there are records and decoded arrays.
+    auto blocks = upstream.usage().Allocations;
+    std::cout << "arena: " << arena.used() << " bytes in " << blocks
+              << " blocks for " << records << " records\n";
+    check(blocks < records / 16, "few upstream blocks");
+
+    // Destroying the library gives nothing back; the arena does, at once.
+    auto held = upstream.usage().Bytes;
+    library = LIB_NAMESPACE::Library(&arena);
+    check(upstream.usage().Bytes == held, "deallocation is a no-op");
+    check(upstream.usage().Deallocations == 0, "nothing freed early");
+
+    arena.release();
+    check(arena.used() == 0, "used reset");
+    check(upstream.usage().Bytes == 0, "release frees every block");
+
+    // The arena is usable again after a release.
+    auto again = load(xml.str(), &arena);
+    check(again.Compounds.size() == expected.Compounds.size(), "reload");
+  }
+  check(upstream.usage().Bytes == 0, "destruction frees every block");
+
+  std::cout << "LibraryArena tests passed\n";
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "io/library_cache.hpp"
+#include "models/library.hpp"
+
+#include "check.hpp"
+
+// Stands in for a pipe or stdout.
+class UnseekableBuffer : public std::stringbuf
+{
+protected:
+  pos_type seekoff(off_type, std::ios::seekdir, std::ios::openmode) override
+  {
+    return pos_type(off_type(-1));
+  }
+
+  pos_type seekpos(pos_type, std::ios::openmode) override
+  {
+    return pos_type(off_type(-1));
+  }
+};
+
+int main()
+{
+  LIB_NAMESPACE::Library library;
+  library.LibraryID = 3;
+  library.AccurateMass = true;
+
+  for (LIB_NAMESPACE::tCompoundID id = 1; id <= 4; ++id) {
+    LIB_NAMESPACE::Compound compound;
+    compound.LibraryID = 3;
+    compound.CompoundID = id * 10;
+    compound.CompoundName = "Compound " + std::to_string(id);
+    compound.CASNumber = std::to_string(id) + "-00-0";
+    compound.RetentionTimeRTL = 1.5f * static_cast<float>(id);
+    library.insert(compound);
+
+    for (LIB_NAMESPACE::tSpectrumID s = 0; s < id; ++s) {
+      LIB_NAMESPACE::Spectrum spectrum;
+      spectrum.LibraryID = 3;
+      spectrum.CompoundID = id * 10;
+      spectrum.SpectrumID = id * 100 + s;
+      spectrum.BasePeakMZ = 40.0f + static_cast<float>(s);
+      for (unsigned int p = 0; p < id + s; ++p) {
+        spectrum.MzValues.push_back(30.0 + p);
+        spectrum.AbundanceValues.push_back(100.0 * p);
+      }
+      // Uneven columns must survive the round trip too.
+      spectrum.AbundanceValues.push_back(1.0);
+      library.insert(spectrum);
+    }
+  }
+
+  const std::string path = "LibraryCache_test.mhlib";
+  LIB_NAMESPACE::writeLibraryCache(library, path);
+  check(LIB_NAMESPACE::isLibraryCache(path), "magic");
+
+  {
+    LIB_NAMESPACE::MappedLibrary mapped(path);
+    check(mapped.libraryID() == 3 && mapped.accurateMass(), "header");
+    check(mapped.compounds().size() == 4, "compounds");
+    check(mapped.spectra().size() == 10, "spectra");
+    check(mapped.find(30) && mapped.find(31) == nullptr, "find");
+    check(mapped.string(mapped.find(30)->CompoundName) == "Compound 3",
+          "strings");
+
+    auto first = mapped.spectra(*mapped.find(40)).front();
+    check(mapped.mzValues(first).size() == 4, "mz span");
+    check(same(mapped.abundanceValues(first).back(), 1.0), "abundance span");
+
+    LIB_NAMESPACE::Library loaded = mapped.toLibrary();
+    check(loaded.Compounds.size() == library.Compounds.size(), "reload");
+    for (const auto& [id, compound] : library.Compounds) {
+      const auto& other = loaded.Compounds.at(id);
+      check(other.CompoundName == compound.CompoundName, "name");
+      check(same(other.RetentionTimeRTL, compound.RetentionTimeRTL), "RT");
+      for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+        const auto& copy = other.Spectra.at(spectrumID);
+        check(copy.MzValues == spectrum.MzValues, "MzValues");
+        check(copy.AbundanceValues == spectrum.AbundanceValues, "Abundance");
+      }
+    }
+  }
+
+  // The stream overload writes front to back: a pipe-like stream that
+  // cannot seek gets the same bytes as the file, and a stream that already
+  // holds data keeps it.
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  const std::string bytes = contents.str();
+  check(!bytes.empty() && bytes.size() % 8 == 0, "file read back");
+
+  UnseekableBuffer pipe;
+  std::ostream piped(&pipe);
+  LIB_NAMESPACE::writeLibraryCache(library, piped);
+  check(pipe.str() == bytes, "unseekable stream");
+
+  std::ostringstream appended("prefix", std::ios::ate);
+  LIB_NAMESPACE::writeLibraryCache(library, appended);
+  check(appended.str() == "prefix" + bytes, "existing contents kept");
+
+  std::remove(path.c_str());
+  std::cout << "LibraryCache: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "io/library_generator.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+
+#include "check.hpp"
+
+std::string generate(const LIB_NAMESPACE::GeneratorOptions& options)
+{
+  std::ostringstream output;
+  LIB_NAMESPACE::generateLibrary(options, output);
+  return output.str();
+}
+
+LIB_NAMESPACE::Library parse(const std::string& xml)
+{
+  std::istringstream input(xml);
+  LIB_NAMESPACE::LibraryReader reader(input);
+  return LIB_NAMESPACE::Library(reader);
+}
+
+void checkLibrary(const LIB_NAMESPACE::GeneratorOptions& options)
+{
+  auto library = parse(generate(options));
+  check(library.AccurateMass == options.AccurateMass, "AccurateMass");
+  check(library.Compounds.size() == options.Compounds, "compound count");
+  for (const auto& [id, compound] : library.Compounds) {
+    check(compound.Spectra.size() == options.SpectraPerCompound,
+          "spectra per compound");
+    check(compound.CompoundName == ("Compound " + std::to_string(id)).c_str(),
+          "name");
+  }
+
+  LIB_NAMESPACE::SpectralStore store(library);
+  check(store.spectrumCount() == options.Compounds * options.SpectraPerCompound,
+        "spectrum count");
+  for (auto spectrum : store.spectra()) {
+    check(spectrum.MzValues.size() == options.PeaksPerSpectrum, "peak count");
+    check(std::is_sorted(spectrum.MzValues.begin(), spectrum.MzValues.end()),
+          "peaks sorted by m/z");
+    for (std::size_t p = 0; p < spectrum.MzValues.size(); ++p) {
+      double mz = spectrum.MzValues[p];
+      check(mz >= options.MinMz && mz <= options.MaxMz,
+            "m/z in range");
+      if (options.Distribution == LIB_NAMESPACE::MzDistribution::Nominal) {
+        check(same(mz, std::round(mz)), "nominal m/z");
+      }
+      check(spectrum.AbundanceValues[p] >= 1
+                && spectrum.AbundanceValues[p] <= 9999,
+            "abundance in range");
+    }
+    check(same(*std::max_element(spectrum.AbundanceValues.begin(),
+                                 spectrum.AbundanceValues.end()),
+               9999),
+          "base peak normalized");
+  }
+}
+
+int main()
+{
+  LIB_NAMESPACE::GeneratorOptions options;
+  options.Compounds = 40;
+  options.SpectraPerCompound = 3;
+  options.PeaksPerSpectrum = 25;
+  checkLibrary(options);
+
+  options.AccurateMass = true;
+  options.Distribution = LIB_NAMESPACE::MzDistribution::Exponential;
+  checkLibrary(options);
+
+  options.AccurateMass = false;
+  options.Distribution = LIB_NAMESPACE::MzDistribution::Nominal;
+  options.MinMz = 50;
+  options.MaxMz = 80;
+  checkLibrary(options);
+
+  // Fractional bounds still give whole masses inside them.
+  options.MinMz = 30.2;
+  options.MaxMz = 32.6;
+  checkLibrary(options);
+  options.MinMz = 50;
+  options.MaxMz = 80;
+
+  // Output is a function of the options alone.
+  auto first = generate(options);
+  check(first == generate(options), "same seed, same bytes");
+  options.Seed = 2;
+  check(first != generate(options), "other seed, other spectra");
+
+  // More compounds than fit in one output buffer.
+  options.Compounds = 3000;
+  options.PeaksPerSpectrum = 60;
+  auto path = (std::filesystem::temp_directory_path()
+               / "MassHunterLibToQuant_generated.mslibrary.xml")
+                  .string();
+  LIB_NAMESPACE::generateLibrary(options, path);
+  check(std::filesystem::file_size(path) > (1 << 20), "multi-buffer output");
+  auto library = LIB_NAMESPACE::readLibrary(path);
+  check(library.Compounds.size() == 3000, "file round trip");
+  std::filesystem::remove(path);
+
+  check(LIB_NAMESPACE::parseMzDistribution("nominal")
+            == LIB_NAMESPACE::MzDistribution::Nominal,
+        "parse distribution");
+  bool threw = false;
+  try {
+    LIB_NAMESPACE::parseMzDistribution("gaussian");
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  check(threw, "unknown distribution rejected");
+
+  threw = false;
+  options.MinMz = 100;
+  options.MaxMz = 100;
+  try {
+    generate(options);
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  check(threw, "empty m/z range rejected");
+
+  threw = false;
+  options.MinMz = 30.2;
+  options.MaxMz = 30.4;
+  try {
+    generate(options);
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  check(threw, "no whole mass in a nominal range rejected");
+
+  threw = false;
+  options.Distribution = LIB_NAMESPACE::MzDistribution::Uniform;
+  options.MaxMz = INFINITY;
+  try {
+    generate(options);
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  check(threw, "infinite m/z range rejected");
+
+  std::cout << "LibraryGenerator: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+
+#include "check.hpp"
+#include "xml.hpp"
+
+// Two peaks each: m/z {41.0, 55.5} and abundance {1000.0, 250.0}.
+const std::string document = R"(<?xml version="1.0" encoding="utf-8"?>
+<!-- exported library -->
+<LibraryDataSet xmlns="http://tempuri.org/LibraryDataSet.xsd">
+  <Library>
+    <LibraryID>7</LibraryID>
+    <AccurateMass>true</AccurateMass>
+  </Library>
+  <Compound>
+    <CompoundID>1</CompoundID>
+    <CompoundName>Acetone &amp; &lt;friends&gt; &#65;</CompoundName>
+    <Formula>C3H6O</Formula>
+    <RetentionTimeRTL>2.5</RetentionTimeRTL>
+  </Compound>
+  <Compound>
+    <CompoundID>2</CompoundID>
+    <CompoundName><![CDATA[Bromo<ethane>]]></CompoundName>
+  </Compound>
+  <Spectrum>
+    <CompoundID>1</CompoundID>
+    <SpectrumID>10</SpectrumID>
+    <BasePeakMZ>41</BasePeakMZ>
+    <MzValues>AAAAAACAREAAAAAAAMBLQA==</MzValues>
+    <AbundanceValues>AAAAAABAj0AAAAAAAEBvQA==</AbundanceValues>
+  </Spectrum>
+  <Spectrum>
+    <CompoundID>2</CompoundID>
+    <SpectrumID>20</SpectrumID>
+    <BasePeakMZ>55.5</BasePeakMZ>
+    <MzValues>AAAAAACAREAAAAAAAMBLQA==</MzValues>
+    <AbundanceValues>AAAAAABAj0AAAAAAAEBvQA==</AbundanceValues>
+  </Spectrum>
+</LibraryDataSet>
+)";
+
+int main()
+{
+  LIB_NAMESPACE::Library expected(parse(document));
+
+  std::istringstream streamInput(document);
+  LIB_NAMESPACE::LibraryReader reader(streamInput);
+  LIB_NAMESPACE::Library library(reader);
+
+  check(!library.Compounds.at(1).Spectra.at(10).MzValues.decoded(), "lazy");
+  check(library.LibraryID == 7, "LibraryID");
+  check(library.AccurateMass, "AccurateMass");
+  check(library.Compounds.size() == expected.Compounds.size(), "size");
+
+  for (const auto& [id, compound] : expected.Compounds) {
+    const auto& actual = library.Compounds.at(id);
+    check(actual.CompoundName == compound.CompoundName, "CompoundName");
+    check(actual.Formula == compound.Formula, "Formula");
+    check(actual.Spectra.size() == compound.Spectra.size(), "Spectra");
+
+    for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+      const auto& other = actual.Spectra.at(spectrumID);
+      check(other.MzValues == spectrum.MzValues, "MzValues");
+      check(other.AbundanceValues == spectrum.AbundanceValues,
+            "AbundanceValues");
+    }
+  }
+
+  check(library.Compounds.at(1).CompoundName == "Acetone & <friends> A",
+        "entities");
+  check(library.Compounds.at(2).CompoundName == "Bromo<ethane>", "CDATA");
+  check(library.Compounds.at(1).Spectra.at(10).MzValues.size() == 2, "peaks");
+  check(same(library.Compounds.at(1).Spectra.at(10).MzValues[1], 55.5), "m/z");
+
+  // Projected loads keep metadata but drop the peak columns entirely.
+  std::istringstream projectedInput(document);
+  LIB_NAMESPACE::LibraryReader projectedReader(projectedInput);
+  LIB_NAMESPACE::Library projected(projectedReader,
+                                   LIB_NAMESPACE::Projection::Metadata);
+  const auto& metadata = projected.Compounds.at(2).Spectra.at(20);
+  check(same(metadata.BasePeakMZ, 55.5f), "projected metadata");
+  check(metadata.MzValues.empty() && metadata.AbundanceValues.empty(),
+        "projected peaks");
+
+  // Trees are reused from record to record, yet each matches what read_xml
+  // makes of the same element, whatever the one before it looked like.
+  const std::string varied =
+      "<Root><Other a=\"1\"><X>1</X><Y>y</Y><Z/></Other>"
+      "<Other><X>2</X></Other>"
+      "<Other b=\"2\"><Y><X>deep</X></Y><X>3</X></Other>"
+      "<Other/>"
+      "<Compound><CompoundID>4</CompoundID><Formula>CH4</Formula></Compound>"
+      "<Compound><Formula>C2H6</Formula></Compound></Root>";
+  auto variedTree = parse(varied);
+  std::istringstream variedInput(varied);
+  LIB_NAMESPACE::LibraryReader variedReader(variedInput);
+  auto element = variedTree.get_child("Root").begin();
+  for (auto record = variedReader.next();
+       record != LIB_NAMESPACE::LibraryReader::Record::End;
+       record = variedReader.next(), ++element)
+  {
+    check(variedReader.name() == element->first, "record name");
+    check(variedReader.tree() == element->second, "reused tree");
+  }
+  check(element == variedTree.get_child("Root").end(), "record count");
+
+  // As with the ptree loader, the first <Library> names the library of
+  // every compound, even one that comes before it.
+  const std::string late =
+      "<LibraryDataSet><Compound><CompoundID>1</CompoundID></Compound>"
+      "<Library><LibraryID>7</LibraryID></Library>"
+      "<Compound><CompoundID>2</CompoundID></Compound>"
+      "<Library><LibraryID>8</LibraryID></Library></LibraryDataSet>";
+  std::istringstream lateInput(late);
+  LIB_NAMESPACE::LibraryReader lateReader(lateInput);
+  LIB_NAMESPACE::Library lateLibrary(lateReader);
+  LIB_NAMESPACE::Library lateExpected(parse(late));
+  check(lateLibrary.LibraryID == 7 && lateExpected.LibraryID == 7,
+        "first library");
+  for (auto id : {1u, 2u}) {
+    check(lateLibrary.Compounds.at(id).LibraryID
+              == lateExpected.Compounds.at(id).LibraryID,
+          "library of compound " + std::to_string(id));
+  }
+
+  // Other documents are not libraries.
+  std::istringstream foreignInput("<?xml version=\"1.0\"?>\n<Root>"
+                                  "<Compound><CompoundID>1</CompoundID>"
+                                  "</Compound></Root>");
+  LIB_NAMESPACE::LibraryReader foreignReader(foreignInput);
+  bool foreign = false;
+  try {
+    LIB_NAMESPACE::Library foreignLibrary(foreignReader);
+  } catch (const boost::property_tree::xml_parser_error& e) {
+    foreign = e.line() == 2;
+  }
+  check(foreign, "root element");
+
+  // A spectrum referring to an unknown compound is still rejected.
+  std::istringstream orphanInput(
+      "<LibraryDataSet><Spectrum><CompoundID>3</CompoundID></Spectrum>"
+      "</LibraryDataSet>");
+  LIB_NAMESPACE::LibraryReader orphanReader(orphanInput);
+  bool rejected = false;
+  try {
+    LIB_NAMESPACE::Library orphan(orphanReader);
+  } catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  check(rejected, "orphan spectrum");
+
+  // Character references that are not code points fail as XML errors, on
+  // their line, in text and in attributes alike.
+  for (const std::string reference :
+       {"&#xZZ;", "&#;", "&#-1;", "&#x110000;", "&#99999999999999999999;"})
+  {
+    for (const std::string& bad :
+         {"<LibraryDataSet>\n<Compound><CompoundName>" + reference
+              + "</CompoundName></Compound></LibraryDataSet>",
+          "<LibraryDataSet>\n<Compound a=\"" + reference
+              + "\"/></LibraryDataSet>"})
+    {
+      std::istringstream badInput(bad);
+      LIB_NAMESPACE::LibraryReader badReader(badInput);
+      bool failed = false;
+      try {
+        LIB_NAMESPACE::Library badLibrary(badReader);
+      } catch (const boost::property_tree::xml_parser_error& e) {
+        failed = e.line() == 2;
+      }
+      check(failed, "character reference " + reference);
+    }
+  }
+
+  std::cout << "LibraryReader: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "io/library_generator.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "profiling/allocation.hpp"
+#include "profiling/heap_counter.hpp"
+
+#include "check.hpp"
+
+// Pins how many allocations a library load performs, so that a change
+// bringing back per-record tree copies or reallocating peak arrays fails
+// here rather than in production memory graphs.
+
+// Global-heap allocations measured for a sequential load: two per record
+// plus a fixed cost for the reader's reused trees and buffers. Deep ptree
+// copies per record would add well over 50. The slack absorbs standard
+// library differences in the fixed cost, not an extra allocation per record.
+constexpr std::uint64_t kHeapPerRecord = 2;
+constexpr std::uint64_t kHeapFixed = 135;
+constexpr std::uint64_t kHeapSlack = 16;
+
+int main()
+{
+  LIB_NAMESPACE::GeneratorOptions options;
+  options.Compounds = 200;
+  options.SpectraPerCompound = 2;
+  options.PeaksPerSpectrum = 50;
+
+  std::ostringstream xml;
+  LIB_NAMESPACE::generateLibrary(options, xml);
+  const auto spectra = options.Compounds * options.SpectraPerCompound;
+  const auto records = options.Compounds + spectra;
+
+  std::istringstream input(xml.str());
+  LIB_NAMESPACE::allocation::TrackingResource resource;
+  auto before = LIB_NAMESPACE::allocation::heapAllocations();
+  {
+    LIB_NAMESPACE::LibraryReader reader(input);
+    LIB_NAMESPACE::Library library(
+        reader, LIB_NAMESPACE::Projection::All, &resource);
+    auto heap = LIB_NAMESPACE::allocation::heapAllocations() - before;
+
+    // In the library's resource: one map node per record, and the names
+    // fit in the strings' inline buffers.
+    auto loaded = resource.usage().Allocations;
+    std::cout << "load: " << loaded << " in the library, " << heap
+              << " on the heap for " << records << " records\n";
+    check(loaded == records, "one allocation per record");
+    auto expected = records * kHeapPerRecord + kHeapFixed;
+    check(heap + kHeapSlack >= expected && heap <= expected + kHeapSlack,
+          "heap allocations per record");
+
+    // Each peak array is then allocated once, at its final size.
+    for (const auto& [id, compound] : library.Compounds) {
+      for (const auto& [spectrumID, spectrum] : compound.Spectra) {
+        check(spectrum.MzValues.size() == options.PeaksPerSpectrum, "peaks");
+        check(spectrum.AbundanceValues.values().capacity()
+                  == options.PeaksPerSpectrum,
+              "exact capacity");
+      }
+    }
+    check(resource.usage().Allocations == records + 2 * spectra,
+          "one allocation per decoded array");
+  }
+  check(resource.usage().Bytes == 0, "everything returned");
+
+  // Moving a loaded library allocates nothing.
+  {
+    std::istringstream again(xml.str());
+    LIB_NAMESPACE::LibraryReader reader(again);
+    LIB_NAMESPACE::Library library(
+        reader, LIB_NAMESPACE::Projection::Metadata, &resource);
+    auto start = LIB_NAMESPACE::allocation::heapAllocations();
+    auto tracked = resource.usage().Allocations;
+    LIB_NAMESPACE::Library moved(std::move(library));
+    // Read before check() builds its message.
+    auto heap = LIB_NAMESPACE::allocation::heapAllocations() - start;
+    check(heap == 0, "move allocates on the heap");
+    check(resource.usage().Allocations == tracked, "move allocates");
+  }
+
+  std::cout << "LoadAllocations tests passed\n";
+  return 0;
+}
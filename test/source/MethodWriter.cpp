@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+#include "io/method_writer.hpp"
+#include "models/library.hpp"
+#include "models/method.hpp"
+
+#include "check.hpp"
+
+std::string viaPtree(const LIB_NAMESPACE::QuantitationDataSet& method)
+{
+  std::ostringstream output;
+  boost::property_tree::write_xml(
+      output,
+      static_cast<boost::property_tree::ptree>(method),
+      boost::property_tree::xml_writer_make_settings<std::string>(' ', 4));
+  return output.str();
+}
+
+std::string viaWriter(const LIB_NAMESPACE::QuantitationDataSet& method)
+{
+  std::ostringstream output;
+  LIB_NAMESPACE::writeMethod(method, output);
+  return output.str();
+}
+
+LIB_NAMESPACE::TargetCompound target(unsigned int id, std::string name)
+{
+  return {.CompoundID = id,
+          .CompoundName = std::move(name),
+          .MZ = 57.0703125f + static_cast<float>(id) / 7,
+          .RetentionTime = 12.3456789f * static_cast<float>(id),
+          .Transition = 0.1f};
+}
+
+int main()
+{
+  LIB_NAMESPACE::QuantitationDataSet method;
+  check(viaWriter(method) == viaPtree(method), "method without targets");
+
+  method.Targets.push_back(target(1, "Plain"));
+  method.Targets.push_back(target(2, "Q&A <\"quoted\"> 'x'"));
+  method.Targets.push_back(target(3, ""));
+  method.Targets.push_back(target(4, "   "));
+  method.Targets.push_back(target(5, " padded "));
+  method.Targets.push_back(target(6, "multi\nline\ttext"));
+
+  method.Targets.back().edit(
+      [](LIB_NAMESPACE::TargetSettings& tweaked)
+      {
+        tweaked.BatchID = -123456;
+        tweaked.NoiseOfRawSignal = 1e-30f;
+        tweaked.SelectedMZ = -0.0f;
+        tweaked.Multiplier = 3.4e38f;
+        tweaked.ISTDFlag = true;
+        tweaked.IonPolarity = "";
+        auto& parameters = tweaked.IntegrationParameters.ParameterSet;
+        parameters.attrs.usageKey = "a\"b";
+        parameters.Smoothing.Default.reset();
+        parameters.BaselineReset.Limits->Minimum.value = "";
+        parameters.DataPointSampling.DisplayName = " ";
+      });
+
+  method.attr.AnalystName = "O'Neil & <Co>";
+  method.attr.BatchName = "  ";
+  method.attr.RelativeISTD = true;
+
+  std::string expected = viaPtree(method);
+  check(viaWriter(method) == expected, "method with edge-case targets");
+
+  std::string path = "MethodWriter_test.xml";
+  {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    check(file != nullptr, "open output file");
+    LIB_NAMESPACE::writeMethod(method, fileno(file));
+    std::fclose(file);
+  }
+  std::ifstream input(path, std::ios::binary);
+  std::string written((std::istreambuf_iterator<char>(input)),
+                      std::istreambuf_iterator<char>());
+  input.close();
+  std::remove(path.c_str());
+  check(written == expected, "method written to a file descriptor");
+
+  // Targets built from a library share the default settings, so building
+  // them encodes nothing.
+  auto& cache = LIB_NAMESPACE::ParameterSetCache::instance();
+  cache.clear();
+
+  LIB_NAMESPACE::Library library;
+  for (unsigned int id = 1; id <= 10; ++id) {
+    LIB_NAMESPACE::Compound compound;
+    compound.CompoundID = id;
+    compound.CompoundName = "Compound " + std::to_string(id);
+    library.insert(compound);
+
+    LIB_NAMESPACE::Spectrum spectrum;
+    spectrum.CompoundID = id;
+    spectrum.SpectrumID = id;
+    spectrum.BasePeakMZ = 40.0f + static_cast<float>(id);
+    library.insert(spectrum);
+  }
+
+  LIB_NAMESPACE::QuantitationDataSet built(library);
+  const auto& defaults = LIB_NAMESPACE::SharedTargetSettings::defaults();
+  check(built.Targets[0].Settings == defaults
+            && built.Targets[9].Settings == defaults,
+        "targets share the default settings");
+  check(cache.hits() == 0 && cache.misses() == 0, "nothing encoded");
+  check(sizeof(LIB_NAMESPACE::TargetCompound) <= 128, "compact target");
+
+  // An edit gives the target its own settings and leaves the others alone.
+  auto setThreshold = [](LIB_NAMESPACE::TargetSettings& settings)
+  { settings.IntegrationParameters.ParameterSet.StartThreshold.Value = "0.5"; };
+  built.Targets[3].edit(setThreshold);
+  check(built.Targets[3].Settings != defaults, "edited target");
+  check(built.Targets[2].Settings == defaults, "other targets untouched");
+  check(built.Targets[3].encodedIntegrationParameters()->Xml.find(
+            "<Value>0.5</Value>")
+            != std::string::npos,
+        "edited parameter set is encoded");
+  check(defaults->Values.IntegrationParameters.ParameterSet.StartThreshold
+                .Value
+            == "0.2",
+        "defaults unchanged");
+
+  // The same edit elsewhere reuses the encoding, and undoing an edit goes
+  // back to the shared defaults.
+  built.Targets[4].edit(setThreshold);
+  check(built.Targets[4].encodedIntegrationParameters()
+            == built.Targets[3].encodedIntegrationParameters(),
+        "edited parameter set encoded once");
+  check(cache.size() == 1 && cache.misses() == 1 && cache.hits() == 1,
+        "cache counters");
+  check(same(cache.hitRate(), 0.5), "hit rate");
+  built.Targets[4].edit(
+      [](LIB_NAMESPACE::TargetSettings& settings)
+      {
+        settings.IntegrationParameters.ParameterSet.StartThreshold.Value =
+            "0.2";
+      });
+  check(built.Targets[4].Settings == defaults, "reverted to defaults");
+  check(viaWriter(built) == viaPtree(built), "method built from a library");
+
+  // Parallel build and serialization produce the serial bytes.
+  std::string serial = viaWriter(built);
+  for (unsigned threads : {2u, 4u, 16u}) {
+    LIB_NAMESPACE::QuantitationDataSet parallel(library, threads);
+    parallel.Targets[3].edit(setThreshold);
+
+    std::ostringstream output;
+    LIB_NAMESPACE::writeMethod(parallel, output, threads);
+    check(output.str() == serial,
+          "parallel method with " + std::to_string(threads) + " threads");
+  }
+  {
+    std::ostringstream output;
+    LIB_NAMESPACE::writeMethod(LIB_NAMESPACE::QuantitationDataSet(), output, 4);
+    check(output.str() == viaPtree(LIB_NAMESPACE::QuantitationDataSet()),
+          "parallel method without targets");
+  }
+
+  // A compound without spectra is reported from the worker threads too.
+  LIB_NAMESPACE::Compound empty;
+  empty.CompoundID = 11;
+  library.insert(empty);
+  for (unsigned threads : {1u, 4u}) {
+    bool reported = false;
+    try {
+      LIB_NAMESPACE::QuantitationDataSet failed(library, threads);
+    } catch (const std::runtime_error& e) {
+      reported = std::string(e.what()) == "Compound 11 has no spectra";
+    }
+    check(reported, "compound without spectra");
+  }
+
+  std::cout << "MethodWriter: OK" << std::endl;
+  return 0;
+}
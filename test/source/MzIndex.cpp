@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "index/mz_index.hpp"
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+
+#include "check.hpp"
+
+int main()
+{
+  std::mt19937 random(5);
+  std::uniform_real_distribution<double> mz(29, 400);
+  std::uniform_real_distribution<double> abundance(0, 9999);
+
+  LIB_NAMESPACE::Library library;
+  for (LIB_NAMESPACE::tCompoundID id = 1; id <= 200; ++id) {
+    LIB_NAMESPACE::Compound compound;
+    compound.CompoundID = id;
+    library.insert(compound);
+
+    for (LIB_NAMESPACE::tSpectrumID s = 0; s < 1 + id % 2; ++s) {
+      LIB_NAMESPACE::Spectrum spectrum;
+      spectrum.CompoundID = id;
+      spectrum.SpectrumID = id * 10 + s;
+      for (int p = 0; p < 30; ++p) {
+        // Half the peaks on nominal masses, so many postings share an m/z.
+        double value = p % 2 ? std::round(mz(random)) : mz(random);
+        spectrum.MzValues.push_back(value);
+        spectrum.AbundanceValues.push_back(abundance(random));
+      }
+      library.insert(spectrum);
+    }
+  }
+  LIB_NAMESPACE::SpectralStore store(library);
+
+  // Brute force over the store for comparison.
+  auto expected = [&](double target, double tolerance, float minimum)
+  {
+    std::multiset<std::pair<double, LIB_NAMESPACE::tSpectrumID>> result;
+    for (auto spectrum : store.spectra()) {
+      double base = *std::max_element(spectrum.AbundanceValues.begin(),
+                                      spectrum.AbundanceValues.end());
+      for (std::size_t i = 0; i < spectrum.MzValues.size(); ++i) {
+        auto relative =
+            static_cast<float>(spectrum.AbundanceValues[i] / base);
+        if (std::abs(spectrum.MzValues[i] - target) <= tolerance
+            && relative > 0 && relative >= minimum)
+        {
+          result.insert({spectrum.MzValues[i], spectrum.SpectrumID});
+        }
+      }
+    }
+    return result;
+  };
+
+  for (double binWidth : {0.1, 1.0, 0.013}) {
+    LIB_NAMESPACE::MzIndex index(store, binWidth);
+
+    for (double target : {29.0, 43.0, 57.05, 100.5, 399.9, 401.0, 10.0}) {
+      for (double tolerance : {0.0, 0.005, 0.5, 3.0}) {
+        for (float minimum : {0.0f, 0.5f}) {
+          auto postings = index.query(target, tolerance, minimum);
+          std::multiset<std::pair<double, LIB_NAMESPACE::tSpectrumID>> found;
+          for (const auto& posting : postings) {
+            found.insert({posting.MzValue, posting.SpectrumID});
+            check(posting.SpectrumID / 10 == posting.CompoundID,
+                  "posting compound");
+          }
+          check(found == expected(target, tolerance, minimum),
+                "range query at " + std::to_string(target));
+          check(std::is_sorted(postings.begin(),
+                               postings.end(),
+                               [](const auto& a, const auto& b)
+                               { return a.MzValue < b.MzValue; }),
+                "postings sorted by m/z");
+        }
+      }
+    }
+
+    // Every compound near both ions, by brute force.
+    std::vector<double> ions = {57.0, 71.0};
+    std::set<LIB_NAMESPACE::tCompoundID> first;
+    std::set<LIB_NAMESPACE::tCompoundID> both;
+    for (const auto& [mzValue, spectrumID] : expected(ions[0], 0.5, 0.1f)) {
+      first.insert(spectrumID / 10);
+    }
+    for (const auto& [mzValue, spectrumID] : expected(ions[1], 0.5, 0.1f)) {
+      if (first.count(spectrumID / 10)) {
+        both.insert(spectrumID / 10);
+      }
+    }
+    auto compounds = index.intersect(ions, 0.5, 0.1f);
+    check(std::vector<LIB_NAMESPACE::tCompoundID>(both.begin(), both.end())
+              == compounds,
+          "multi-ion intersection");
+    check(!compounds.empty(), "intersection is exercised");
+  }
+
+  // 29-400 Da in bins of 1e-6 Da would be 3.7e8 bins.
+  bool bounded = false;
+  try {
+    LIB_NAMESPACE::MzIndex tiny(store, 1e-6);
+  } catch (const std::length_error&) {
+    bounded = true;
+  }
+  check(bounded, "bin count is bounded");
+
+  // Persistence round trip.
+  LIB_NAMESPACE::MzIndex index(store, 0.1, 0.05f);
+  std::stringstream file;
+  LIB_NAMESPACE::writeMzIndex(index, file);
+  auto loaded = LIB_NAMESPACE::readMzIndex(file);
+  check(loaded.binCount() == index.binCount(), "bins survive");
+  check(loaded.postings().size() == index.postings().size(),
+        "postings survive");
+  check(loaded.query(43, 0.5).size() == index.query(43, 0.5).size(),
+        "loaded index answers queries");
+
+  std::stringstream garbage("not an index");
+  bool rejected = false;
+  try {
+    LIB_NAMESPACE::readMzIndex(garbage);
+  } catch (const std::runtime_error&) {
+    rejected = true;
+  }
+  check(rejected, "bad magic rejected");
+
+  // Corrupt headers and bin tables; the header is 48 bytes with Origin at
+  // offset 16, BinWidth at 24, BinCount at 32 and PostingCount at 40.
+  auto rejects = [&](std::string bytes, const std::string& message)
+  {
+    std::stringstream corrupt(std::move(bytes));
+    try {
+      LIB_NAMESPACE::readMzIndex(corrupt);
+    } catch (const std::runtime_error& e) {
+      return message == e.what();
+    }
+    return false;
+  };
+  const std::string valid = file.str();
+  const std::uint64_t huge = std::uint64_t(1) << 60;
+  std::string hugeBins = valid;
+  std::memcpy(hugeBins.data() + 32, &huge, sizeof(huge));
+  check(rejects(hugeBins, "m/z index is truncated"), "huge bin count");
+  std::string hugePostings = valid;
+  std::memcpy(hugePostings.data() + 40, &huge, sizeof(huge));
+  check(rejects(hugePostings, "m/z index is truncated"),
+        "huge posting count");
+  check(rejects(valid.substr(0, valid.size() - 1), "m/z index is truncated"),
+        "short postings");
+
+  for (auto [offset, value] : {std::pair {16, static_cast<double>(NAN)},
+                               std::pair {24, 0.0},
+                               std::pair {24, -0.1},
+                               std::pair {24, static_cast<double>(NAN)}})
+  {
+    std::string bad = valid;
+    std::memcpy(bad.data() + offset, &value, sizeof(value));
+    check(rejects(bad, "m/z index header is corrupt"),
+          "bad origin or bin width");
+  }
+
+  // Reserved fields are written as zeros, so equal indexes give equal files.
+  std::stringstream again;
+  LIB_NAMESPACE::writeMzIndex(loaded, again);
+  check(again.str() == valid, "reproducible index file");
+  for (const auto& posting : loaded.postings()) {
+    check(posting.Reserved == 0, "reserved posting field");
+  }
+
+  std::string decreasing = valid;
+  std::uint32_t starts[2] = {};
+  std::memcpy(starts, decreasing.data() + 48, sizeof(starts));
+  check(starts[1] > 0, "second bin start is past the first");
+  std::swap(starts[0], starts[1]);
+  std::memcpy(decreasing.data() + 48, starts, sizeof(starts));
+  check(rejects(decreasing, "m/z index bin table is corrupt"),
+        "decreasing bin starts");
+
+  // The bin table must cover exactly the postings, which must be in m/z
+  // order: an empty bin table over postings would leave range() nothing to
+  // index.
+  std::string binless(valid.substr(0, 48));
+  const std::uint64_t noBins = 0;
+  const std::uint64_t onePosting = 1;
+  std::memcpy(binless.data() + 32, &noBins, sizeof(noBins));
+  std::memcpy(binless.data() + 40, &onePosting, sizeof(onePosting));
+  LIB_NAMESPACE::Posting stray = {100.05, 1, 10, 1, 0};
+  binless.append(reinterpret_cast<const char*>(&stray), sizeof(stray));
+  check(binless.size() == 72, "one posting without bins");
+  check(rejects(binless, "m/z index bin table is corrupt"),
+        "postings without bins");
+
+  std::uint64_t binCount = 0;
+  std::memcpy(&binCount, valid.data() + 32, sizeof(binCount));
+  const std::size_t lastStart = 48 + 4 * binCount;
+  const std::size_t postingsAt = lastStart + 4;
+  std::string uncovered = valid;
+  std::uint32_t last = 0;
+  std::memcpy(&last, uncovered.data() + lastStart, sizeof(last));
+  --last;
+  std::memcpy(uncovered.data() + lastStart, &last, sizeof(last));
+  check(rejects(uncovered, "m/z index bin table is corrupt"),
+        "bin table short of the postings");
+
+  std::string unsorted = valid;
+  std::swap_ranges(unsorted.begin() + static_cast<std::ptrdiff_t>(postingsAt),
+                   unsorted.begin()
+                       + static_cast<std::ptrdiff_t>(postingsAt + 24),
+                   unsorted.end() - 24);
+  check(rejects(unsorted, "m/z index bin table is corrupt"),
+        "postings out of m/z order");
+
+  check(LIB_NAMESPACE::MzIndex().query(43, 1).empty(), "empty index");
+
+  const double ions[] = {43.0, static_cast<double>(NAN)};
+  check(index.query(NAN, 0.5).empty(), "NaN query");
+  check(index.query(INFINITY, 0.5).empty(), "infinite query");
+  check(index.intersect(ions, 0.5).empty(), "NaN ion");
+
+  std::cout << "MzIndex: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "matching/mz_match.hpp"
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+
+#include "check.hpp"
+
+bool rejects(std::string_view text)
+{
+  try {
+    LIB_NAMESPACE::parseMzTolerance(text);
+  } catch (const std::invalid_argument&) {
+    return true;
+  }
+  return false;
+}
+
+int main()
+{
+  using LIB_NAMESPACE::MzTolerance;
+  using LIB_NAMESPACE::ToleranceUnit;
+
+  check(LIB_NAMESPACE::parseMzTolerance("0.1") == MzTolerance(0.1), "bare Da");
+  check(LIB_NAMESPACE::parseMzTolerance(" 0.25 da ") == MzTolerance(0.25),
+        "Da suffix");
+  check(LIB_NAMESPACE::parseMzTolerance("20ppm") == MzTolerance::ppm(20),
+        "ppm suffix");
+  check(LIB_NAMESPACE::parseMzTolerance("5 PPM").Unit == ToleranceUnit::Ppm,
+        "unit case");
+  check(rejects("") && rejects("ppm") && rejects("-1") && rejects("0")
+            && rejects("0.1 mDa") && rejects("nan"),
+        "bad tolerances rejected");
+
+  check(same(MzTolerance::ppm(10).window(500), 0.005), "ppm window");
+  check(same(MzTolerance(0.1).window(500), 0.1), "Da window");
+  check(MzTolerance::ppm(10).matches(500, 500.005)
+            && !MzTolerance::ppm(10).matches(500, 500.0051),
+        "ppm window is closed");
+
+  // gallop against lower_bound from every start.
+  std::vector<double> values = {1, 2, 2, 2, 5, 8, 8, 13, 21, 34, 55};
+  for (std::size_t from = 0; from <= values.size(); ++from) {
+    for (double target : {0.0, 2.0, 3.0, 8.0, 55.0, 56.0}) {
+      auto expected = static_cast<std::size_t>(
+          std::lower_bound(values.begin() + static_cast<std::ptrdiff_t>(from),
+                           values.end(),
+                           target)
+          - values.begin());
+      check(LIB_NAMESPACE::gallop(values, from, target) == expected,
+            "gallop from " + std::to_string(from));
+    }
+  }
+
+  std::vector<double> mz = {5, 3, NAN, 3, 1};
+  std::vector<double> abundance = {50, 30, 99, 31, 10};
+  check(!LIB_NAMESPACE::sortedByMz(mz), "unsorted detected");
+  LIB_NAMESPACE::sortPeaks(mz, abundance);
+  check(same(mz[0], 1) && same(mz[1], 3) && same(mz[2], 3) && same(mz[3], 5)
+            && std::isnan(mz[4]),
+        "sortPeaks orders m/z with NaN last");
+  check(abundance == std::vector<double>({10, 30, 31, 50, 99}),
+        "sortPeaks keeps pairs and ties");
+  check(LIB_NAMESPACE::sortedByMz(std::vector<double>({1, 1, 2})),
+        "sorted detected");
+
+  // forEachMatch against all pairs, sorted and unsorted, Da and ppm.
+  std::mt19937 random(3);
+  std::uniform_real_distribution<double> uniform(20, 600);
+  std::vector<double> ions;
+  for (int i = 0; i < 60; ++i) {
+    ions.push_back(std::round(uniform(random)));
+  }
+  std::sort(ions.begin(), ions.end());
+
+  for (auto tolerance : {MzTolerance(0.3), MzTolerance::ppm(800)}) {
+    std::vector<double> peaks;
+    for (auto ion : ions) {
+      double window = tolerance.window(ion);
+      peaks.push_back(ion + window);
+      peaks.push_back(std::nextafter(ion + window, 1e9));
+      peaks.push_back(ion - window);
+      peaks.push_back(ion + window * 0.3);
+    }
+    for (int i = 0; i < 400; ++i) {
+      peaks.push_back(uniform(random));
+    }
+    peaks.push_back(NAN);
+
+    for (bool sorted : {false, true}) {
+      if (sorted) {
+        peaks.pop_back();
+        std::sort(peaks.begin(), peaks.end());
+      }
+
+      std::set<std::pair<std::size_t, std::size_t>> expected;
+      for (std::size_t i = 0; i < ions.size(); ++i) {
+        for (std::size_t p = 0; p < peaks.size(); ++p) {
+          if (tolerance.matches(ions[i], peaks[p])) {
+            expected.insert({i, p});
+          }
+        }
+      }
+
+      std::set<std::pair<std::size_t, std::size_t>> found;
+      std::size_t visits = 0;
+      LIB_NAMESPACE::forEachMatch(ions,
+                                  peaks,
+                                  tolerance,
+                                  [&](std::size_t ion, std::size_t peak)
+                                  {
+                                    found.insert({ion, peak});
+                                    ++visits;
+                                  });
+      check(found == expected && visits == expected.size(),
+            std::string("forEachMatch, ") + (sorted ? "sorted" : "unsorted"));
+    }
+  }
+
+  // A SpectralStore sorts each spectrum's peaks at ingest.
+  LIB_NAMESPACE::Library library;
+  LIB_NAMESPACE::Compound compound;
+  compound.CompoundID = 1;
+  library.insert(compound);
+  for (LIB_NAMESPACE::tSpectrumID id : {1u, 2u}) {
+    LIB_NAMESPACE::Spectrum spectrum;
+    spectrum.CompoundID = 1;
+    spectrum.SpectrumID = id;
+    spectrum.MzValues = std::vector<double>({90.0 + id, 40, 70});
+    spectrum.AbundanceValues = std::vector<double>({1, 2, 3});
+    library.insert(spectrum);
+  }
+  LIB_NAMESPACE::SpectralStore store(library);
+  for (auto spectrum : store.spectra()) {
+    check(LIB_NAMESPACE::sortedByMz(spectrum.MzValues), "store sorted");
+    check(same(spectrum.AbundanceValues[2], 1)
+              && same(spectrum.MzValues[0], 40),
+          "store keeps pairs");
+  }
+
+  std::cout << "MzMatch: OK" << std::endl;
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <locale>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+
+#include "io/numeric.hpp"
+
+#include "check.hpp"
+
+namespace numeric = LIB_NAMESPACE::numeric;
+
+// Formats and parses back, comparing bits so that -0 and NaN payloads count.
+template<typename T, typename Bits>
+bool roundTrips(T value)
+{
+  auto parsed = numeric::parse<T>(numeric::toString(value));
+  return parsed && std::bit_cast<Bits>(*parsed) == std::bit_cast<Bits>(value);
+}
+
+// A decimal comma and digit grouping, which iostreams would apply.
+struct CommaPunct : std::numpunct<char>
+{
+  char do_decimal_point() const override { return ','; }
+  char do_thousands_sep() const override { return '.'; }
+  std::string do_grouping() const override { return "\3"; }
+};
+
+int main()
+{
+  // Every bit pattern but NaN comes back unchanged.
+  std::mt19937_64 random(42);
+  for (int i = 0; i < 1000000; ++i) {
+    auto bits = random();
+    auto single = std::bit_cast<float>(static_cast<std::uint32_t>(bits));
+    auto twice = std::bit_cast<double>(bits);
+    if (!std::isnan(single)) {
+      check(roundTrips<float, std::uint32_t>(single),
+            "float " + std::to_string(single));
+    }
+    if (!std::isnan(twice)) {
+      check(roundTrips<double, std::uint64_t>(twice),
+            "double " + std::to_string(twice));
+    }
+  }
+
+  for (float value : {0.0f,
+                      -0.0f,
+                      std::numeric_limits<float>::denorm_min(),
+                      std::numeric_limits<float>::min(),
+                      std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::lowest(),
+                      std::numeric_limits<float>::infinity(),
+                      -std::numeric_limits<float>::infinity()})
+  {
+    check(roundTrips<float, std::uint32_t>(value), "special float");
+  }
+  check(std::isnan(*numeric::parse<float>(
+            numeric::toString(std::numeric_limits<float>::quiet_NaN()))),
+        "NaN");
+
+  // Shortest form, not max_digits10.
+  check(numeric::toString(0.1f) == "0.1", "shortest 0.1f");
+  check(numeric::toString(35.649809837341309f) == "35.64981", "shortest");
+  check(numeric::toString(1e-30f) == "1e-30", "scientific");
+  check(numeric::toString(-0.0f) == "-0", "negative zero");
+
+  check(numeric::toString(std::numeric_limits<int>::min()) == "-2147483648",
+        "int min");
+  check(numeric::toString(std::numeric_limits<std::uint64_t>::max())
+            == "18446744073709551615",
+        "uint64 max");
+  check(numeric::toString(true) == "true" && numeric::toString(false) == "false",
+        "bool");
+
+  // What ptree::get accepts: surrounding whitespace and a leading '+'.
+  check(numeric::parse<float>(" \t2.5\n") == 2.5f, "whitespace");
+  check(numeric::parse<int>("+7") == 7, "plus");
+  check(numeric::parse<unsigned int>("4294967295") == 4294967295u, "unsigned");
+  check(numeric::parse<double>(".5") == 0.5 && numeric::parse<double>("1e3"),
+        "forms");
+  check(numeric::parse<bool>("true") == true && numeric::parse<bool>("0") == false,
+        "bool forms");
+  for (const char* bad : {"", " ", "+", "+-1", "1.5x", "x", "1 2", "0x10"}) {
+    check(!numeric::parse<double>(bad), std::string("rejects '") + bad + "'");
+  }
+  check(!numeric::parse<unsigned int>("-1"), "negative unsigned");
+  check(!numeric::parse<unsigned int>("4294967296"), "unsigned overflow");
+  check(!numeric::parse<int>("1.5"), "fraction as int");
+  check(!numeric::parse<float>("1e39"), "float overflow");
+  check(!numeric::parse<bool>("yes") && !numeric::parse<bool>("2"), "bad bool");
+
+  // The global locale changes what a stream writes, but not numeric.
+  std::locale::global(std::locale(std::locale::classic(), new CommaPunct));
+  std::ostringstream stream;
+  stream << 1234.5;
+  check(stream.str() != "1234.5", "locale in effect");
+  check(numeric::toString(1234.5) == "1234.5", "locale-free format");
+  check(numeric::parse<double>("1234.5") == 1234.5, "locale-free parse");
+
+  boost::property_tree::ptree tree;
+  tree.put("MZ", 57.0703125f, numeric::translator<float>);
+  tree.put("Count", 12345u, numeric::translator<unsigned int>);
+  tree.put("Flag", true, numeric::translator<bool>);
+  check(tree.get<std::string>("MZ") == "57.070312", "put float");
+  check(tree.get<std::string>("Count") == "12345", "put unsigned");
+  check(tree.get<std::string>("Flag") == "true", "put bool");
+  check(same(tree.get("MZ", 0.0f, numeric::translator<float>), 57.0703125f),
+        "get float");
+  check(same(tree.get("Missing", 3.0f, numeric::translator<float>), 3.0f),
+        "get missing");
+  tree.put("Bad", "n/a");
+  check(tree.get("Bad", -1, numeric::translator<int>) == -1, "get malformed");
+  std::locale::global(std::locale::classic());
+
+  std::cout << "Numeric tests passed\n";
+  return 0;
+}
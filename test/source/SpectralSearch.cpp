@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "models/library.hpp"
+#include "models/spectral_store.hpp"
+#include "scoring/spectral_search.hpp"
+
+#include "check.hpp"
+
+// Reference matcher: each library peak, in m/z order, claims the nearest
+// unclaimed query peak within the tolerance.
+double naiveCosine(const LIB_NAMESPACE::SpectrumView& query,
+                   const LIB_NAMESPACE::SpectrumView& library,
+                   const LIB_NAMESPACE::MzTolerance& tolerance)
+{
+  std::vector<std::pair<double, double>> peaks;
+  for (std::size_t i = 0; i < query.MzValues.size(); ++i) {
+    peaks.push_back({query.MzValues[i], std::sqrt(query.AbundanceValues[i])});
+  }
+  std::stable_sort(peaks.begin(), peaks.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+  std::vector<bool> claimed(peaks.size(), false);
+
+  double dot = 0;
+  double normQuery = 0;
+  double normLibrary = 0;
+  for (const auto& peak : peaks) {
+    normQuery += peak.second * peak.second;
+  }
+  std::vector<std::size_t> order(library.MzValues.size());
+  for (std::size_t l = 0; l < order.size(); ++l) {
+    order[l] = l;
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b)
+                   { return library.MzValues[a] < library.MzValues[b]; });
+
+  for (auto l : order) {
+    normLibrary += library.AbundanceValues[l];
+
+    std::size_t nearest = peaks.size();
+    for (std::size_t q = 0; q < peaks.size(); ++q) {
+      double delta = std::abs(peaks[q].first - library.MzValues[l]);
+      if (!claimed[q]
+          && tolerance.matches(peaks[q].first, library.MzValues[l])
+          && (nearest == peaks.size()
+              || delta < std::abs(peaks[nearest].first - library.MzValues[l])))
+      {
+        nearest = q;
+      }
+    }
+    if (nearest != peaks.size()) {
+      claimed[nearest] = true;
+      dot += peaks[nearest].second * std::sqrt(library.AbundanceValues[l]);
+    }
+  }
+  return dot / std::sqrt(normQuery * normLibrary);
+}
+
+// Checks every self-search of `store` against the naive matcher.
+void checkSearch(const LIB_NAMESPACE::SpectralStore& store,
+                 const LIB_NAMESPACE::SpectralSearch& search)
+{
+  for (auto query : store.spectra()) {
+    auto hits = search.search(query);
+    check(!hits.empty() && hits.size() <= search.options().TopK, "hit count");
+    check(hits.front().CompoundID == query.CompoundID,
+          "a spectrum finds its own compound first");
+    check(std::abs(hits.front().Score - 1) < 1e-9, "self match scores 1");
+    check(hits.front().Score <= 1 + 1e-12, "cosine is at most 1");
+
+    for (std::size_t i = 1; i < hits.size(); ++i) {
+      check(hits[i - 1].Score >= hits[i].Score, "hits sorted by score");
+    }
+
+    // Every hit's score is the best naive cosine over that compound's spectra,
+    // and no compound outside the hits scores better than the last hit.
+    std::vector<std::pair<double, LIB_NAMESPACE::tCompoundID>> expected;
+    for (auto compound : store.compounds()) {
+      double best = 0;
+      for (auto spectrum : compound.Spectra) {
+        best = std::max(
+            best, naiveCosine(query, spectrum, search.options().Tolerance));
+      }
+      if (best > 0) {
+        expected.push_back({-best, compound.CompoundID});
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    for (std::size_t i = 0; i < hits.size(); ++i) {
+      check(std::abs(hits[i].Score + expected[i].first) < 1e-9,
+            "score matches brute force");
+    }
+  }
+}
+
+int main()
+{
+  std::mt19937 random(11);
+  std::uniform_real_distribution<double> mz(30, 300);
+  std::uniform_real_distribution<double> abundance(1, 9999);
+
+  LIB_NAMESPACE::Library library;
+  for (LIB_NAMESPACE::tCompoundID id = 1; id <= 60; ++id) {
+    LIB_NAMESPACE::Compound compound;
+    compound.CompoundID = id;
+    compound.CompoundName = "Compound " + std::to_string(id);
+    library.insert(compound);
+
+    for (LIB_NAMESPACE::tSpectrumID s = 0; s < 1 + id % 3; ++s) {
+      LIB_NAMESPACE::Spectrum spectrum;
+      spectrum.CompoundID = id;
+      spectrum.SpectrumID = id * 10 + s;
+      for (int p = 0; p < 5 + static_cast<int>(id % 40); ++p) {
+        // Generated unsorted; the store sorts them.
+        spectrum.MzValues.push_back(mz(random));
+        spectrum.AbundanceValues.push_back(abundance(random));
+      }
+      library.insert(spectrum);
+    }
+  }
+  LIB_NAMESPACE::SpectralStore store(library);
+
+  LIB_NAMESPACE::SearchOptions options;
+  options.Tolerance = 0.3;
+  options.TopK = 5;
+  LIB_NAMESPACE::SpectralSearch search(store, options);
+
+  checkSearch(store, search);
+
+  // Relative windows, from 0.06 Da at the low end to 0.6 Da at the top.
+  auto relative = options;
+  relative.Tolerance = LIB_NAMESPACE::MzTolerance::ppm(2000);
+  checkSearch(store, LIB_NAMESPACE::SpectralSearch(store, relative));
+
+  // The batch API runs the same searches across threads.
+  auto batch = search.search(store, 4);
+  check(batch.size() == store.spectrumCount(), "one result per query");
+  for (std::size_t s = 0; s < batch.size(); ++s) {
+    auto single = search.search(store.spectrum(s));
+    check(batch[s].size() == single.size(), "threaded hit count");
+    for (std::size_t i = 0; i < single.size(); ++i) {
+      check(batch[s][i].CompoundID == single[i].CompoundID
+                && same(batch[s][i].Score, single[i].Score),
+            "threaded search matches");
+    }
+  }
+
+  std::vector<double> noPeaks;
+  check(search.search(noPeaks, noPeaks).empty(), "empty query");
+
+  std::cout << "SpectralSearch: OK" << std::endl;
+  return 0;
+}
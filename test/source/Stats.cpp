@@ -0,0 +1,116 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "base64.hpp"
+#include "io/library_reader.hpp"
+#include "models/library.hpp"
+#include "profiling/stats.hpp"
+
+#include "check.hpp"
+
+void sleepMs(int ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+int main()
+{
+  namespace stats = LIB_NAMESPACE::stats;
+
+  // Nothing is recorded until enable().
+  {
+    LIB_STATS_SCOPE(Read);
+    LIB_STATS_ADD(Compounds, 5);
+  }
+  stats::enable();
+  auto empty = stats::snapshot();
+  check(empty[stats::Phase::Read].Calls == 0, "disabled scope not recorded");
+  check(empty[stats::Counter::Compounds] == 0, "disabled counter not recorded");
+
+  // Inner scopes pause outer ones, so each phase gets only its own time.
+  {
+    LIB_STATS_SCOPE(Transform);
+    sleepMs(20);
+    {
+      LIB_STATS_SCOPE(Write);
+      sleepMs(40);
+    }
+    sleepMs(20);
+  }
+  auto timed = stats::snapshot();
+  check(timed[stats::Phase::Transform].Calls == 1, "transform calls");
+  check(timed[stats::Phase::Write].Calls == 1, "write calls");
+  check(timed[stats::Phase::Write].Seconds >= 0.035, "write time");
+  check(timed[stats::Phase::Transform].Seconds >= 0.035
+            && timed[stats::Phase::Transform].Seconds < 0.075,
+        "transform time excludes the nested write");
+  check(timed.WallSeconds >= timed[stats::Phase::Transform].Seconds
+                + timed[stats::Phase::Write].Seconds,
+        "wall time covers the phases");
+
+  // Loading counts records and peaks; decoding is timed and a bad payload
+  // counts as a failure.
+  std::vector<double> peaks = {50, 60, 70};
+  LIB_NAMESPACE::Library library;
+  LIB_NAMESPACE::Compound compound;
+  compound.CompoundID = 1;
+  library.insert(compound);
+  LIB_NAMESPACE::Spectrum good;
+  good.CompoundID = 1;
+  good.SpectrumID = 1;
+  good.MzValues = LIB_NAMESPACE::LazyArray<double>::encoded(
+      base64::encodeArray<double>(peaks));
+  library.insert(good);
+  LIB_NAMESPACE::Spectrum bad;
+  bad.CompoundID = 1;
+  bad.SpectrumID = 2;
+  bad.MzValues = LIB_NAMESPACE::LazyArray<double>::encoded("AAAA*AAA");
+  library.insert(bad);
+
+  auto& spectra = library.Compounds.at(1).Spectra;
+  check(spectra.at(1).MzValues.size() == 3, "good payload decodes");
+  spectra.at(2).MzValues.size();
+
+  auto counted = stats::snapshot();
+  check(counted[stats::Counter::Compounds] == 1, "compounds counted");
+  check(counted[stats::Counter::Spectra] == 2, "spectra counted");
+  check(counted[stats::Counter::Peaks] == 4, "peaks counted before decoding");
+  check(counted[stats::Counter::DecodeFailures] == 1, "decode failure");
+  check(counted[stats::Phase::Decode].Calls == 2, "decodes timed");
+
+  std::ostringstream json;
+  stats::writeJson(counted, json);
+  check(json.str().find("\"decode_failures\": 1") != std::string::npos,
+        "JSON counter");
+  check(json.str().find("\"write\": {\"seconds\": ") != std::string::npos,
+        "JSON phase");
+
+  std::ostringstream table;
+  stats::report(counted, table);
+  check(table.str().find("transform") != std::string::npos, "report");
+
+  // A file that cannot be opened adds nothing to the bytes read.
+  bool threw = false;
+  try {
+    LIB_NAMESPACE::readLibrary("no such file.mslibrary.xml");
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  check(threw, "missing library reported");
+  check(stats::snapshot()[stats::Counter::BytesRead]
+            == counted[stats::Counter::BytesRead],
+        "missing library reads no bytes");
+
+  // enable() starts over; disable() stops recording.
+  stats::enable();
+  stats::disable();
+  LIB_STATS_ADD(Spectra, 1);
+  check(stats::snapshot()[stats::Counter::Spectra] == 0, "reset and disable");
+
+  std::cout << "Stats: OK" << std::endl;
+  return 0;
+}
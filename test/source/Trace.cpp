@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "parallel/work_stealing_pool.hpp"
+#include "profiling/trace.hpp"
+
+#include "check.hpp"
+
+std::size_t count(const std::string& name)
+{
+  auto events = LIB_NAMESPACE::trace::events();
+  return static_cast<std::size_t>(
+      std::count_if(events.begin(),
+                    events.end(),
+                    [&](const LIB_NAMESPACE::trace::Event& event)
+                    { return event.Name == name; }));
+}
+
+int main()
+{
+  namespace trace = LIB_NAMESPACE::trace;
+
+  // Nothing is recorded until enable().
+  {
+    LIB_TRACE_SCOPE("disabled");
+  }
+  trace::enable();
+  check(trace::events().empty(), "disabled span not recorded");
+
+  // Spans nest on a thread and carry their argument.
+  {
+    LIB_TRACE_SCOPE("outer");
+    LIB_TRACE_SCOPE("inner", "index", 7);
+  }
+  auto events = trace::events();
+  check(events.size() == 2, "two spans");
+  check(std::string(events[0].Name) == "outer", "start order");
+  check(events[0].Begin <= events[1].Begin && events[1].End <= events[0].End,
+        "inner span inside outer");
+  check(events[1].ArgName && events[1].Arg == 7, "argument");
+  check(events[0].Thread == events[1].Thread, "same thread");
+
+  // Worker threads record into their own buffers, which outlive them and
+  // are reused by the next pool.
+  // One worker may drain every task, so compare against those that ran.
+  const LIB_NAMESPACE::WorkStealingPool pool(4);
+  std::mutex mutex;
+  std::set<unsigned> workers;
+  for (int round = 0; round < 2; ++round) {
+    pool.run(64,
+             [&](std::size_t task, unsigned worker)
+             {
+               LIB_TRACE_SCOPE("task", "task", task);
+               const std::lock_guard<std::mutex> lock(mutex);
+               workers.insert(worker);
+             });
+  }
+  check(count("task") == 128, "every task recorded");
+  std::set<std::uint32_t> threads;
+  for (const auto& event : trace::events()) {
+    if (std::string(event.Name) == "task") {
+      threads.insert(event.Thread);
+    }
+  }
+  check(threads.size() >= workers.size(), "one buffer per worker thread");
+  check(trace::dropped() == 0, "nothing dropped");
+
+  std::ostringstream json;
+  trace::writeJson(json);
+  check(json.str().starts_with("{\"traceEvents\": ["), "trace header");
+  check(json.str().find("\"ph\": \"X\"") != std::string::npos, "span events");
+  check(json.str().find("\"args\": {\"index\": 7}") != std::string::npos,
+        "span arguments");
+
+  // A full ring keeps the newest events. Only new buffers take the smaller
+  // capacity, so record on a fresh thread.
+  trace::enable(8);
+  check(trace::events().empty(), "enable clears");
+  std::thread(
+      []
+      {
+        for (std::uint64_t i = 0; i < 20; ++i) {
+          LIB_TRACE_SCOPE("ring", "i", i);
+        }
+      })
+      .join();
+  events = trace::events();
+  check(events.size() == 8, "ring capacity");
+  check(events.front().Arg == 12 && events.back().Arg == 19, "newest kept");
+  check(trace::dropped() == 12, "dropped count");
+
+  trace::disable();
+  {
+    LIB_TRACE_SCOPE("after");
+  }
+  check(count("after") == 0, "disabled again");
+
+  std::cout << "Trace tests passed\n";
+  return 0;
+}
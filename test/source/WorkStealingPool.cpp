@@ -0,0 +1,92 @@
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "parallel/work_stealing_pool.hpp"
+
+#include "check.hpp"
+
+int main()
+{
+  // Skewed weights, as with a few compounds carrying many spectra.
+  std::vector<std::uint64_t> weights;
+  for (std::size_t i = 0; i < 5000; ++i) {
+    weights.push_back(i % 100 == 0 ? 400 : 1 + i % 3);
+  }
+
+  auto bounds = LIB_NAMESPACE::partitionByWeight(weights, 8);
+  check(bounds.front() == 0 && bounds.back() == weights.size(),
+        "partition covers every item");
+  for (std::size_t b = 1; b < bounds.size(); ++b) {
+    check(bounds[b - 1] < bounds[b], "partition batches are non-empty");
+  }
+  check(LIB_NAMESPACE::partitionByWeight({}, 8).size() == 1,
+        "empty partition");
+
+  for (unsigned threads : {1u, 3u, 8u}) {
+    LIB_NAMESPACE::WorkStealingPool pool(threads);
+    std::size_t batches = bounds.size() - 1;
+
+    std::vector<std::atomic<int>> runs(batches);
+    std::ostringstream stream;
+    LIB_NAMESPACE::OrderedWriter output(stream, batches);
+
+    pool.run(batches,
+             [&](std::size_t batch, unsigned worker)
+             {
+               check(worker < threads, "worker index in range");
+               runs[batch].fetch_add(1);
+
+               std::string chunk;
+               for (auto i = bounds[batch]; i < bounds[batch + 1]; ++i) {
+                 chunk += std::to_string(i) + "\n";
+               }
+               output.write(batch, std::move(chunk));
+             });
+
+    for (const auto& count : runs) {
+      check(count.load() == 1, "every task runs exactly once");
+    }
+    check(output.written() == batches, "every chunk written");
+
+    std::string expected;
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+      expected += std::to_string(i) + "\n";
+    }
+    check(stream.str() == expected, "chunks written in index order");
+
+    bool rethrown = false;
+    try {
+      pool.run(100,
+               [](std::size_t task, unsigned)
+               {
+                 if (task == 42) {
+                   throw std::runtime_error("task failed");
+                 }
+               });
+    } catch (const std::runtime_error&) {
+      rethrown = true;
+    }
+    check(rethrown, "task exceptions are rethrown");
+  }
+
+  {
+    std::ostringstream broken;
+    broken.setstate(std::ios::badbit);
+    LIB_NAMESPACE::OrderedWriter output(broken, 2);
+    output.write(1, "later\n");
+    bool reported = false;
+    try {
+      output.write(0, "first\n");
+    } catch (const std::runtime_error&) {
+      reported = true;
+    }
+    check(reported && output.written() == 0, "stream failures are reported");
+  }
+
+  std::cout << "WorkStealingPool: OK" << std::endl;
+  return 0;
+}
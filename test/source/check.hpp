@@ -0,0 +1,28 @@
+#pragma once
+
+#ifndef LIB_TEST_CHECK_HPP
+#define LIB_TEST_CHECK_HPP
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+// Fails the test, naming what was checked, unless `condition` holds.
+inline void check(bool condition, const std::string& what)
+{
+  if (!condition) {
+    throw std::runtime_error("Check failed: " + what);
+  }
+}
+
+// Whether `lhs` and `rhs` hold the same value bit for bit, which is what the
+// tests mean by an exact floating-point result.
+template<typename T>
+  requires std::is_floating_point_v<T>
+bool same(T lhs, std::type_identity_t<T> rhs)
+{
+  return std::memcmp(&lhs, &rhs, sizeof(T)) == 0;
+}
+
+#endif  // LIB_TEST_CHECK_HPP
@@ -0,0 +1,21 @@
+#pragma once
+
+#ifndef LIB_TEST_XML_HPP
+#define LIB_TEST_XML_HPP
+
+#include <sstream>
+#include <string>
+
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
+
+// The tree read_xml builds from `xml`, for comparison with the models.
+inline boost::property_tree::ptree parse(const std::string& xml)
+{
+  boost::property_tree::ptree tree;
+  std::istringstream input(xml);
+  boost::property_tree::read_xml(input, tree);
+  return tree;
+}
+
+#endif  // LIB_TEST_XML_HPP